@@ -0,0 +1,664 @@
+/*
+ * Copyright (C) Tildeslash Ltd. All rights reserved.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ *
+ * You must obey the GNU Affero General Public License in all respects
+ * for all of the code used other than OpenSSL.
+ */
+
+
+#include "xconfig.h"
+
+#ifdef HAVE_STDIO_H
+#include <stdio.h>
+#endif
+
+#ifdef HAVE_STDLIB_H
+#include <stdlib.h>
+#endif
+
+#ifdef HAVE_ERRNO_H
+#include <errno.h>
+#endif
+
+#ifdef HAVE_GETOPT_H
+#include <getopt.h>
+#endif
+
+#ifdef HAVE_STRING_H
+#include <string.h>
+#endif
+
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+
+#ifdef HAVE_SYS_TYPES_H
+#include <sys/types.h>
+#endif
+
+#ifdef HAVE_SYS_STAT_H
+#include <sys/stat.h>
+#endif
+
+#ifdef HAVE_DIRENT_H
+#include <dirent.h>
+#endif
+
+#ifdef HAVE_LOCALE_H
+#include <locale.h>
+#endif
+
+#include "monit.h"
+#include "ProcessTree.h"
+#include "process_sysdep.h"
+#include "validate.h"
+
+// libmonit
+#include "Bootstrap.h"
+#include "system/Time.h"
+#include "thread/Thread.h"
+#include "exceptions/AssertException.h"
+
+
+/**
+ * Microbenchmarks of the Monit hot paths. The benchmarks run against
+ * generated fixtures: a synthetic /proc snapshot with the given number of
+ * processes (or a recorded snapshot), a control file with the given number
+ * of services, a large log file and a checksum test file. The results are
+ * printed as a table and optionally written in JSON format. If a baseline
+ * result file is given, the results are compared with the baseline and the
+ * program fails if a benchmark is slower than the threshold. Before the
+ * benchmarks run, the service fingerprints used by the incremental reload
+ * are verified.
+ *
+ * The benchmark is linked with all Monit objects, the monit.c main() is
+ * renamed by the build (see the "bench" target in Makefile.am).
+ *
+ * @file
+ */
+
+
+#undef main
+
+
+/* ----------------------------------------------------------- MARK: - Definitions */
+
+
+#define BENCH_RUNS      15               /* Default number of measured runs of each benchmark */
+#define BENCH_PIDS      10000            /* Default number of processes in the synthetic /proc snapshot */
+#define BENCH_SERVICES  1000             /* Default number of services in the control file */
+#define BENCH_LOGLINES  200000           /* Number of lines in the log file */
+#define BENCH_FILESIZE  16777216         /* Size of the checksum test file */
+#define BENCH_CLIENTS   8                /* Number of concurrent HTTP clients */
+#define BENCH_REQUESTS  50               /* Number of requests per HTTP client and run */
+#define BENCH_THRESHOLD 10.              /* Default regression threshold [%] */
+
+
+typedef struct Benchmark_T {
+        const char *name;
+        void (*run)(void);
+        int operations;                     /**< Number of operations per run */
+        bool enabled;
+        struct {
+                double median;                     /**< Median time per operation [ns] */
+                double mean;                         /**< Mean time per operation [ns] */
+                double min;                       /**< Minimum time per operation [ns] */
+                double baseline;         /**< Baseline median time per operation [ns] */
+        } result;
+} Benchmark_T;
+
+
+/**
+ * The reload test control file statements: the first service statement, the
+ * options of the file service which follows the "check device" statement (the
+ * filesystem alias) and the limit set by the "set" statement between services
+ */
+typedef struct Reload_T {
+        const char *first;                          /**< The first service check */
+        const char *options;                           /**< The file service test */
+        const char *limits;                         /**< The program output limit */
+} Reload_T;
+
+
+const char *bench_procfs = "/proc";
+
+
+static struct {
+        int runs;
+        int pids;
+        int services;
+        double threshold;
+        char *filter;
+        char *output;
+        char *baseline;
+        char *snapshot;
+        char directory[256];
+        char control[PATH_MAX];
+        char log[PATH_MAX];
+        char file[PATH_MAX];
+        char socket[PATH_MAX];
+        Service_T logService;
+} bench = {.runs = BENCH_RUNS, .pids = BENCH_PIDS, .services = BENCH_SERVICES, .threshold = BENCH_THRESHOLD};
+
+
+/* --------------------------------------------------------------- MARK: - Fixtures */
+
+
+static void _writeFile(const char *path, const char *content, size_t length) {
+        FILE *f = fopen(path, "w");
+        if (! f || fwrite(content, 1, length, f) != length || fclose(f) != 0) {
+                fprintf(stderr, "Cannot write %s -- %s\n", path, STRERROR);
+                exit(1);
+        }
+}
+
+
+static char *_procPath(char *path, const char *directory, int pid, const char *name) {
+        if (snprintf(path, PATH_MAX, "%s/%d%s", directory, pid, name) >= PATH_MAX) {
+                fprintf(stderr, "Path too long -- %s\n", directory);
+                exit(1);
+        }
+        return path;
+}
+
+
+/**
+ * Generate the synthetic /proc snapshot in the Linux format. The parent
+ * process is selected randomly from the previous processes, so the tree
+ * has a realistic depth
+ */
+static void _createProcfs(const char *directory) {
+        char path[PATH_MAX];
+        char buf[1024];
+        for (int pid = 1; pid <= bench.pids; pid++) {
+                int ppid = pid > 1 ? 1 + (int)(random() % (pid - 1)) : 0;
+                if (mkdir(_procPath(path, directory, pid, ""), 0700) != 0) {
+                        fprintf(stderr, "Cannot create %s -- %s\n", path, STRERROR);
+                        exit(1);
+                }
+                int length = snprintf(buf, sizeof(buf),
+                                      "%d (bench-%d) S %d %d %d 0 -1 4194560 100 0 0 0 %ld %ld 0 0 20 0 %d 0 %d 10485760 %ld 18446744073709551615 1 1 0 0 0 0 0 0 0 0 0 0 17 0 0 0 0 0 0\n",
+                                      pid, pid, ppid, pid, pid, random() % 10000, random() % 1000, 1 + (int)(random() % 16), 1000 + pid, 100 + random() % 10000);
+                _writeFile(_procPath(path, directory, pid, "/stat"), buf, length);
+                length = snprintf(buf, sizeof(buf), "Name:\tbench-%d\nState:\tS (sleeping)\nUid:\t%d\t%d\t%d\t%d\nGid:\t%d\t%d\t%d\t%d\n", pid, pid % 100, pid % 100, pid % 100, pid % 100, pid % 50, pid % 50, pid % 50, pid % 50);
+                _writeFile(_procPath(path, directory, pid, "/status"), buf, length);
+                length = snprintf(buf, sizeof(buf), "rchar: 0\nwchar: 0\nsyscr: 0\nsyscw: 0\nread_bytes: %ld\nwrite_bytes: %ld\ncancelled_write_bytes: 0\n", random() % 1000000, random() % 1000000);
+                _writeFile(_procPath(path, directory, pid, "/io"), buf, length);
+                length = snprintf(buf, sizeof(buf), "/usr/bin/bench-%d%c--option%c%d", pid, 0, 0, pid) + 1;
+                _writeFile(_procPath(path, directory, pid, "/cmdline"), buf, length);
+        }
+}
+
+
+static void _createLog(void) {
+        FILE *f = fopen(bench.log, "w");
+        if (! f) {
+                fprintf(stderr, "Cannot create %s -- %s\n", bench.log, STRERROR);
+                exit(1);
+        }
+        for (int i = 0; i < BENCH_LOGLINES; i++) {
+                if (i % 10000 == 9999)
+                        fprintf(f, "2024-01-01T00:00:%02d host app[%d]: ERROR %d fatal failure in request handler\n", i % 60, i, i);
+                else
+                        fprintf(f, "2024-01-01T00:00:%02d host app[%d]: INFO request %d completed in %d ms\n", i % 60, i, i, i % 500);
+        }
+        fclose(f);
+}
+
+
+static void _createFile(void) {
+        char *data = ALLOC(BENCH_FILESIZE);
+        for (int i = 0; i < BENCH_FILESIZE; i++)
+                data[i] = (char)random();
+        _writeFile(bench.file, data, BENCH_FILESIZE);
+        FREE(data);
+}
+
+
+static void _createControlFile(void) {
+        FILE *f = fopen(bench.control, "w");
+        if (! f) {
+                fprintf(stderr, "Cannot create %s -- %s\n", bench.control, STRERROR);
+                exit(1);
+        }
+        fprintf(f,
+                "set daemon 30\n"
+                "set httpd unixsocket %s\n"
+                "    allow bench:bench\n"
+                "check file log with path %s\n"
+                "    if content = \"ERROR [0-9]+ fatal\" then alert\n"
+                "    ignore content = \"DEBUG\"\n",
+                bench.socket, bench.log);
+        for (int i = 0; i < bench.services; i++)
+                fprintf(f, "check process process%d matching \"^/usr/bin/bench-%d \"\n    if cpu > 50%% then alert\n", i, i + 1);
+        fclose(f);
+        chmod(bench.control, 0600);
+}
+
+
+/**
+ * Write the reload test control file
+ */
+static void _createReloadFile(const char *path, Reload_T *reload) {
+        FILE *f = fopen(path, "w");
+        if (! f) {
+                fprintf(stderr, "Cannot create %s -- %s\n", path, STRERROR);
+                exit(1);
+        }
+        fprintf(f,
+                "set daemon 30\n"
+                "%s\n"
+                "    group bench\n"
+                "check device root with path /\n"
+                "    if space usage > 90%% then alert\n"
+                "set limits { programOutput: %s }\n"
+                "check file log with path %s\n"
+                "    %s\n"
+                "check process last matching \"^/usr/bin/bench-2 \"\n"
+                "    if cpu > 50%% then alert\n",
+                reload->first, reload->limits, bench.log, reload->options);
+        fclose(f);
+        chmod(path, 0600);
+}
+
+
+static void _parse(const char *path) {
+        Run.files.control = (char *)path;
+        if (! parse(Run.files.control)) {
+                fprintf(stderr, "Cannot parse the control file %s\n", path);
+                exit(1);
+        }
+}
+
+
+static void _gc(Service_T *services, ServiceGroup_T *groups) {
+        gc_services(services, groups);
+        Util_resetServiceIndex();
+        gc_config();
+}
+
+
+/**
+ * Verify the fingerprints used by the incremental reload: the control file
+ * is parsed, one statement is changed and the file is parsed again the same
+ * way as on reload. Only the changed service (or the global configuration)
+ * may get a new fingerprint, otherwise the reload would keep a changed
+ * service, replace an unchanged one or replace all services
+ * @return The number of errors
+ */
+static int _verifyReload(const char *path, Reload_T *base, Reload_T *reload, const char *changed) {
+        _createReloadFile(path, base);
+        _parse(path);
+        Service_T services = servicelist;
+        ServiceGroup_T servicegroups = servicegrouplist;
+        uint64_t fingerprint = Run.fingerprint;
+        servicelist = NULL;
+        servicegrouplist = NULL;
+        Util_resetServiceIndex();
+        gc_config();
+        _createReloadFile(path, reload);
+        _parse(path);
+        int errors = 0;
+        if ((Run.fingerprint != fingerprint) != (changed == NULL)) {
+                fprintf(stderr, "Reload check failed -- the global configuration is %s but its fingerprint %s\n", changed ? "unchanged" : "changed", changed ? "differs" : "is the same");
+                errors++;
+        }
+        for (Service_T o = services; o; o = o->next) {
+                Service_T s = Util_getService(o->name);
+                bool expected = changed && IS(o->name, changed);
+                if (! s) {
+                        fprintf(stderr, "Reload check failed -- service '%s' not found\n", o->name);
+                        errors++;
+                } else if ((s->type != o->type || s->fingerprint != o->fingerprint) != expected) {
+                        fprintf(stderr, "Reload check failed -- service '%s' is %s but its fingerprint %s\n", o->name, expected ? "changed" : "unchanged", expected ? "is the same" : "differs");
+                        errors++;
+                }
+        }
+        _gc(&services, &servicegroups);
+        _gc(&servicelist, &servicegrouplist);
+        return errors;
+}
+
+
+static void _checkReload(void) {
+        char path[PATH_MAX];
+        snprintf(path, sizeof(path), "%s/monitrc.reload", bench.directory);
+        Reload_T base = {"check process first matching \"^/usr/bin/bench-1 \"", "if size > 1 MB then alert", "512 B"};
+        int errors = _verifyReload(path, &base, &(Reload_T){base.first, "if size > 2 MB then alert", base.limits}, "log");
+        errors += _verifyReload(path, &base, &(Reload_T){"check program first with path /bin/true", base.options, base.limits}, "first");
+        errors += _verifyReload(path, &base, &(Reload_T){base.first, base.options, "1 kB"}, NULL);
+        remove(path);
+        if (errors)
+                exit(1);
+}
+
+
+static void _remove(const char *path) {
+        DIR *dir = opendir(path);
+        if (dir) {
+                struct dirent *de;
+                char entry[PATH_MAX];
+                while ((de = readdir(dir))) {
+                        if (! IS(de->d_name, ".") && ! IS(de->d_name, "..")) {
+                                snprintf(entry, sizeof(entry), "%s/%s", path, de->d_name);
+                                _remove(entry);
+                        }
+                }
+                closedir(dir);
+        }
+        remove(path);
+}
+
+
+static void _cleanup(void) {
+        if (*bench.directory)
+                _remove(bench.directory);
+}
+
+
+static void _init(void) {
+        snprintf(bench.directory, sizeof(bench.directory), "%s/monitbench.XXXXXX", getenv("TMPDIR") ? getenv("TMPDIR") : "/tmp");
+        if (! mkdtemp(bench.directory)) {
+                fprintf(stderr, "Cannot create the fixture directory -- %s\n", STRERROR);
+                exit(1);
+        }
+        atexit(_cleanup);
+        snprintf(bench.control, sizeof(bench.control), "%s/monitrc", bench.directory);
+        snprintf(bench.log, sizeof(bench.log), "%s/bench.log", bench.directory);
+        snprintf(bench.file, sizeof(bench.file), "%s/bench.dat", bench.directory);
+        snprintf(bench.socket, sizeof(bench.socket), "%s/monit.sock", bench.directory);
+        srandom(1); // The fixtures are the same in every run
+        if (bench.snapshot) {
+                bench_procfs = bench.snapshot;
+        } else {
+#ifdef LINUX
+                static char procfs[PATH_MAX];
+                snprintf(procfs, sizeof(procfs), "%s/proc", bench.directory);
+                mkdir(procfs, 0700);
+                _createProcfs(procfs);
+                bench_procfs = procfs;
+#endif
+        }
+        _createLog();
+        _createFile();
+        _createControlFile();
+        _checkReload();
+        _parse(bench.control);
+        for (Service_T s = servicelist; s; s = s->next) {
+                s->monitor = Monitor_Yes;
+                if (s->type == Service_File)
+                        bench.logService = s;
+        }
+}
+
+
+/* ------------------------------------------------------------- MARK: - Benchmarks */
+
+
+static void _benchProcessTreeSysdep(void) {
+        ProcessTree_T *pt = NULL;
+        int count = initprocesstree_sysdep(&pt, ProcessEngine_CollectCommandLine);
+        for (int i = 0; i < count; i++) {
+                FREE(pt[i].cmdline);
+                FREE(pt[i].secattr);
+        }
+        FREE(pt);
+}
+
+
+static void _benchProcessTree(void) {
+        ProcessTree_init(ProcessEngine_CollectCommandLine);
+}
+
+
+static void _benchContentMatch(void) {
+        bench.logService->inf.file->inode = 0;
+        bench.logService->inf.file->readpos = 0;
+        check_file(bench.logService); // Init the inode, the first test seeks to the end of the file
+        bench.logService->inf.file->readpos = 0;
+        check_file(bench.logService);
+}
+
+
+static void _benchStatusXml(void) {
+        StringBuffer_T B = StringBuffer_create(65536);
+        status_xml(B, NULL, 2, "localhost");
+        StringBuffer_free(&B);
+}
+
+
+static void _benchChecksumMd5(void) {
+        char buf[STRLEN];
+        Util_getChecksum(bench.file, Hash_Md5, buf, sizeof(buf));
+}
+
+
+static void _benchChecksumSha1(void) {
+        char buf[STRLEN];
+        Util_getChecksum(bench.file, Hash_Sha1, buf, sizeof(buf));
+}
+
+
+static void _benchIncron(void) {
+        time_t t = 1704067200; // 2024-01-01 00:00:00 UTC
+        for (int i = 0; i < 100000; i++)
+                Time_incron("*/5 8-18 * * 1-5", t + i * 60);
+}
+
+
+static void *_httpClient(void *arg) {
+        char buf[4096];
+        for (int i = 0; i < BENCH_REQUESTS; i++) {
+                Socket_T S = Socket_createUnix(bench.socket, Socket_Tcp, 5000);
+                if (! S) {
+                        fprintf(stderr, "Cannot connect to %s\n", bench.socket);
+                        exit(1);
+                }
+                Socket_print(S, "GET /_ping HTTP/1.0\r\nAuthorization: Basic YmVuY2g6YmVuY2g=\r\n\r\n"); // bench:bench
+                while (Socket_read(S, buf, sizeof(buf)) > 0)
+                        ;
+                Socket_free(&S);
+        }
+        return NULL;
+}
+
+
+static void _benchHttp(void) {
+        Thread_T clients[BENCH_CLIENTS];
+        for (int i = 0; i < BENCH_CLIENTS; i++)
+                Thread_create(clients[i], _httpClient, NULL);
+        for (int i = 0; i < BENCH_CLIENTS; i++)
+                Thread_join(clients[i]);
+}
+
+
+static Benchmark_T benchmarks[] = {
+        {"initprocesstree_sysdep", _benchProcessTreeSysdep, 1},
+        {"ProcessTree_init",       _benchProcessTree,       1},
+        {"content_match",          _benchContentMatch,      BENCH_LOGLINES},
+        {"status_xml",             _benchStatusXml,         1},
+        {"checksum_md5",           _benchChecksumMd5,       1},
+        {"checksum_sha1",          _benchChecksumSha1,      1},
+        {"Time_incron",            _benchIncron,            100000},
+        {"http_ping",              _benchHttp,              BENCH_CLIENTS * BENCH_REQUESTS}
+};
+
+
+#define BENCHMARKS (int)(sizeof(benchmarks) / sizeof(benchmarks[0]))
+
+
+/* ------------------------------------------------------------------ MARK: - Runner */
+
+
+static int _compare(const void *a, const void *b) {
+        double x = *(const double *)a, y = *(const double *)b;
+        return x < y ? -1 : x > y;
+}
+
+
+static void _measure(Benchmark_T *b) {
+        double *samples = CALLOC(sizeof(double), bench.runs);
+        b->run(); // Warm up the caches
+        for (int i = 0; i < bench.runs; i++) {
+                int64_t start = Time_micro();
+                b->run();
+                samples[i] = (double)(Time_micro() - start) * 1000. / b->operations;
+                b->result.mean += samples[i] / bench.runs;
+        }
+        qsort(samples, bench.runs, sizeof(double), _compare);
+        b->result.min = samples[0];
+        b->result.median = bench.runs % 2 ? samples[bench.runs / 2] : (samples[bench.runs / 2 - 1] + samples[bench.runs / 2]) / 2.;
+        FREE(samples);
+}
+
+
+/**
+ * Read the baseline medians. The baseline is a result file written by the
+ * -o option, one benchmark per line
+ */
+static void _readBaseline(void) {
+        FILE *f = fopen(bench.baseline, "r");
+        if (! f) {
+                fprintf(stderr, "Cannot read the baseline %s -- %s\n", bench.baseline, STRERROR);
+                exit(1);
+        }
+        char line[1024];
+        while (fgets(line, sizeof(line), f)) {
+                char name[256];
+                double median;
+                if (sscanf(line, " {\"name\": \"%255[^\"]\", \"operations\": %*d, \"median\": %lf", name, &median) == 2)
+                        for (int i = 0; i < BENCHMARKS; i++)
+                                if (Str_isEqual(benchmarks[i].name, name))
+                                        benchmarks[i].result.baseline = median;
+        }
+        fclose(f);
+}
+
+
+static void _writeOutput(void) {
+        FILE *f = fopen(bench.output, "w");
+        if (! f) {
+                fprintf(stderr, "Cannot write %s -- %s\n", bench.output, STRERROR);
+                exit(1);
+        }
+        fprintf(f, "{\"version\": \"%s\", \"runs\": %d, \"pids\": %d, \"services\": %d, \"benchmarks\": [\n", VERSION, bench.runs, bench.pids, bench.services);
+        bool first = true;
+        for (int i = 0; i < BENCHMARKS; i++) {
+                Benchmark_T *b = &benchmarks[i];
+                if (b->enabled) {
+                        fprintf(f, "%s  {\"name\": \"%s\", \"operations\": %d, \"median\": %.1f, \"mean\": %.1f, \"min\": %.1f}", first ? "" : ",\n", b->name, b->operations, b->result.median, b->result.mean, b->result.min);
+                        first = false;
+                }
+        }
+        fprintf(f, "\n]}\n");
+        fclose(f);
+}
+
+
+static void _help(const char *prog) {
+        printf("Usage: %s [options]\n"
+               "Options are as follows:\n"
+               " -n runs       Number of measured runs of each benchmark (default %d)\n"
+               " -p pids       Number of processes in the synthetic /proc snapshot (default %d)\n"
+               " -P directory  Use the recorded /proc snapshot in directory\n"
+               " -s services   Number of services in the generated control file (default %d)\n"
+               " -f filter     Run only the benchmarks which name contains the filter\n"
+               " -o file       Write the results in JSON format to file\n"
+               " -b file       Compare the results with the baseline JSON file\n"
+               " -t percent    Fail if a benchmark is slower than the baseline by more than percent (default %.0f)\n"
+               " -h            Print this text\n",
+               prog, BENCH_RUNS, BENCH_PIDS, BENCH_SERVICES, BENCH_THRESHOLD);
+}
+
+
+int main(int argc, char **argv) {
+        Bootstrap();
+        Bootstrap_setAbortHandler(vLogAbort);
+        Bootstrap_setErrorHandler(vLogError);
+        setlocale(LC_ALL, "C");
+        prog = "monitbench";
+        int opt;
+        while ((opt = getopt(argc, argv, "n:p:P:s:f:o:b:t:h")) != -1) {
+                switch (opt) {
+                        case 'n':
+                                bench.runs = MAX(1, atoi(optarg));
+                                break;
+                        case 'p':
+                                bench.pids = MAX(1, atoi(optarg));
+                                break;
+                        case 'P':
+                                bench.snapshot = optarg;
+                                break;
+                        case 's':
+                                bench.services = MAX(0, atoi(optarg));
+                                break;
+                        case 'f':
+                                bench.filter = optarg;
+                                break;
+                        case 'o':
+                                bench.output = optarg;
+                                break;
+                        case 'b':
+                                bench.baseline = optarg;
+                                break;
+                        case 't':
+                                bench.threshold = atof(optarg);
+                                break;
+                        default:
+                                _help(argv[0]);
+                                exit(opt == 'h' ? 0 : 1);
+                }
+        }
+#ifdef HAVE_OPENSSL
+        Ssl_start();
+#endif
+        init_env();
+        Mutex_init(Run.mutex);
+        if (init_system_info())
+                Run.flags |= Run_ProcessEngineEnabled;
+        _init();
+        if (bench.baseline)
+                _readBaseline();
+        monit_http(Httpd_Start);
+        for (int i = 0; i < 50 && access(bench.socket, F_OK) != 0; i++)
+                Time_usleep(100000);
+        int regressions = 0;
+        printf("%-24s %12s %12s %12s %12s\n", "Benchmark", "Median[ns]", "Mean[ns]", "Min[ns]", "Baseline");
+        for (int i = 0; i < BENCHMARKS; i++) {
+                Benchmark_T *b = &benchmarks[i];
+                if (bench.filter && ! strstr(b->name, bench.filter))
+                        continue;
+                b->enabled = true;
+                _measure(b);
+                printf("%-24s %12.1f %12.1f %12.1f", b->name, b->result.median, b->result.mean, b->result.min);
+                if (b->result.baseline > 0.) {
+                        double change = (b->result.median - b->result.baseline) * 100. / b->result.baseline;
+                        printf(" %+11.1f%%%s", change, change > bench.threshold ? " REGRESSION" : "");
+                        if (change > bench.threshold)
+                                regressions++;
+                }
+                printf("\n");
+        }
+        monit_http(Httpd_Stop);
+        if (bench.output)
+                _writeOutput();
+        return regressions ? 1 : 0;
+}
+
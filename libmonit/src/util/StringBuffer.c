@@ -54,6 +54,7 @@ struct T {
         int used;
         int length;
         unsigned char *buffer;
+        int compressedLength;
         void *compressedBuffer;
 };
 
@@ -61,6 +62,15 @@ struct T {
 /* ---------------------------------------------------------------- Private */
 
 
+/* Grow the buffer geometrically, so building a large string takes O(log n) reallocations */
+static inline void _grow(T S, int need) {
+        if (need > S->length) {
+                S->length = S->length * 2 > need ? S->length * 2 : need;
+                RESIZE(S->buffer, S->length);
+        }
+}
+
+
 static inline void _append(T S, const char *s, va_list ap) {
         va_list ap_copy;
         while (true) {
@@ -71,8 +81,7 @@ static inline void _append(T S, const char *s, va_list ap) {
                         S->used += n;
                         break;
                 }
-                S->length += STRLEN + n;
-                RESIZE(S->buffer, S->length);
+                _grow(S, S->used + n + 1);
         }
 }
 
@@ -103,6 +112,15 @@ T StringBuffer_create(int hint) {
 }
 
 
+T StringBuffer_reserve(T S, int size) {
+        assert(S);
+        if (size < 0)
+                THROW(AssertException, "Illegal size value");
+        _grow(S, size + 1);
+        return S;
+}
+
+
 void StringBuffer_free(T *S) {
         assert(S && *S);
         FREE((*S)->buffer);
@@ -153,11 +171,7 @@ int StringBuffer_replace(T S, const char *a, const char *b) {
                         size_t bl = strlen(b);
                         size_t diff = bl - strlen(a);
                         if (diff > 0) {
-                                size_t required = (diff * n) + S->used + 1;
-                                if (required >= S->length) {
-                                        S->length = (int)required;
-                                        RESIZE(S->buffer, S->length);
-                                }
+                                _grow(S, (int)((diff * n) + S->used + 1));
                         }
                         for (i = 0; m; i++) {
                                 if (S->buffer[i] == *a) {
@@ -262,7 +276,6 @@ T StringBuffer_clear(T S) {
         assert(S);
         S->used = 0;
         *S->buffer = 0;
-        FREE(S->compressedBuffer);
         return S;
 }
 
@@ -286,7 +299,10 @@ const void *StringBuffer_toCompressed(T S, int level, size_t *length) {
                 int status = deflateInit2(&zstream, level, Z_DEFLATED, 15 | 16, 8, Z_DEFAULT_STRATEGY);
                 if (status == Z_OK) {
                         int need = (int)deflateBound(&zstream, S->used);
-                        RESIZE(S->compressedBuffer, need);
+                        if (need > S->compressedLength) {
+                                RESIZE(S->compressedBuffer, need);
+                                S->compressedLength = need;
+                        }
                         zstream.next_out = S->compressedBuffer;
                         zstream.avail_out = need;
                         status = deflate(&zstream, Z_FINISH);
@@ -297,6 +313,7 @@ const void *StringBuffer_toCompressed(T S, int level, size_t *length) {
                         }
                 }
                 FREE(S->compressedBuffer);
+                S->compressedLength = 0;
                 THROW(AssertException, "compression failed: %s", zError(status));
         }
 #else
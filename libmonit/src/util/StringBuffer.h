@@ -65,6 +65,20 @@ T StringBuffer_new(const char *s);
 T StringBuffer_create(int hint);
 
 
+/**
+ * Ensures that the capacity of the buffer is at least equal to the given
+ * size, so that many appends up to this size need no reallocation. Use
+ * this method with the size of a previously built string as a size hint.
+ * The buffer grows geometrically when needed, independently of this method.
+ * @param S StringBuffer object
+ * @param size The minimum number of characters the buffer can hold
+ * @return a reference to this StringBuffer
+ * @exception AssertException if size is negative
+ * @exception MemoryException if allocation failed
+ */
+T StringBuffer_reserve(T S, int size);
+
+
 /**
  * Destroy a StringBuffer object and free allocated resources
  * @param S a StringBuffer object reference
@@ -192,6 +206,7 @@ int StringBuffer_length(T S);
 
 /**
  * Clears the contents of the string buffer and set buffer length to 0.
+ * The allocated memory is kept, so the buffer can be reused.
  * @param S StringBuffer object
  * @return a reference to this StringBuffer
  */
@@ -388,6 +388,26 @@ int main(void) {
         }
         printf("=> Test15: OK\n\n");
 #endif
+
+        printf("=> Test16: reserve and growth\n");
+        {
+                sb = StringBuffer_create(1);
+                StringBuffer_reserve(sb, 100000);
+                for (int i = 0; i < 10000; i++)
+                        StringBuffer_append(sb, "%09d\n", i);
+                assert(StringBuffer_length(sb) == 100000);
+                assert(Str_isEqual(StringBuffer_substring(sb, 99990), "000009999\n"));
+                StringBuffer_clear(sb);
+                assert(StringBuffer_length(sb) == 0);
+                for (int i = 0; i < 100000; i++)
+                        StringBuffer_append(sb, "%c", 'a' + i % 26);
+                assert(StringBuffer_length(sb) == 100000);
+                assert(StringBuffer_toString(sb)[99999] == 'a' + 99999 % 26);
+                StringBuffer_free(&sb);
+                assert(sb == NULL);
+        }
+        printf("=> Test16: OK\n\n");
+
         printf("============> StringBuffer Tests: OK\n\n");
 
         return 0;
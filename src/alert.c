@@ -309,9 +309,15 @@ Handler_Type handle_alert(Event_T E) {
                 for (Mail_T m = Run.maillist; m; m = m->next)
                         if (! _hasRecipient(s->maillist, m->to))
                                 _appendMail(list, m, E, host);
-                if (List_length(list))
-                        if (_send(list))
+                if (List_length(list)) {
+                        if (_send(list)) {
                                 rv = Handler_Alert;
+                        } else {
+                                int64_t latency = Time_micro() - ((int64_t)E->collected.tv_sec * 1000000LL + E->collected.tv_usec);
+                                if (latency >= 0)
+                                        Histogram_record(&(Run.profile.notification), latency);
+                        }
+                }
                 List_free(&list);
         }
         return rv;
@@ -0,0 +1,449 @@
+/*
+ * Copyright (C) Tildeslash Ltd. All rights reserved.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ *
+ * You must obey the GNU Affero General Public License in all respects
+ * for all of the code used other than OpenSSL.
+ */
+
+
+#include "xconfig.h"
+
+#ifdef HAVE_STDIO_H
+#include <stdio.h>
+#endif
+
+#ifdef HAVE_STDLIB_H
+#include <stdlib.h>
+#endif
+
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+
+#ifdef HAVE_FCNTL_H
+#include <fcntl.h>
+#endif
+
+#ifdef HAVE_STRING_H
+#include <string.h>
+#endif
+
+#ifdef HAVE_ERRNO_H
+#include <errno.h>
+#endif
+
+#ifdef HAVE_GLOB_H
+#include <glob.h>
+#endif
+
+#ifdef HAVE_SYS_STAT_H
+#include <sys/stat.h>
+#endif
+
+#include "monit.h"
+#include "md5.h"
+#include "configcache.h"
+
+// libmonit
+#include "util/List.h"
+#include "exceptions/AssertException.h"
+#include "exceptions/IOException.h"
+
+
+/**
+ * Implementation of the configuration cache. The cache file layout is:
+ *
+ *   magic[8], version, inputs count, inputs, key[16], payload length,
+ *   payload checksum[16], payload
+ *
+ * The inputs are the control file, the included files and the include
+ * patterns in the order they were read by the parser, the key is computed
+ * from the current content of the inputs. The payload holds the global
+ * configuration used by the command line client.
+ *
+ * @file
+ */
+
+
+/* ----------------------------------------------------------- MARK: - Definitions */
+
+
+#define CONFIGCACHE_MAGIC   "MONITCC"
+#define CONFIGCACHE_VERSION 1
+#define CONFIGCACHE_FLAGS   (Run_Log | Run_UseSyslog | Run_FipsEnabled)
+
+
+typedef struct Image_T {
+        unsigned char *data;
+        size_t length;
+        size_t size;
+        size_t position;                                   /**< Read position */
+} *Image_T;
+
+
+static struct {
+        bool initialized;
+        bool usable;     /**< false if the files were set on the command line */
+        List_T inputs; /**< Files ('f' prefix) and patterns ('p') read by the parser */
+} cache = {};
+
+
+/* ------------------------------------------------------------------ MARK: - Private */
+
+
+static char *_path(char path[PATH_MAX]) {
+        snprintf(path, PATH_MAX, "%s.cache", Run.files.control);
+        return path;
+}
+
+
+/**
+ * The cache holds the HTTP interface credentials, it must have the same
+ * constraints as the control file
+ */
+static bool _isSecure(struct stat *st) {
+        return S_ISREG(st->st_mode) && st->st_uid == geteuid() && ! (st->st_mode & 077);
+}
+
+
+static void _put(Image_T I, const void *data, size_t length) {
+        if (I->length + length > I->size) {
+                I->size = MAX(I->size * 2, I->length + length);
+                RESIZE(I->data, I->size);
+        }
+        memcpy(I->data + I->length, data, length);
+        I->length += length;
+}
+
+
+static void _putInt(Image_T I, int32_t value) {
+        _put(I, &value, sizeof(value));
+}
+
+
+static void _putString(Image_T I, const char *s) {
+        int32_t length = s ? (int32_t)strlen(s) : -1;
+        _putInt(I, length);
+        if (s)
+                _put(I, s, length);
+}
+
+
+static void _get(Image_T I, void *data, size_t length) {
+        if (I->position + length > I->length)
+                THROW(IOException, "truncated file");
+        memcpy(data, I->data + I->position, length);
+        I->position += length;
+}
+
+
+static int32_t _getInt(Image_T I) {
+        int32_t value;
+        _get(I, &value, sizeof(value));
+        return value;
+}
+
+
+static char *_getString(Image_T I) {
+        int32_t length = _getInt(I);
+        if (length < 0)
+                return NULL;
+        if (I->position + length > I->length)
+                THROW(IOException, "truncated file");
+        char *s = Str_ndup((const char *)I->data + I->position, length);
+        I->position += length;
+        return s;
+}
+
+
+static void _hashFile(md5_context_t *ctx, const char *path) {
+        int fd = open(path, O_RDONLY | O_CLOEXEC);
+        if (fd >= 0) {
+                ssize_t n;
+                unsigned char buf[65536];
+                while ((n = read(fd, buf, sizeof(buf))) > 0 || (n < 0 && errno == EINTR))
+                        if (n > 0)
+                                md5_append(ctx, buf, (int)n);
+                close(fd);
+        } else {
+                md5_append(ctx, (const md5_byte_t *)"-", 1);
+        }
+}
+
+
+static void _hashPattern(md5_context_t *ctx, const char *pattern) {
+        glob_t globbuf;
+        if (glob(pattern, GLOB_MARK, NULL, &globbuf) == 0) {
+                for (size_t i = 0; i < globbuf.gl_pathc; i++)
+                        md5_append(ctx, (const md5_byte_t *)globbuf.gl_pathv[i], (int)strlen(globbuf.gl_pathv[i]) + 1);
+                globfree(&globbuf);
+        }
+}
+
+
+/**
+ * Compute the cache key from the current content of the inputs. The host
+ * name and working directory are part of the key, as the configuration may
+ * use $HOST and relative include patterns
+ */
+static void _key(List_T inputs, MD_T key) {
+        md5_context_t ctx;
+        char buf[PATH_MAX] = {};
+        md5_init(&ctx);
+        md5_append(&ctx, (const md5_byte_t *)VERSION, sizeof(VERSION));
+        if (gethostname(buf, sizeof(buf)) == 0)
+                md5_append(&ctx, (const md5_byte_t *)buf, (int)strlen(buf) + 1);
+        if (getcwd(buf, sizeof(buf)))
+                md5_append(&ctx, (const md5_byte_t *)buf, (int)strlen(buf) + 1);
+        for (list_t p = inputs->head; p; p = p->next) {
+                char *input = p->e;
+                md5_append(&ctx, (const md5_byte_t *)input, (int)strlen(input) + 1);
+                if (*input == 'f')
+                        _hashFile(&ctx, input + 1);
+                else
+                        _hashPattern(&ctx, input + 1);
+        }
+        md5_finish(&ctx, (md5_byte_t *)key);
+}
+
+
+static void _checksum(const unsigned char *data, size_t length, MD_T checksum) {
+        md5_context_t ctx;
+        md5_init(&ctx);
+        md5_append(&ctx, data, (int)length);
+        md5_finish(&ctx, (md5_byte_t *)checksum);
+}
+
+
+static void _freeInputs(List_T inputs) {
+        while (List_length(inputs) > 0) {
+                char *input = List_pop(inputs);
+                FREE(input);
+        }
+}
+
+
+static void _saveConfig(Image_T I) {
+        _putInt(I, Run.flags & CONFIGCACHE_FLAGS);
+        _putInt(I, Run.facility);
+        _put(I, &(Run.limits), sizeof(Run.limits));
+        _putString(I, Run.files.log);
+        _putString(I, Run.files.pid);
+        _putString(I, Run.files.id);
+        _putString(I, Run.files.state);
+        _putInt(I, Run.httpd.flags);
+        _putInt(I, Run.httpd.socket.net.port);
+        _putString(I, Run.httpd.socket.net.address);
+        _putInt(I, Run.httpd.socket.net.ssl.flags);
+        _putInt(I, Run.httpd.socket.net.ssl.verify);
+        _putInt(I, Run.httpd.socket.net.ssl.allowSelfSigned);
+        _putInt(I, Run.httpd.socket.net.ssl.version);
+        _putInt(I, Run.httpd.socket.net.ssl.checksumType);
+        _putString(I, Run.httpd.socket.net.ssl.checksum);
+        _putString(I, Run.httpd.socket.net.ssl.pemfile);
+        _putString(I, Run.httpd.socket.net.ssl.clientpemfile);
+        _putString(I, Run.httpd.socket.net.ssl.ciphers);
+        _putString(I, Run.httpd.socket.net.ssl.CACertificateFile);
+        _putString(I, Run.httpd.socket.net.ssl.CACertificatePath);
+        _putInt(I, Run.httpd.socket.unix.uid);
+        _putInt(I, Run.httpd.socket.unix.gid);
+        _putInt(I, Run.httpd.socket.unix.permission);
+        _putString(I, Run.httpd.socket.unix.path);
+        for (Auth_T c = Run.httpd.credentials; c; c = c->next) {
+                _putInt(I, 1);
+                _putString(I, c->uname);
+                _putString(I, c->passwd);
+                _putString(I, c->groupname);
+                _putInt(I, c->digesttype);
+                _putInt(I, c->is_readonly);
+        }
+        _putInt(I, 0);
+}
+
+
+static void _loadConfig(Image_T I) {
+        Run.flags |= _getInt(I);
+        Run.facility = _getInt(I);
+        _get(I, &(Run.limits), sizeof(Run.limits));
+        Run.files.log = _getString(I);
+        Run.files.pid = _getString(I);
+        Run.files.id = _getString(I);
+        Run.files.state = _getString(I);
+        Run.httpd.flags = _getInt(I);
+        Run.httpd.socket.net.port = _getInt(I);
+        Run.httpd.socket.net.address = _getString(I);
+        Run.httpd.socket.net.ssl.flags = _getInt(I);
+        Run.httpd.socket.net.ssl.verify = _getInt(I);
+        Run.httpd.socket.net.ssl.allowSelfSigned = _getInt(I);
+        Run.httpd.socket.net.ssl.version = _getInt(I);
+        Run.httpd.socket.net.ssl.checksumType = _getInt(I);
+        Run.httpd.socket.net.ssl.checksum = _getString(I);
+        Run.httpd.socket.net.ssl.pemfile = _getString(I);
+        Run.httpd.socket.net.ssl.clientpemfile = _getString(I);
+        Run.httpd.socket.net.ssl.ciphers = _getString(I);
+        Run.httpd.socket.net.ssl.CACertificateFile = _getString(I);
+        Run.httpd.socket.net.ssl.CACertificatePath = _getString(I);
+        Run.httpd.socket.unix.uid = _getInt(I);
+        Run.httpd.socket.unix.gid = _getInt(I);
+        Run.httpd.socket.unix.permission = _getInt(I);
+        Run.httpd.socket.unix.path = _getString(I);
+        for (Auth_T *c = &(Run.httpd.credentials); _getInt(I); c = &((*c)->next)) {
+                NEW(*c);
+                (*c)->uname = _getString(I);
+                (*c)->passwd = _getString(I);
+                (*c)->groupname = _getString(I);
+                (*c)->digesttype = _getInt(I);
+                (*c)->is_readonly = _getInt(I);
+        }
+#ifdef HAVE_OPENSSL
+        Ssl_setFipsMode(Run.flags & Run_FipsEnabled);
+#endif
+}
+
+
+/* ------------------------------------------------------------------- MARK: - Public */
+
+
+bool ConfigCache_load() {
+        ConfigCache_reset();
+        if (! cache.usable)
+                return false;
+        char path[PATH_MAX];
+        struct stat st;
+        // The control file must pass the same security check as when it is parsed
+        if (stat(Run.files.control, &st) != 0 || ! _isSecure(&st))
+                return false;
+        int fd = open(_path(path), O_RDONLY | O_CLOEXEC);
+        if (fd < 0)
+                return false;
+        bool loaded = false;
+        struct Image_T image = {};
+        List_T inputs = List_new();
+        TRY
+        {
+                if (fstat(fd, &st) != 0 || ! _isSecure(&st))
+                        THROW(IOException, "insecure file permissions");
+                image.data = ALLOC(st.st_size > 0 ? st.st_size : 1);
+                image.length = st.st_size;
+                if (read(fd, image.data, image.length) != (ssize_t)image.length)
+                        THROW(IOException, "cannot read -- %s", STRERROR);
+                char magic[sizeof(CONFIGCACHE_MAGIC)];
+                _get(&image, magic, sizeof(magic));
+                if (memcmp(magic, CONFIGCACHE_MAGIC, sizeof(magic)) != 0 || _getInt(&image) != CONFIGCACHE_VERSION)
+                        THROW(IOException, "incompatible file");
+                for (int count = _getInt(&image); count > 0; count--)
+                        List_append(inputs, _getString(&image));
+                MD_T key, savedKey, checksum, savedChecksum;
+                _get(&image, savedKey, 16);
+                _key(inputs, key);
+                if (memcmp(key, savedKey, 16) != 0)
+                        THROW(IOException, "configuration changed");
+                int32_t length = _getInt(&image);
+                _get(&image, savedChecksum, 16);
+                if (length < 0 || image.position + length != image.length)
+                        THROW(IOException, "truncated file");
+                _checksum(image.data + image.position, length, checksum);
+                if (memcmp(checksum, savedChecksum, 16) != 0)
+                        THROW(IOException, "checksum mismatch");
+                _loadConfig(&image);
+                loaded = true;
+                DEBUG("Configuration loaded from the cache '%s'\n", path);
+        }
+        ELSE
+        {
+                DEBUG("Configuration cache '%s' not used -- %s\n", path, Exception_frame.message);
+        }
+        FINALLY
+        {
+                close(fd);
+                FREE(image.data);
+                _freeInputs(inputs);
+                List_free(&inputs);
+        }
+        END_TRY;
+        return loaded;
+}
+
+
+void ConfigCache_save() {
+        char path[PATH_MAX];
+        if (! (Run.flags & Run_ConfigCache)) {
+                if (unlink(_path(path)) == 0)
+                        DEBUG("Configuration cache '%s' removed\n", path);
+                return;
+        }
+        if (! cache.usable || ! cache.inputs)
+                return;
+        MD_T key, checksum;
+        struct Image_T payload = {}, image = {};
+        _saveConfig(&payload);
+        _checksum(payload.data, payload.length, checksum);
+        _key(cache.inputs, key);
+        _put(&image, CONFIGCACHE_MAGIC, sizeof(CONFIGCACHE_MAGIC));
+        _putInt(&image, CONFIGCACHE_VERSION);
+        _putInt(&image, List_length(cache.inputs));
+        for (list_t p = cache.inputs->head; p; p = p->next)
+                _putString(&image, p->e);
+        _put(&image, key, 16);
+        _putInt(&image, (int32_t)payload.length);
+        _put(&image, checksum, 16);
+        _put(&image, payload.data, payload.length);
+        // Write the new cache to a temporary file and replace the old one atomically
+        char temp[PATH_MAX + 8];
+        snprintf(temp, sizeof(temp), "%s.XXXXXX", _path(path));
+        int fd = mkstemp(temp);
+        if (fd < 0) {
+                DEBUG("Cannot create the configuration cache '%s' -- %s\n", temp, STRERROR);
+        } else {
+                bool written = write(fd, image.data, image.length) == (ssize_t)image.length;
+                if (close(fd) != 0 || ! written || rename(temp, path) != 0) {
+                        DEBUG("Cannot write the configuration cache '%s' -- %s\n", path, STRERROR);
+                        unlink(temp);
+                }
+        }
+        FREE(payload.data);
+        FREE(image.data);
+}
+
+
+void ConfigCache_reset() {
+        if (! cache.initialized) {
+                // The files set on the command line override the control file, the cache is not used then
+                cache.usable = ! Run.files.log && ! Run.files.pid && ! Run.files.id && ! Run.files.state;
+                cache.inputs = List_new();
+                cache.initialized = true;
+        }
+        _freeInputs(cache.inputs);
+}
+
+
+void ConfigCache_addFile(const char *path) {
+        ASSERT(path);
+        if (cache.initialized)
+                List_append(cache.inputs, Str_cat("f%s", path));
+}
+
+
+void ConfigCache_addPattern(const char *pattern) {
+        ASSERT(pattern);
+        if (cache.initialized)
+                List_append(cache.inputs, Str_cat("p%s", pattern));
+}
+
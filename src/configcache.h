@@ -0,0 +1,85 @@
+/*
+ * Copyright (C) Tildeslash Ltd. All rights reserved.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ *
+ * You must obey the GNU Affero General Public License in all respects
+ * for all of the code used other than OpenSSL.
+ */
+
+#ifndef MONIT_CONFIGCACHE_H
+#define MONIT_CONFIGCACHE_H
+
+
+/**
+ * Configuration cache for the command line client.
+ *
+ * The client actions which only talk to the Monit daemon (status, summary,
+ * report, reload and quit) need just the global part of the configuration:
+ * the HTTP interface address and credentials, the log, pid and state files
+ * and the limits. If the "set configcache" statement is used, this part of
+ * the configuration is saved to a binary file next to the control file
+ * ("<control file>.cache") whenever the control file is parsed. The client
+ * then loads it with a single read instead of parsing the whole control file.
+ *
+ * The cache is keyed by a hash of the Monit version, the host name, the
+ * working directory, the content of the control file and all included files
+ * and the list of files matched by each include pattern. If any of them
+ * changed, the cache is stale and the control file is parsed.
+ *
+ *  @file
+ */
+
+
+/**
+ * Load the configuration from the cache.
+ * @return true if the cache is valid and was loaded, false if the
+ * control file has to be parsed
+ */
+bool ConfigCache_load(void);
+
+
+/**
+ * Save the configuration to the cache if the "set configcache" statement
+ * is used, otherwise remove the cache file
+ */
+void ConfigCache_save(void);
+
+
+/**
+ * Forget the files read by the parser. Called by the parser when it starts
+ * reading the control file
+ */
+void ConfigCache_reset(void);
+
+
+/**
+ * Register a configuration file read by the parser
+ * @param path The file path
+ */
+void ConfigCache_addFile(const char *path);
+
+
+/**
+ * Register an include pattern used by the parser
+ * @param pattern The include glob(3) pattern
+ */
+void ConfigCache_addPattern(const char *pattern);
+
+
+#endif
@@ -226,7 +226,7 @@ static bool _doStart(Service_T s) {
         bool rv = true;
         StringBuffer_T sb = StringBuffer_create(64);
         for (Dependant_T d = s->dependantlist; d; d = d->next ) {
-                Service_T parent = Util_getService(d->dependant);
+                Service_T parent = d->service;
                 ASSERT(parent);
                 if (parent->monitor != Monitor_Yes || parent->error) {
                         if (_doStart(parent)) {
@@ -355,7 +355,7 @@ static bool _doRestart(Service_T s) {
 static void _doMonitor(Service_T s) {
         ASSERT(s);
         for (Dependant_T d = s->dependantlist; d; d = d->next ) {
-                Service_T parent = Util_getService(d->dependant);
+                Service_T parent = d->service;
                 ASSERT(parent);
                 _doMonitor(parent);
         }
@@ -385,7 +385,7 @@ static bool _doDepend(Service_T s, Action_Type action, bool unmonitor) {
         bool rv = true;
         for (Service_T child = servicelist; child; child = child->next) {
                 for (Dependant_T d = child->dependantlist; d; d = d->next) {
-                        if (IS(d->dependant, s->name)) {
+                        if (d->service == s) {
                                 if (action == Action_Start) {
                                         // (re)start children only if it's monitoring is enabled (we keep monitoring flag during restart, allowing to restore original pre-restart configuration)
                                         if (child->monitor != Monitor_Not && ! _doStart(child))
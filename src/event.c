@@ -78,6 +78,10 @@
 
 /* ----------------------------------------------------- MARK: - Definitions */
 
+
+#define EVENTINDEX_SIZE 8
+
+
 EventTable_T Event_Table[] = {
         {Event_Action,     "Action done",               "Action done",                "Action done",              "Action done",                  State_None},
         {Event_ByteIn,     "Download bytes exceeded",   "Download bytes ok",          "Download bytes changed",   "Download bytes not changed",   State_None},
@@ -118,6 +122,68 @@ EventTable_T Event_Table[] = {
 /* --------------------------------------------------------- MARK: - Private */
 
 
+/**
+ * Return the slot of the event with the given id and action in the service
+ * event index. The index uses open addressing with linear probing, if the
+ * event is not indexed, the empty slot for it is returned
+ */
+static Event_T *_slot(Service_T S, long id, EventAction_T action) {
+        unsigned int mask = S->eventindex.size - 1;
+        unsigned int i = (unsigned int)(((uintptr_t)action >> 4) ^ ((unsigned long)id * 2654435761u)) & mask;
+        while (S->eventindex.table[i] && ! (S->eventindex.table[i]->id == id && S->eventindex.table[i]->action == action))
+                i = (i + 1) & mask;
+        return &S->eventindex.table[i];
+}
+
+
+static Event_T _findEvent(Service_T S, long id, EventAction_T action) {
+        return S->eventindex.table ? *_slot(S, id, action) : NULL;
+}
+
+
+/**
+ * Add the event to the service event list and index. The index grows when
+ * it is three-quarters full
+ */
+static void _addEvent(Service_T S, Event_T E) {
+        E->next = S->eventlist;
+        S->eventlist = E;
+        if (++S->eventindex.count * 4 > S->eventindex.size * 3) {
+                int size = S->eventindex.size ? S->eventindex.size * 2 : EVENTINDEX_SIZE;
+                FREE(S->eventindex.table);
+                S->eventindex.table = CALLOC(size, sizeof(Event_T));
+                S->eventindex.size = size;
+                for (Event_T e = S->eventlist; e; e = e->next)
+                        *_slot(S, e->id, e->action) = e;
+        } else {
+                *_slot(S, E->id, E->action) = E;
+        }
+}
+
+
+/**
+ * Test if the event handler ignores the event: recurrent succeeded events
+ * and insufficient succeeded events during failed service state are only
+ * logged in debug mode
+ */
+static bool _isIgnored(Event_T E) {
+        return ! E->state_changed && (E->state == State_Succeeded || E->state == State_ChangedNot || ((E->state_map & 0x1) ^ 0x1));
+}
+
+
+/**
+ * Log the message of an event which is not handled in debug mode. The
+ * message is formatted on the stack only if debug is enabled
+ */
+static void _debug(Service_T S, const char *s, va_list ap) {
+        if (Run.debug) {
+                char message[1024];
+                vsnprintf(message, sizeof(message), s, ap);
+                DEBUG("'%s' %s\n", S->name, message);
+        }
+}
+
+
 static void _saveState(long id, State_Type state) {
         EventTable_T *et = Event_Table;
         while ((*et).id) {
@@ -342,8 +408,8 @@ static void _handleEvent(Service_T S, Event_T E) {
         /* We will handle only first succeeded event, recurrent succeeded events
          * or insufficient succeeded events during failed service state are
          * ignored. Failed events are handled each time. */
-        if (! E->state_changed && (E->state == State_Succeeded || E->state == State_ChangedNot || ((E->state_map & 0x1) ^ 0x1))) {
-                DEBUG("'%s' %s\n", S->name, E->message);
+        if (_isIgnored(E)) {
+                DEBUG("'%s' %s\n", S->name, NVLSTR(E->message));
                 return;
         }
 
@@ -407,31 +473,19 @@ void Event_post(Service_T service, long id, State_Type state, EventAction_T acti
         _saveState(id, state);
 
         va_list ap;
-        va_start(ap, s);
-        char *message = Str_vcat(s, ap);
-        va_end(ap);
-
-        Event_T e = service->eventlist;
-        while (e) {
-                if (e->action == action && e->id == id) {
-                        gettimeofday(&e->collected, NULL);
-
-                        /* Shift the existing event flags to the left and set the first bit based on actual state */
-                        e->state_map <<= 1;
-                        e->state_map |= ((state == State_Succeeded || state == State_ChangedNot) ? 0 : 1);
+        Event_T e = _findEvent(service, id, action);
+        if (e) {
+                gettimeofday(&e->collected, NULL);
 
-                        /* Update the message */
-                        FREE(e->message);
-                        e->message = message;
-                        break;
-                }
-                e = e->next;
-        }
-        if (! e) {
+                /* Shift the existing event flags to the left and set the first bit based on actual state */
+                e->state_map <<= 1;
+                e->state_map |= ((state == State_Succeeded || state == State_ChangedNot) ? 0 : 1);
+        } else {
                 /* Only first failed/changed event can initialize the queue for given event type, thus succeeded events are ignored until first error. */
                 if (state == State_Succeeded || state == State_ChangedNot) {
-                        DEBUG("'%s' %s\n", service->name, message);
-                        FREE(message);
+                        va_start(ap, s);
+                        _debug(service, s, ap);
+                        va_end(ap);
                         return;
                 }
                 /* Initialize the event. The mandatory informations are cloned so the event is as standalone as possible and may be saved
@@ -445,9 +499,7 @@ void Event_post(Service_T service, long id, State_Type state, EventAction_T acti
                 e->state = State_Init;
                 e->state_map = 1;
                 e->action = action;
-                e->message = message;
-                e->next = service->eventlist;
-                service->eventlist = e;
+                _addEvent(service, e);
         }
         e->state_changed = _checkState(e, state);
         /* In the case that the state changed, update it and reset the counter */
@@ -457,7 +509,20 @@ void Event_post(Service_T service, long id, State_Type state, EventAction_T acti
         } else {
                 e->count++;
         }
+        /* The message is formatted only if the event will be handled, the event keeps the message of the last handled post */
+        if (_isIgnored(e)) {
+                va_start(ap, s);
+                _debug(service, s, ap);
+                va_end(ap);
+                return;
+        }
+        FREE(e->message);
+        va_start(ap, s);
+        e->message = Str_vcat(s, ap);
+        va_end(ap);
+        int64_t start = Time_micro();
         _handleEvent(service, e);
+        Histogram_record(&(Run.profile.event), MAX(0, Time_micro() - start));
 }
 
 
@@ -538,6 +603,20 @@ const char *Event_get_action_description(Event_T E) {
 }
 
 
+/**
+ * Remove all events of the service
+ * @param S The service
+ */
+void Event_clear(Service_T S) {
+        ASSERT(S);
+        if (S->eventlist)
+                gc_event(&S->eventlist);
+        FREE(S->eventindex.table);
+        S->eventindex.size = 0;
+        S->eventindex.count = 0;
+}
+
+
 /**
  * Reprocess the partially handled event queue
  */
@@ -138,6 +138,13 @@ Action_Type Event_get_action(Event_T E);
 const char *Event_get_action_description(Event_T E);
 
 
+/**
+ * Remove all events of the service
+ * @param S The service
+ */
+void Event_clear(Service_T S);
+
+
 /**
  * Reprocess the partialy handled event queue
  */
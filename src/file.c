@@ -272,9 +272,9 @@ bool file_readProc(char *buf, int buf_size, char *name, int pid, int *bytes_read
 
         char filename[STRLEN];
         if (pid < 0)
-                snprintf(filename, sizeof(filename), "/proc/%s", name);
+                snprintf(filename, sizeof(filename), "%s/%s", PROCFS, name);
         else
-                snprintf(filename, sizeof(filename), "/proc/%d/%s", pid, name);
+                snprintf(filename, sizeof(filename), "%s/%d/%s", PROCFS, pid, name);
 
         int fd = open(filename, O_RDONLY);
         if (fd < 0) {
@@ -39,6 +39,7 @@
 #include "protocol.h"
 #include "ProcessTree.h"
 #include "engine.h"
+#include "probe.h"
 
 
 /* Private prototypes */
@@ -91,13 +92,26 @@ static void _gcsecattr(SecurityAttribute_T *);
 
 
 void gc() {
-        Engine_destroyAllow();
         if (Run.flags & Run_ProcessEngineEnabled)
                 ProcessTree_delete();
-        if (servicelist)
-                _gc_service_list(&servicelist);
-        if (servicegrouplist)
-                _gc_servicegroup(&servicegrouplist);
+        gc_services(&servicelist, &servicegrouplist);
+        Util_resetServiceIndex();
+        gc_config();
+}
+
+
+void gc_services(Service_T *services, ServiceGroup_T *groups) {
+        ASSERT(services);
+        ASSERT(groups);
+        if (*services)
+                _gc_service_list(services);
+        if (*groups)
+                _gc_servicegroup(groups);
+}
+
+
+void gc_config() {
+        Engine_destroyAllow();
         if (Run.httpd.credentials)
                 _gcath(&Run.httpd.credentials);
         if (Run.maillist)
@@ -271,6 +285,7 @@ static void _gc_service(Service_T *s) {
                 _gc_eventaction(&(*s)->action_ACTION);
         if ((*s)->eventlist)
                 gc_event(&(*s)->eventlist);
+        FREE((*s)->eventindex.table);
         if ((*s)->secattrlist)
                 _gcsecattr(&(*s)->secattrlist);
         switch ((*s)->type) {
@@ -291,6 +306,7 @@ static void _gc_service(Service_T *s) {
                         FREE((*s)->inf.net);
                         break;
                 case Service_Process:
+                case Service_Cgroup:
                         FREE((*s)->inf.process);
                         break;
                 default:
@@ -298,6 +314,7 @@ static void _gc_service(Service_T *s) {
         }
         FREE((*s)->name);
         FREE((*s)->path);
+        FREE((*s)->labels);
         (*s)->next = NULL;
         FREE(*s);
 }
@@ -374,6 +391,9 @@ static void _gcportlist(Port_T *p) {
                 _gc_eventaction(&(*p)->action);
         if ((*p)->url_request)
                 _gc_request(&(*p)->url_request);
+        if ((*p)->connection)
+                Socket_free(&(*p)->connection);
+        Probe_detach(*p);
         if ((*p)->family == Socket_Unix)
                 FREE((*p)->target.unix.pathname);
         else
@@ -126,6 +126,14 @@ void monit_http(Httpd_Action action) {
                         LogDebug("Monit HTTP server started\n");
                         running = true;
                         break;
+                case Httpd_Suspend:
+                        if (running)
+                                Engine_suspend();
+                        break;
+                case Httpd_Resume:
+                        if (running)
+                                Engine_resume();
+                        break;
                 default:
                         LogError("Monit: Unknown http server action\n");
                         break;
@@ -68,6 +68,10 @@
 #include <ctype.h>
 #endif
 
+#ifdef HAVE_FCNTL_H
+#include <fcntl.h>
+#endif
+
 // libmonit
 #include "system/Time.h"
 #include "util/Fmt.h"
@@ -102,10 +106,26 @@
 #define REPORT      "/_report"
 #define RUNTIME     "/_runtime"
 #define VIEWLOG     "/_viewlog"
+#define METRICS     "/_metrics"
 #define DOACTION    "/_doaction"
 #define FAVICON     "/favicon.ico"
 
 
+/* Log viewer */
+#define VIEWLOG_BLOCK  65536     /* Log file read block size */
+#define VIEWLOG_FLUSH  65536     /* Flush the response when the output buffer exceeds this size */
+#define VIEWLOG_LINES  1000      /* Default number of lines to show */
+#define VIEWLOG_LENGTH 1048576   /* Default page size when the log is shown by offset */
+
+
+/* Metrics */
+#define METRICS_FLUSH  65536     /* Flush the response when the output buffer exceeds this size */
+
+
+/* Runtime profile */
+#define PROFILE_TOP    10        /* Number of the slowest services to show */
+
+
 typedef enum {
         TXT = 0,
         HTML
@@ -134,6 +154,7 @@ static void do_ping(HttpResponse);
 static void do_getid(HttpResponse);
 static void do_runtime(HttpRequest, HttpResponse);
 static void do_viewlog(HttpRequest, HttpResponse);
+static void do_metrics(HttpResponse);
 static void handle_service(HttpRequest, HttpResponse);
 static void handle_service_action(HttpRequest, HttpResponse);
 static void handle_doaction(HttpRequest, HttpResponse);
@@ -298,6 +319,19 @@ static void _printIOStatistics(Output_Type type, HttpResponse res, Service_T s,
 }
 
 
+/**
+ * Print the pressure stall averages (avg10, avg60, avg300), if the pressure stall information is available
+ */
+static void _printPressure(Output_Type type, HttpResponse res, Service_T s, Pressure_T pressure, const char *header) {
+        if (pressure->some[0] >= 0.) {
+                if (pressure->full[0] >= 0.)
+                        _formatStatus(header, Event_Resource, type, res, s, true, "some [%.2f%%] [%.2f%%] [%.2f%%], full [%.2f%%] [%.2f%%] [%.2f%%]", pressure->some[0], pressure->some[1], pressure->some[2], pressure->full[0], pressure->full[1], pressure->full[2]);
+                else
+                        _formatStatus(header, Event_Resource, type, res, s, true, "some [%.2f%%] [%.2f%%] [%.2f%%]", pressure->some[0], pressure->some[1], pressure->some[2]);
+        }
+}
+
+
 static void _printStatus(Output_Type type, HttpResponse res, Service_T s) {
         if (Util_hasServiceStatus(s)) {
                 switch (s->type) {
@@ -312,8 +346,24 @@ static void _printStatus(Output_Type type, HttpResponse res, Service_T s) {
                                         , systeminfo.cpu.usage.wait > 0. ? systeminfo.cpu.usage.wait : 0.
 #endif
                                 );
+                                if (systeminfo.cpu.usage.steal >= 0.)
+                                        _formatStatus("cpu steal", Event_Resource, type, res, s, true, "%.1f%%st %.1f%%gu", systeminfo.cpu.usage.steal, systeminfo.cpu.usage.guest > 0. ? systeminfo.cpu.usage.guest : 0.);
+                                if (systeminfo.cpu.core.count > 0) {
+                                        StringBuffer_T cores = StringBuffer_create(systeminfo.cpu.core.count * 8);
+                                        for (int i = 0; i < systeminfo.cpu.core.count; i++) {
+                                                if (systeminfo.cpu.core.usage[i] >= 0.)
+                                                        StringBuffer_append(cores, "%s[%.1f%%]", i ? " " : "", systeminfo.cpu.core.usage[i]);
+                                                else
+                                                        StringBuffer_append(cores, "%s[-]", i ? " " : "");
+                                        }
+                                        _formatStatus("cpu cores", Event_Resource, type, res, s, true, "%s", StringBuffer_toString(cores));
+                                        StringBuffer_free(&cores);
+                                }
                                 _formatStatus("memory usage", Event_Resource, type, res, s, true, "%s [%.1f%%]", Fmt_ibyte(systeminfo.memory.usage.bytes, (char[10]){}), systeminfo.memory.usage.percent);
                                 _formatStatus("swap usage", Event_Resource, type, res, s, true, "%s [%.1f%%]", Fmt_ibyte(systeminfo.swap.usage.bytes, (char[10]){}), systeminfo.swap.usage.percent);
+                                _printPressure(type, res, s, &(systeminfo.pressure.cpu), "cpu pressure");
+                                _printPressure(type, res, s, &(systeminfo.pressure.memory), "memory pressure");
+                                _printPressure(type, res, s, &(systeminfo.pressure.io), "io pressure");
                                 _formatStatus("uptime", Event_Uptime, type, res, s, systeminfo.booted > 0, "%s", _getUptime(Time_now() - systeminfo.booted, (char[256]){}));
                                 _formatStatus("boot time", Event_Null, type, res, s, true, "%s", Time_string(systeminfo.booted, (char[32]){}));
                                 break;
@@ -433,6 +483,21 @@ static void _printStatus(Output_Type type, HttpResponse res, Service_T s) {
                                 }
                                 _printIOStatistics(type, res, s, &(s->inf.process->read), "disk read", "read");
                                 _printIOStatistics(type, res, s, &(s->inf.process->write), "disk write", "write");
+                                _printPressure(type, res, s, &(s->inf.process->pressure.cpu), "cpu pressure");
+                                _printPressure(type, res, s, &(s->inf.process->pressure.memory), "memory pressure");
+                                _printPressure(type, res, s, &(s->inf.process->pressure.io), "io pressure");
+                                break;
+
+                        case Service_Cgroup:
+                                _formatStatus("tasks", Event_Resource, type, res, s, s->inf.process->threads >= 0, "%d", s->inf.process->threads);
+                                _formatStatus("cpu total", Event_Resource, type, res, s, s->inf.process->total_cpu_percent >= 0, "%.1f%%", s->inf.process->total_cpu_percent);
+                                _formatStatus("memory", Event_Resource, type, res, s, s->inf.process->mem_percent >= 0, "%.1f%% [%s]", s->inf.process->mem_percent, Fmt_ibyte(s->inf.process->mem, (char[10]){}));
+                                _formatStatus("memory total", Event_Resource, type, res, s, s->inf.process->total_mem_percent >= 0, "%.1f%% [%s]", s->inf.process->total_mem_percent, Fmt_ibyte(s->inf.process->total_mem, (char[10]){}));
+                                _printIOStatistics(type, res, s, &(s->inf.process->read), "disk read", "read");
+                                _printIOStatistics(type, res, s, &(s->inf.process->write), "disk write", "write");
+                                _printPressure(type, res, s, &(s->inf.process->pressure.cpu), "cpu pressure");
+                                _printPressure(type, res, s, &(s->inf.process->pressure.memory), "memory pressure");
+                                _printPressure(type, res, s, &(s->inf.process->pressure.io), "io pressure");
                                 break;
 
                         case Service_Program:
@@ -459,6 +524,8 @@ static void _printStatus(Output_Type type, HttpResponse res, Service_T s) {
                                 if (p->target.net.ssl.options.flags)
                                         snprintf(buf, sizeof(buf), "using TLS (certificate valid for %d days) ", p->target.net.ssl.certificate.validDays);
                                 _formatStatus("port response time", p->target.net.ssl.certificate.validDays < p->target.net.ssl.certificate.minimumDays ? Event_Timestamp : Event_Null, type, res, s, p->is_available != Connection_Init, "%s to %s:%d%s type %s/%s %sprotocol %s", Fmt_ms(p->response, (char[11]){}), p->hostname, p->target.net.port, Util_portRequestDescription(p), Util_portTypeDescription(p), Util_portIpDescription(p), buf, p->protocol->name);
+                                if (p->keepalive)
+                                        _formatStatus("port connect time", Event_Null, type, res, s, p->is_available != Connection_Init, "%s", p->connect > 0. ? Fmt_ms(p->connect, (char[11]){}) : "connection reused");
                         }
                 }
                 for (Port_T p = s->socketlist; p; p = p->next) {
@@ -466,6 +533,8 @@ static void _printStatus(Output_Type type, HttpResponse res, Service_T s) {
                                 _formatStatus("unix socket response time", Event_Connection, type, res, s, true, "FAILED to %s type %s protocol %s", p->target.unix.pathname, Util_portTypeDescription(p), p->protocol->name);
                         } else {
                                 _formatStatus("unix socket response time", Event_Null, type, res, s, p->is_available != Connection_Init, "%s to %s type %s protocol %s", Fmt_ms(p->response, (char[11]){}), p->target.unix.pathname, Util_portTypeDescription(p), p->protocol->name);
+                                if (p->keepalive)
+                                        _formatStatus("unix socket connect time", Event_Null, type, res, s, p->is_available != Connection_Init, "%s", p->connect > 0. ? Fmt_ms(p->connect, (char[11]){}) : "connection reused");
                         }
                 }
         }
@@ -483,6 +552,8 @@ static void doPost(HttpRequest req, HttpResponse res) {
                 handle_runtime_action(req, res);
         else if (ACTION(VIEWLOG))
                 do_viewlog(req, res);
+        else if (ACTION(METRICS))
+                do_metrics(res);
         else if (ACTION(STATUS))
                 print_status(req, res, 1);
         else if (ACTION(STATUS2))
@@ -528,6 +599,8 @@ static void doGet(HttpRequest req, HttpResponse res) {
                 print_summary(req, res);
         } else if (ACTION(REPORT)) {
                 _printReport(req, res);
+        } else if (ACTION(METRICS)) {
+                do_metrics(res);
         } else {
                 handle_service(req, res);
         }
@@ -553,11 +626,12 @@ static void printFavicon(HttpResponse res) {
         }
         if (l) {
                 res->is_committed = true;
+                Socket_cork(S);
                 Socket_print(S, "HTTP/1.0 200 OK\r\n");
                 Socket_print(S, "Content-length: %lu\r\n", (unsigned long)l);
                 Socket_print(S, "Content-Type: image/x-icon\r\n");
                 Socket_print(S, "Connection: close\r\n\r\n");
-                if (Socket_write(S, favicon, l) < 0) {
+                if (Socket_write(S, favicon, l) < 0 || Socket_uncork(S) < 0) {
                         LogError("Error sending favicon data -- %s\n", STRERROR);
                 }
         }
@@ -702,10 +776,103 @@ static void do_getid(HttpResponse res) {
         StringBuffer_append(res->outputbuffer, "%s", Run.id);
 }
 
+/**
+ * Print the histogram summary row, the durations are printed in milliseconds
+ */
+static void _printProfileRow(HttpResponse res, bool html, const char *name, Histogram_T h) {
+        if (html) {
+                StringBuffer_append(res->outputbuffer, "<tr><td>");
+                escapeHTML(res->outputbuffer, name);
+                StringBuffer_append(res->outputbuffer,
+                                    "</td><td>%"PRIu64"</td><td>%.3f</td><td>%.3f</td><td>%.3f</td><td>%.3f</td><td>%.3f</td></tr>",
+                                    Histogram_count(h), Histogram_mean(h) / 1000., Histogram_percentile(h, 50) / 1000., Histogram_percentile(h, 90) / 1000., Histogram_percentile(h, 99) / 1000., Histogram_max(h) / 1000.);
+        } else {
+                StringBuffer_append(res->outputbuffer,
+                                    "%-40s %10"PRIu64" %10.3f %10.3f %10.3f %10.3f %10.3f\n",
+                                    name, Histogram_count(h), Histogram_mean(h) / 1000., Histogram_percentile(h, 50) / 1000., Histogram_percentile(h, 90) / 1000., Histogram_percentile(h, 99) / 1000., Histogram_max(h) / 1000.);
+        }
+}
+
+
+static void _printProfileHeader(HttpResponse res, bool html, const char *title) {
+        if (html)
+                StringBuffer_append(res->outputbuffer,
+                                    "<h2>%s</h2><table id='status-table'><tr>"
+                                    "<th width='40%%'>Name</th><th>Count</th><th>Mean [ms]</th><th>50%% [ms]</th><th>90%% [ms]</th><th>99%% [ms]</th><th>Max [ms]</th></tr>",
+                                    title);
+        else
+                StringBuffer_append(res->outputbuffer, "%-40s %10s %10s %10s %10s %10s %10s\n", title, "Count", "Mean[ms]", "50%[ms]", "90%[ms]", "99%[ms]", "Max[ms]");
+}
+
+
+static void _printProfileFooter(HttpResponse res, bool html) {
+        StringBuffer_append(res->outputbuffer, html ? "</table>" : "\n");
+}
+
+
+/**
+ * Print the Monit self-instrumentation data: the cycle, process tree collection, event handling and
+ * alert delivery durations, the check duration per service type and the services with the slowest checks
+ */
+static void _printProfile(HttpResponse res, bool html) {
+        _printProfileHeader(res, html, "Monit profile");
+        _printProfileRow(res, html, "Validation cycle", &(Run.profile.cycle));
+        _printProfileRow(res, html, "Validation cycle overrun", &(Run.profile.overrun));
+        _printProfileRow(res, html, "Process tree collection", &(Run.profile.processtree));
+        _printProfileRow(res, html, "Event handling", &(Run.profile.event));
+        _printProfileRow(res, html, "Alert delivery latency", &(Run.profile.notification));
+        for (int type = 0; type <= Service_Last; type++) {
+                if (Histogram_count(&(Run.profile.check[type]))) {
+                        char name[STRLEN];
+                        snprintf(name, sizeof(name), "%s checks", servicetypes[type]);
+                        _printProfileRow(res, html, name, &(Run.profile.check[type]));
+                }
+        }
+        _printProfileFooter(res, html);
+        // Select the services with the highest 99th percentile of the check wall time
+        int count = 0;
+        Service_T top[PROFILE_TOP];
+        uint64_t value[PROFILE_TOP];
+        for (Service_T s = servicelist; s; s = s->next) {
+                if (! Histogram_count(&(s->profile.wall)))
+                        continue;
+                uint64_t v = Histogram_percentile(&(s->profile.wall), 99);
+                int i = count < PROFILE_TOP ? count++ : PROFILE_TOP;
+                for (; i > 0 && value[i - 1] < v; i--) {
+                        if (i < PROFILE_TOP) {
+                                top[i] = top[i - 1];
+                                value[i] = value[i - 1];
+                        }
+                }
+                if (i < PROFILE_TOP) {
+                        top[i] = s;
+                        value[i] = v;
+                }
+        }
+        if (count) {
+                _printProfileHeader(res, html, "Slowest checks");
+                for (int i = 0; i < count; i++) {
+                        char name[STRLEN];
+                        snprintf(name, sizeof(name), "%s (CPU time)", top[i]->name);
+                        _printProfileRow(res, html, top[i]->name, &(top[i]->profile.wall));
+                        _printProfileRow(res, html, name, &(top[i]->profile.cpu));
+                }
+                _printProfileFooter(res, html);
+        }
+}
+
+
 static void do_runtime(HttpRequest req, HttpResponse res) {
         int pid = exist_daemon();
         char buf[STRLEN];
 
+        if (IS(get_parameter(req, "format"), "text")) {
+                set_content_type(res, "text/plain");
+                StringBuffer_append(res->outputbuffer, "Monit %s uptime: %s\n\n", VERSION, _getUptime(ProcessTree_getProcessUptime(getpid()), (char[256]){}));
+                _printProfile(res, false);
+                return;
+        }
+
         do_head(res, "_runtime", "Runtime", 1000);
         StringBuffer_append(res->outputbuffer,
                             "<h2>Monit runtime status</h2>");
@@ -818,9 +985,16 @@ static void do_runtime(HttpRequest req, HttpResponse res) {
         StringBuffer_append(res->outputbuffer, "<tr><td>Limit for Send/Expect buffer</td><td>%s</td></tr>", Fmt_ibyte(Run.limits.sendExpectBuffer, buf));
         StringBuffer_append(res->outputbuffer, "<tr><td>Limit for file content buffer</td><td>%s</td></tr>", Fmt_ibyte(Run.limits.fileContentBuffer, buf));
         StringBuffer_append(res->outputbuffer, "<tr><td>Limit for HTTP content buffer</td><td>%s</td></tr>", Fmt_ibyte(Run.limits.httpContentBuffer, buf));
+        StringBuffer_append(res->outputbuffer, "<tr><td>Limit for HTTP response body</td><td>%s</td></tr>", Fmt_ibyte(Run.limits.httpContentLimit, buf));
         StringBuffer_append(res->outputbuffer, "<tr><td>Limit for program output</td><td>%s</td></tr>", Fmt_ibyte(Run.limits.programOutput, buf));
         StringBuffer_append(res->outputbuffer, "<tr><td>Limit for network timeout</td><td>%s</td></tr>", Fmt_ms(Run.limits.networkTimeout, (char[11]){}));
         StringBuffer_append(res->outputbuffer, "<tr><td>Limit for check program timeout</td><td>%s</td></tr>", Fmt_ms(Run.limits.programTimeout, (char[11]){}));
+        if (Run.limits.programConcurrency)
+                StringBuffer_append(res->outputbuffer, "<tr><td>Limit for concurrent check programs</td><td>%u</td></tr>", Run.limits.programConcurrency);
+        if (Run.limits.probeCache)
+                StringBuffer_append(res->outputbuffer, "<tr><td>Limit for connection test result cache</td><td>%s</td></tr>", Fmt_ms(Run.limits.probeCache, (char[11]){}));
+        if (Run.limits.cycleBudget)
+                StringBuffer_append(res->outputbuffer, "<tr><td>Limit for validation cycle time budget</td><td>%s</td></tr>", Fmt_ms(Run.limits.cycleBudget, (char[11]){}));
         StringBuffer_append(res->outputbuffer, "<tr><td>Limit for service stop timeout</td><td>%s</td></tr>", Fmt_ms(Run.limits.stopTimeout, (char[11]){}));
         StringBuffer_append(res->outputbuffer, "<tr><td>Limit for service start timeout</td><td>%s</td></tr>", Fmt_ms(Run.limits.startTimeout, (char[11]){}));
         StringBuffer_append(res->outputbuffer, "<tr><td>Limit for service restart timeout</td><td>%s</td></tr>", Fmt_ms(Run.limits.restartTimeout, (char[11]){}));
@@ -854,6 +1028,7 @@ static void do_runtime(HttpRequest req, HttpResponse res) {
                             Run.httpd.credentials && Engine_hasAllow() ? "Basic Authentication and Host/Net allow list" : Run.httpd.credentials ? "Basic Authentication" : Engine_hasAllow() ? "Host/Net allow list" : "No authentication");
         print_alerts(res, Run.maillist);
         StringBuffer_append(res->outputbuffer, "</table>");
+        _printProfile(res, true);
         if (! is_readonly(req)) {
                 StringBuffer_append(res->outputbuffer,
                                     "<table id='buttons'><tr>");
@@ -893,36 +1068,700 @@ static void do_runtime(HttpRequest req, HttpResponse res) {
 }
 
 
+/**
+ * Return the positive number parameter value or the default value if the parameter is not set, zero or invalid
+ */
+static int64_t _getNumberParameter(HttpRequest req, const char *name, int64_t defaultValue) {
+        const char *value = get_parameter(req, name);
+        if (value && *value) {
+                char *end;
+                long long n = strtoll(value, &end, 10);
+                if (*end == 0 && n > 0)
+                        return n;
+        }
+        return defaultValue;
+}
+
+
+/**
+ * Test the log line against the optional filter. The line must be followed by a writable byte
+ */
+static bool _viewlogMatch(regex_t *filter, char *line, size_t length) {
+        if (! filter)
+                return true;
+        if (length && line[length - 1] == '\n')
+                length--;
+        char c = line[length];
+        line[length] = 0;
+        bool rv = regexec(filter, line, 0, NULL, 0) == 0;
+        line[length] = c;
+        return rv;
+}
+
+
+static void _viewlogPrint(HttpResponse res, bool html, char *data, size_t length) {
+        char c = data[length];
+        data[length] = 0;
+        if (html)
+                escapeHTML(res->outputbuffer, data);
+        else
+                StringBuffer_append(res->outputbuffer, "%s", data);
+        data[length] = c;
+}
+
+
+/**
+ * Return the offset of the first line at or after the given offset
+ */
+static off_t _viewlogAlign(int fd, off_t offset, off_t end) {
+        char block[VIEWLOG_BLOCK];
+        if (offset <= 0)
+                return 0;
+        // Start with the previous byte, so we don't skip a line if the offset points to the line start already
+        for (offset--; offset < end;) {
+                ssize_t n = pread(fd, block, MIN(sizeof(block), end - offset), offset);
+                if (n <= 0)
+                        break;
+                char *newline = memchr(block, '\n', n);
+                if (newline)
+                        return offset + (newline - block) + 1;
+                offset += n;
+        }
+        return end;
+}
+
+
+/**
+ * Scan the log backwards from the end and return the offset of the first of the last lines matching the filter
+ */
+static off_t _viewlogTail(int fd, off_t end, int64_t lines, regex_t *filter) {
+        char block[VIEWLOG_BLOCK + 1];
+        int64_t found = 0;
+        off_t blockEnd = end;
+        while (blockEnd > 0 && found < lines) {
+                size_t length = MIN(VIEWLOG_BLOCK, blockEnd);
+                off_t blockStart = blockEnd - length;
+                if (pread(fd, block, length, blockStart) != length)
+                        break;
+                block[length] = 0;
+                // The block ends at the line boundary, walk the complete lines backwards
+                size_t lineEnd = length;
+                while (lineEnd > 0) {
+                        ssize_t i = lineEnd - 2;
+                        while (i >= 0 && block[i] != '\n')
+                                i--;
+                        if (i < 0 && blockStart > 0)
+                                break; // Incomplete line, continue with the next block
+                        size_t lineStart = i + 1;
+                        if (_viewlogMatch(filter, block + lineStart, lineEnd - lineStart) && ++found == lines)
+                                return blockStart + lineStart;
+                        lineEnd = lineStart;
+                }
+                // If the line is longer then the block, skip the block
+                blockEnd = blockStart + (lineEnd == length ? 0 : lineEnd);
+        }
+        return 0;
+}
+
+
+/**
+ * Stream the log range to the client
+ */
+static void _viewlogRange(HttpResponse res, bool html, int fd, off_t start, off_t end, regex_t *filter) {
+        char block[VIEWLOG_BLOCK + 1];
+        for (off_t offset = start; offset < end;) {
+                ssize_t length = pread(fd, block, MIN(VIEWLOG_BLOCK, end - offset), offset);
+                if (length <= 0)
+                        break;
+                block[length] = 0;
+                if (! filter) {
+                        _viewlogPrint(res, html, block, length);
+                        offset += length;
+                } else {
+                        size_t lineStart = 0;
+                        for (size_t i = 0; i < length; i++) {
+                                if (block[i] == '\n') {
+                                        if (_viewlogMatch(filter, block + lineStart, i + 1 - lineStart))
+                                                _viewlogPrint(res, html, block + lineStart, i + 1 - lineStart);
+                                        lineStart = i + 1;
+                                }
+                        }
+                        // Last line without newline or line longer then the block
+                        if (lineStart == 0 || (lineStart < length && offset + length == end)) {
+                                if (_viewlogMatch(filter, block + lineStart, length - lineStart))
+                                        _viewlogPrint(res, html, block + lineStart, length - lineStart);
+                                lineStart = length;
+                        }
+                        offset += lineStart;
+                }
+                if (StringBuffer_length(res->outputbuffer) >= VIEWLOG_FLUSH && ! flush_response(res))
+                        break;
+        }
+}
+
+
+static void _viewlogButton(HttpResponse res, const char *label, off_t offset, int64_t length, const char *filter) {
+        StringBuffer_append(res->outputbuffer,
+                            "<td><form method=POST action='_viewlog'>"
+                            "<input type=hidden name='securitytoken' value='%s'>"
+                            "<input type=hidden name='offset' value='%lld'>"
+                            "<input type=hidden name='length' value='%lld'>"
+                            "<input type=hidden name='grep' value='",
+                            res->token, (long long)offset, (long long)length);
+        if (filter)
+                escapeHTML(res->outputbuffer, filter);
+        StringBuffer_append(res->outputbuffer,
+                            "'>"
+                            "<input type=submit value='%s'>"
+                            "</form></td>",
+                            label);
+}
+
+
+/**
+ * Show the monit log, available via POST only (the request must carry the
+ * security token). The request parameters select the log range:
+ *   lines  - show the last N lines (default 1000)
+ *   offset - show the log starting at the given byte offset
+ *   length - the number of bytes to show if offset is used
+ *   grep   - show only lines matching the regular expression
+ *   format - "text" returns plain text instead of the HTML page
+ * The log is read from the file in blocks and streamed to the client.
+ */
 static void do_viewlog(HttpRequest req, HttpResponse res) {
         if (is_readonly(req)) {
                 send_error(req, res, SC_FORBIDDEN, "You do not have sufficient privileges to access this page");
                 return;
         }
-        do_head(res, "_viewlog", "View log", 100);
-        if ((Run.flags & Run_Log) && ! (Run.flags & Run_UseSyslog)) {
-                FILE *f = fopen(Run.files.log, "r");
-                if (f) {
-                        size_t n;
-                        char buf[512];
-                        StringBuffer_append(res->outputbuffer, "<br><p><form><textarea cols=120 rows=30 readonly>");
-                        while ((n = fread(buf, sizeof(char), sizeof(buf) - 1, f)) > 0) {
-                                buf[n] = 0;
-                                escapeHTML(res->outputbuffer, buf);
-                        }
-                        fclose(f);
-                        StringBuffer_append(res->outputbuffer, "</textarea></form>");
-                } else {
-                        StringBuffer_append(res->outputbuffer, "Error opening logfile: %s", STRERROR);
-                }
-        } else {
+        if (! (Run.flags & Run_Log) || (Run.flags & Run_UseSyslog)) {
+                do_head(res, "_viewlog", "View log", 100);
                 StringBuffer_append(res->outputbuffer,
                                     "<b>Cannot view logfile:</b><br>");
                 if (! (Run.flags & Run_Log))
                         StringBuffer_append(res->outputbuffer, "Monit was started without logging");
                 else
                         StringBuffer_append(res->outputbuffer, "Monit uses syslog");
+                do_foot(res);
+                return;
         }
-        do_foot(res);
+        regex_t *filter = NULL;
+        const char *grep = get_parameter(req, "grep");
+        if (grep && *grep) {
+                NEW(filter);
+                int reg_return = regcomp(filter, grep, REG_EXTENDED | REG_NOSUB);
+                if (reg_return != 0) {
+                        char errbuf[STRLEN];
+                        regerror(reg_return, filter, errbuf, STRLEN);
+                        FREE(filter);
+                        send_error(req, res, SC_BAD_REQUEST, "Invalid grep pattern: %s", errbuf);
+                        return;
+                }
+        }
+        int fd = open(Run.files.log, O_RDONLY);
+        if (fd >= 0) {
+                bool html = ! IS(get_parameter(req, "format"), "text");
+                struct stat st;
+                off_t end = fstat(fd, &st) == 0 ? st.st_size : 0;
+                off_t start;
+                int64_t length = _getNumberParameter(req, "length", VIEWLOG_LENGTH);
+                const char *offset = get_parameter(req, "offset");
+                if (offset) {
+                        start = _viewlogAlign(fd, MIN(_getNumberParameter(req, "offset", 0), end), end);
+                        if (start + length < end)
+                                end = _viewlogAlign(fd, start + length, end);
+                } else {
+                        start = _viewlogTail(fd, end, _getNumberParameter(req, "lines", VIEWLOG_LINES), filter);
+                }
+                if (html) {
+                        do_head(res, "_viewlog", "View log", 100);
+                        StringBuffer_append(res->outputbuffer, "<br><table id='buttons'><tr>");
+                        if (start > 0)
+                                _viewlogButton(res, "Previous", MAX(0, start - length), length, grep);
+                        if (end < st.st_size)
+                                _viewlogButton(res, "Next", end, length, grep);
+                        StringBuffer_append(res->outputbuffer,
+                                            "<td><form method=POST action='_viewlog'>"
+                                            "<input type=hidden name='securitytoken' value='%s'>"
+                                            "Filter <input type=text name='grep' value='",
+                                            res->token);
+                        if (grep)
+                                escapeHTML(res->outputbuffer, grep);
+                        StringBuffer_append(res->outputbuffer,
+                                            "'> <input type=submit value='Go'>"
+                                            "</form></td></tr></table>"
+                                            "<p>Showing bytes %lld-%lld of %lld</p>"
+                                            "<p><form><textarea cols=120 rows=30 readonly>",
+                                            (long long)start, (long long)end, (long long)st.st_size);
+                } else {
+                        set_content_type(res, "text/plain");
+                }
+                _viewlogRange(res, html, fd, start, end, filter);
+                close(fd);
+                if (html) {
+                        StringBuffer_append(res->outputbuffer, "</textarea></form>");
+                        do_foot(res);
+                }
+        } else {
+                do_head(res, "_viewlog", "View log", 100);
+                StringBuffer_append(res->outputbuffer, "Error opening logfile: %s", STRERROR);
+                do_foot(res);
+        }
+        if (filter) {
+                regfree(filter);
+                FREE(filter);
+        }
+}
+
+
+/**
+ * Metric families exported by the /_metrics page. OpenMetrics requires the
+ * samples of one family to be grouped, the page is therefore generated
+ * family by family over the whole service list
+ */
+typedef enum {
+        Metric_ServiceStatus = 0,
+        Metric_ServiceMonitor,
+        Metric_ServiceCollected,
+        Metric_ServiceDeferred,
+        Metric_ProcessUptime,
+        Metric_ProcessThreads,
+        Metric_ProcessChildren,
+        Metric_ProcessCpu,
+        Metric_ProcessCpuTotal,
+        Metric_ProcessMemory,
+        Metric_ProcessMemoryTotal,
+        Metric_ProcessReadBytes,
+        Metric_ProcessReadOperations,
+        Metric_ProcessWriteBytes,
+        Metric_ProcessWriteOperations,
+        Metric_FilesystemSpaceUsed,
+        Metric_FilesystemSpaceSize,
+        Metric_FilesystemInodesUsed,
+        Metric_FilesystemInodes,
+        Metric_FilesystemReadBytes,
+        Metric_FilesystemReadOperations,
+        Metric_FilesystemWriteBytes,
+        Metric_FilesystemWriteOperations,
+        Metric_LinkUp,
+        Metric_LinkSpeed,
+        Metric_LinkReceiveBytes,
+        Metric_LinkReceivePackets,
+        Metric_LinkReceiveErrors,
+        Metric_LinkTransmitBytes,
+        Metric_LinkTransmitPackets,
+        Metric_LinkTransmitErrors,
+        Metric_SystemLoad1,
+        Metric_SystemLoad5,
+        Metric_SystemLoad15,
+        Metric_SystemCpuUser,
+        Metric_SystemCpuSystem,
+        Metric_SystemCpuWait,
+        Metric_SystemCpuSteal,
+        Metric_SystemCpuGuest,
+        Metric_SystemMemory,
+        Metric_SystemSwap
+} Metric_Type;
+
+
+static struct {
+        const char *name;
+        const char *type;
+        const char *unit;
+        const char *help;
+} metrics[] = {
+        {"monit_service_status",                  "gauge",   NULL,      "Service error bitmap, 0 if the service is ok"},
+        {"monit_service_monitor",                 "gauge",   NULL,      "Monitoring state, 0 = not monitored, 1 = monitored, 2 = initializing, 4 = waiting"},
+        {"monit_service_collected_seconds",       "gauge",   "seconds", "Time when the service data was collected"},
+        {"monit_service_deferred_checks",         "counter", NULL,      "Number of checks deferred to the next cycle by the cycle time budget"},
+        {"monit_process_uptime_seconds",          "gauge",   "seconds", "Process uptime"},
+        {"monit_process_threads",                 "gauge",   NULL,      "Number of process threads"},
+        {"monit_process_children",                "gauge",   NULL,      "Number of child processes"},
+        {"monit_process_cpu_percent",             "gauge",   NULL,      "Process CPU usage"},
+        {"monit_process_cpu_total_percent",       "gauge",   NULL,      "CPU usage of the process and its children"},
+        {"monit_process_memory_bytes",            "gauge",   "bytes",   "Process memory usage"},
+        {"monit_process_memory_total_bytes",      "gauge",   "bytes",   "Memory usage of the process and its children"},
+        {"monit_process_read_bytes",              "counter", "bytes",   "Bytes read by the process"},
+        {"monit_process_read_operations",         "counter", NULL,      "Read operations of the process"},
+        {"monit_process_write_bytes",             "counter", "bytes",   "Bytes written by the process"},
+        {"monit_process_write_operations",        "counter", NULL,      "Write operations of the process"},
+        {"monit_filesystem_space_used_bytes",     "gauge",   "bytes",   "Used filesystem space"},
+        {"monit_filesystem_space_size_bytes",     "gauge",   "bytes",   "Filesystem size"},
+        {"monit_filesystem_inodes_used",          "gauge",   NULL,      "Used inodes"},
+        {"monit_filesystem_inodes",               "gauge",   NULL,      "Total inodes"},
+        {"monit_filesystem_read_bytes",           "counter", "bytes",   "Bytes read from the filesystem"},
+        {"monit_filesystem_read_operations",      "counter", NULL,      "Filesystem read operations"},
+        {"monit_filesystem_write_bytes",          "counter", "bytes",   "Bytes written to the filesystem"},
+        {"monit_filesystem_write_operations",     "counter", NULL,      "Filesystem write operations"},
+        {"monit_link_up",                         "gauge",   NULL,      "Network link state, 1 if the link is up"},
+        {"monit_link_speed_bits",                 "gauge",   "bits",    "Network link speed per second"},
+        {"monit_link_receive_bytes",              "counter", "bytes",   "Bytes received by the network interface"},
+        {"monit_link_receive_packets",            "counter", NULL,      "Packets received by the network interface"},
+        {"monit_link_receive_errors",             "counter", NULL,      "Receive errors of the network interface"},
+        {"monit_link_transmit_bytes",             "counter", "bytes",   "Bytes sent by the network interface"},
+        {"monit_link_transmit_packets",           "counter", NULL,      "Packets sent by the network interface"},
+        {"monit_link_transmit_errors",            "counter", NULL,      "Transmit errors of the network interface"},
+        {"monit_system_load1",                    "gauge",   NULL,      "Load average over 1 minute"},
+        {"monit_system_load5",                    "gauge",   NULL,      "Load average over 5 minutes"},
+        {"monit_system_load15",                   "gauge",   NULL,      "Load average over 15 minutes"},
+        {"monit_system_cpu_user_percent",         "gauge",   NULL,      "CPU usage in user space"},
+        {"monit_system_cpu_system_percent",       "gauge",   NULL,      "CPU usage in kernel space"},
+        {"monit_system_cpu_wait_percent",         "gauge",   NULL,      "CPU time waiting for I/O"},
+        {"monit_system_cpu_steal_percent",        "gauge",   NULL,      "CPU time stolen by the hypervisor"},
+        {"monit_system_cpu_guest_percent",        "gauge",   NULL,      "CPU time running guest systems"},
+        {"monit_system_memory_bytes",             "gauge",   "bytes",   "System memory usage"},
+        {"monit_system_swap_bytes",               "gauge",   "bytes",   "System swap usage"}
+};
+
+
+static char *metricservicetypes[] = {"filesystem", "directory", "file", "process", "host", "system", "fifo", "program", "net", "cgroup"};
+
+
+/**
+ * Escape the OpenMetrics label value: backslash, double-quote and line feed
+ */
+static void _metricsEscape(StringBuffer_T B, const char *value) {
+        for (const char *p = value; p && *p; p++) {
+                if (*p == '\\')
+                        StringBuffer_append(B, "\\\\");
+                else if (*p == '"')
+                        StringBuffer_append(B, "\\\"");
+                else if (*p == '\n')
+                        StringBuffer_append(B, "\\n");
+                else
+                        StringBuffer_append(B, "%c", *p);
+        }
+}
+
+
+/**
+ * Get the service labels. The labels are built on the first request and
+ * kept in the service object until the configuration is reloaded
+ */
+static const char *_metricsLabels(Service_T s) {
+        if (! s->labels) {
+                StringBuffer_T B = StringBuffer_create(64);
+                StringBuffer_append(B, "service=\"");
+                _metricsEscape(B, s->name);
+                StringBuffer_append(B, "\",type=\"%s\"", metricservicetypes[s->type]);
+                s->labels = Str_dup(StringBuffer_toString(B));
+                StringBuffer_free(&B);
+        }
+        return s->labels;
+}
+
+
+static bool _metricsStatistics(Statistics_T statistics, double *value) {
+        if (Statistics_initialized(statistics)) {
+                *value = Statistics_raw(statistics);
+                return true;
+        }
+        return false;
+}
+
+
+static bool _metricsLink(int64_t data, double *value) {
+        if (data >= 0) {
+                *value = data;
+                return true;
+        }
+        return false;
+}
+
+
+/**
+ * Get the metric value of the service
+ * @return true if the service has the metric, otherwise false
+ */
+static bool _metricsValue(Service_T s, Metric_Type metric, double *value) {
+        switch (metric) {
+                case Metric_ServiceStatus:
+                        *value = s->error;
+                        return true;
+                case Metric_ServiceMonitor:
+                        *value = s->monitor;
+                        return true;
+                case Metric_ServiceCollected:
+                        *value = s->collected.tv_sec + s->collected.tv_usec / 1000000.;
+                        return s->collected.tv_sec > 0;
+                case Metric_ServiceDeferred:
+                        *value = s->deferral.count;
+                        return true;
+                default:
+                        break;
+        }
+        if (! Util_hasServiceStatus(s))
+                return false;
+        switch (s->type) {
+                case Service_Process:
+                case Service_Cgroup:
+                        switch (metric) {
+                                case Metric_ProcessUptime:
+                                        *value = s->inf.process->uptime;
+                                        return s->inf.process->uptime >= 0;
+                                case Metric_ProcessReadBytes:
+                                        return _metricsStatistics(&(s->inf.process->read.bytes), value);
+                                case Metric_ProcessReadOperations:
+                                        return _metricsStatistics(&(s->inf.process->read.operations), value);
+                                case Metric_ProcessWriteBytes:
+                                        return _metricsStatistics(&(s->inf.process->write.bytes), value);
+                                case Metric_ProcessWriteOperations:
+                                        return _metricsStatistics(&(s->inf.process->write.operations), value);
+                                default:
+                                        break;
+                        }
+                        if (! (Run.flags & Run_ProcessEngineEnabled))
+                                return false;
+                        switch (metric) {
+                                case Metric_ProcessThreads:
+                                        *value = s->inf.process->threads;
+                                        return s->inf.process->threads >= 0;
+                                case Metric_ProcessChildren:
+                                        *value = s->inf.process->children;
+                                        return s->inf.process->children >= 0;
+                                case Metric_ProcessCpu:
+                                        *value = s->inf.process->cpu_percent;
+                                        return s->inf.process->cpu_percent >= 0.;
+                                case Metric_ProcessCpuTotal:
+                                        *value = s->inf.process->total_cpu_percent;
+                                        return s->inf.process->total_cpu_percent >= 0.;
+                                case Metric_ProcessMemory:
+                                        *value = s->inf.process->mem;
+                                        return true;
+                                case Metric_ProcessMemoryTotal:
+                                        *value = s->inf.process->total_mem;
+                                        return true;
+                                default:
+                                        return false;
+                        }
+                case Service_Filesystem:
+                        switch (metric) {
+                                case Metric_FilesystemSpaceUsed:
+                                        *value = (double)s->inf.filesystem->f_blocksused * (double)s->inf.filesystem->f_bsize;
+                                        return s->inf.filesystem->f_bsize > 0;
+                                case Metric_FilesystemSpaceSize:
+                                        *value = (double)s->inf.filesystem->f_blocks * (double)s->inf.filesystem->f_bsize;
+                                        return s->inf.filesystem->f_bsize > 0;
+                                case Metric_FilesystemInodesUsed:
+                                        *value = s->inf.filesystem->f_filesused;
+                                        return s->inf.filesystem->f_files > 0;
+                                case Metric_FilesystemInodes:
+                                        *value = s->inf.filesystem->f_files;
+                                        return s->inf.filesystem->f_files > 0;
+                                case Metric_FilesystemReadBytes:
+                                        return _metricsStatistics(&(s->inf.filesystem->read.bytes), value);
+                                case Metric_FilesystemReadOperations:
+                                        return _metricsStatistics(&(s->inf.filesystem->read.operations), value);
+                                case Metric_FilesystemWriteBytes:
+                                        return _metricsStatistics(&(s->inf.filesystem->write.bytes), value);
+                                case Metric_FilesystemWriteOperations:
+                                        return _metricsStatistics(&(s->inf.filesystem->write.operations), value);
+                                default:
+                                        return false;
+                        }
+                case Service_Net:
+                        switch (metric) {
+                                case Metric_LinkUp:
+                                        return _metricsLink(Link_getState(s->inf.net->stats), value);
+                                case Metric_LinkSpeed:
+                                        return _metricsLink(Link_getSpeed(s->inf.net->stats), value);
+                                case Metric_LinkReceiveBytes:
+                                        return _metricsLink(Link_getBytesInTotal(s->inf.net->stats), value);
+                                case Metric_LinkReceivePackets:
+                                        return _metricsLink(Link_getPacketsInTotal(s->inf.net->stats), value);
+                                case Metric_LinkReceiveErrors:
+                                        return _metricsLink(Link_getErrorsInTotal(s->inf.net->stats), value);
+                                case Metric_LinkTransmitBytes:
+                                        return _metricsLink(Link_getBytesOutTotal(s->inf.net->stats), value);
+                                case Metric_LinkTransmitPackets:
+                                        return _metricsLink(Link_getPacketsOutTotal(s->inf.net->stats), value);
+                                case Metric_LinkTransmitErrors:
+                                        return _metricsLink(Link_getErrorsOutTotal(s->inf.net->stats), value);
+                                default:
+                                        return false;
+                        }
+                case Service_System:
+                        switch (metric) {
+                                case Metric_SystemLoad1:
+                                        *value = systeminfo.loadavg[0];
+                                        return true;
+                                case Metric_SystemLoad5:
+                                        *value = systeminfo.loadavg[1];
+                                        return true;
+                                case Metric_SystemLoad15:
+                                        *value = systeminfo.loadavg[2];
+                                        return true;
+                                case Metric_SystemCpuUser:
+                                        *value = systeminfo.cpu.usage.user;
+                                        return systeminfo.cpu.usage.user >= 0.;
+                                case Metric_SystemCpuSystem:
+                                        *value = systeminfo.cpu.usage.system;
+                                        return systeminfo.cpu.usage.system >= 0.;
+#ifdef HAVE_CPU_WAIT
+                                case Metric_SystemCpuWait:
+                                        *value = systeminfo.cpu.usage.wait;
+                                        return systeminfo.cpu.usage.wait >= 0.;
+#endif
+                                case Metric_SystemCpuSteal:
+                                        *value = systeminfo.cpu.usage.steal;
+                                        return systeminfo.cpu.usage.steal >= 0.;
+                                case Metric_SystemCpuGuest:
+                                        *value = systeminfo.cpu.usage.guest;
+                                        return systeminfo.cpu.usage.guest >= 0.;
+                                case Metric_SystemMemory:
+                                        *value = systeminfo.memory.usage.bytes;
+                                        return true;
+                                case Metric_SystemSwap:
+                                        *value = systeminfo.swap.usage.bytes;
+                                        return true;
+                                default:
+                                        return false;
+                        }
+                default:
+                        return false;
+        }
+}
+
+
+static void _metricsFamily(HttpResponse res, const char *name, const char *type, const char *unit, const char *help) {
+        StringBuffer_append(res->outputbuffer, "# TYPE %s %s\n", name, type);
+        if (unit)
+                StringBuffer_append(res->outputbuffer, "# UNIT %s %s\n", name, unit);
+        StringBuffer_append(res->outputbuffer, "# HELP %s %s\n", name, help);
+}
+
+
+static void _metricsPort(HttpResponse res, Port_T p) {
+        if (p->family == Socket_Unix) {
+                StringBuffer_append(res->outputbuffer, ",path=\"");
+                _metricsEscape(res->outputbuffer, p->target.unix.pathname);
+                StringBuffer_append(res->outputbuffer, "\"");
+        } else {
+                StringBuffer_append(res->outputbuffer, ",hostname=\"");
+                _metricsEscape(res->outputbuffer, p->hostname);
+                StringBuffer_append(res->outputbuffer, "\",port=\"%d\"", p->target.net.port);
+        }
+        StringBuffer_append(res->outputbuffer, ",protocol=\"");
+        _metricsEscape(res->outputbuffer, p->protocol->name);
+        StringBuffer_append(res->outputbuffer, "\"}");
+}
+
+
+/**
+ * Print the connection tests. Pass 0 prints the availability, pass 1 the
+ * response time of available connections
+ */
+static void _metricsConnections(HttpResponse res, int pass) {
+        for (Service_T s = servicelist_conf; s; s = s->next_conf) {
+                if (! Util_hasServiceStatus(s))
+                        continue;
+                for (int list = 0; list < 2; list++) {
+                        for (Port_T p = list ? s->socketlist : s->portlist; p; p = p->next) {
+                                if (p->is_available == Connection_Init || (pass && p->is_available != Connection_Ok))
+                                        continue;
+                                StringBuffer_append(res->outputbuffer, "%s{%s", pass ? "monit_port_response_time_seconds" : "monit_port_available", _metricsLabels(s));
+                                _metricsPort(res, p);
+                                StringBuffer_append(res->outputbuffer, " %.15g\n", pass ? p->response / 1000. : (double)(p->is_available == Connection_Ok));
+                        }
+                }
+        }
+}
+
+
+static void _metricsIcmp(HttpResponse res, int pass) {
+        for (Service_T s = servicelist_conf; s; s = s->next_conf) {
+                if (! Util_hasServiceStatus(s))
+                        continue;
+                for (Icmp_T i = s->icmplist; i; i = i->next) {
+                        if (i->is_available == Connection_Init || (pass && i->is_available != Connection_Ok))
+                                continue;
+                        StringBuffer_append(res->outputbuffer, "%s{%s,icmp=\"%s\"} %.15g\n",
+                                            pass ? "monit_icmp_response_time_seconds" : "monit_icmp_available",
+                                            _metricsLabels(s),
+                                            icmpnames[i->type],
+                                            pass ? i->response / 1000. : (double)(i->is_available == Connection_Ok));
+                }
+        }
+}
+
+
+static void _metricsCores(HttpResponse res) {
+        if (systeminfo.cpu.core.count > 0 && Util_hasServiceStatus(Run.system)) {
+                _metricsFamily(res, "monit_system_cpu_core_percent", "gauge", NULL, "CPU usage per core");
+                for (int i = 0; i < systeminfo.cpu.core.count; i++)
+                        if (systeminfo.cpu.core.usage[i] >= 0.)
+                                StringBuffer_append(res->outputbuffer, "monit_system_cpu_core_percent{%s,core=\"%d\"} %.15g\n", _metricsLabels(Run.system), i, systeminfo.cpu.core.usage[i]);
+        }
+}
+
+
+/**
+ * Print the histogram as OpenMetrics summary in seconds
+ */
+static void _metricsSummary(HttpResponse res, const char *name, const char *labels, Histogram_T h) {
+        static const double quantiles[] = {50., 90., 99.};
+        for (int i = 0; i < (int)(sizeof(quantiles) / sizeof(quantiles[0])); i++)
+                StringBuffer_append(res->outputbuffer, "%s{%s%squantile=\"%g\"} %.6f\n", name, labels ? labels : "", labels ? "," : "", quantiles[i] / 100., Histogram_percentile(h, quantiles[i]) / 1000000.);
+        if (labels) {
+                StringBuffer_append(res->outputbuffer, "%s_sum{%s} %.6f\n", name, labels, Histogram_sum(h) / 1000000.);
+                StringBuffer_append(res->outputbuffer, "%s_count{%s} %"PRIu64"\n", name, labels, Histogram_count(h));
+        } else {
+                StringBuffer_append(res->outputbuffer, "%s_sum %.6f\n", name, Histogram_sum(h) / 1000000.);
+                StringBuffer_append(res->outputbuffer, "%s_count %"PRIu64"\n", name, Histogram_count(h));
+        }
+}
+
+
+static void _metricsProfile(HttpResponse res) {
+        _metricsFamily(res, "monit_check_duration_seconds", "summary", "seconds", "Service check wall time");
+        for (Service_T s = servicelist_conf; s; s = s->next_conf)
+                if (Histogram_count(&(s->profile.wall)))
+                        _metricsSummary(res, "monit_check_duration_seconds", _metricsLabels(s), &(s->profile.wall));
+        _metricsFamily(res, "monit_check_cpu_seconds", "summary", "seconds", "Service check CPU time");
+        for (Service_T s = servicelist_conf; s; s = s->next_conf)
+                if (Histogram_count(&(s->profile.cpu)))
+                        _metricsSummary(res, "monit_check_cpu_seconds", _metricsLabels(s), &(s->profile.cpu));
+        _metricsFamily(res, "monit_cycle_duration_seconds", "summary", "seconds", "Validation cycle duration");
+        _metricsSummary(res, "monit_cycle_duration_seconds", NULL, &(Run.profile.cycle));
+        _metricsFamily(res, "monit_cycle_overrun_seconds", "summary", "seconds", "Validation cycle time past the cycle time budget or the poll interval");
+        _metricsSummary(res, "monit_cycle_overrun_seconds", NULL, &(Run.profile.overrun));
+        _metricsFamily(res, "monit_processtree_duration_seconds", "summary", "seconds", "Process tree collection time");
+        _metricsSummary(res, "monit_processtree_duration_seconds", NULL, &(Run.profile.processtree));
+        _metricsFamily(res, "monit_event_duration_seconds", "summary", "seconds", "Event handling time");
+        _metricsSummary(res, "monit_event_duration_seconds", NULL, &(Run.profile.event));
+        _metricsFamily(res, "monit_notification_latency_seconds", "summary", "seconds", "Alert delivery latency since the event");
+        _metricsSummary(res, "monit_notification_latency_seconds", NULL, &(Run.profile.notification));
+}
+
+
+/**
+ * Export the service statistics in the OpenMetrics text format for
+ * Prometheus and compatible collectors. The response is streamed to the
+ * client family by family
+ */
+static void do_metrics(HttpResponse res) {
+        set_content_type(res, "application/openmetrics-text; version=1.0.0; charset=utf-8");
+        for (int m = 0; m < (int)(sizeof(metrics) / sizeof(metrics[0])); m++) {
+                bool counter = IS(metrics[m].type, "counter");
+                _metricsFamily(res, metrics[m].name, metrics[m].type, metrics[m].unit, metrics[m].help);
+                for (Service_T s = servicelist_conf; s; s = s->next_conf) {
+                        double value;
+                        if (_metricsValue(s, m, &value))
+                                StringBuffer_append(res->outputbuffer, "%s%s{%s} %.15g\n", metrics[m].name, counter ? "_total" : "", _metricsLabels(s), value);
+                }
+                if (StringBuffer_length(res->outputbuffer) >= METRICS_FLUSH && ! flush_response(res))
+                        return;
+        }
+        _metricsFamily(res, "monit_port_available", "gauge", NULL, "Port connection state, 1 if the connection succeeded");
+        _metricsConnections(res, 0);
+        _metricsFamily(res, "monit_port_response_time_seconds", "gauge", "seconds", "Port response time");
+        _metricsConnections(res, 1);
+        _metricsFamily(res, "monit_icmp_available", "gauge", NULL, "ICMP echo state, 1 if the host responded");
+        _metricsIcmp(res, 0);
+        _metricsFamily(res, "monit_icmp_response_time_seconds", "gauge", "seconds", "ICMP echo response time");
+        _metricsIcmp(res, 1);
+        _metricsCores(res);
+        _metricsProfile(res);
+        StringBuffer_append(res->outputbuffer, "# EOF\n");
 }
 
 
@@ -1085,6 +1924,11 @@ static void do_service(HttpRequest req, HttpResponse res, Service_T s) {
                             "<tr><td>Monitoring mode</td><td>%s</td></tr>", modenames[s->mode]);
         StringBuffer_append(res->outputbuffer,
                             "<tr><td>On reboot</td><td>%s</td></tr>", onrebootnames[s->onreboot]);
+        StringBuffer_append(res->outputbuffer,
+                            "<tr><td>Priority</td><td>%s</td></tr>", prioritynames[s->priority]);
+        if (s->deferral.count)
+                StringBuffer_append(res->outputbuffer,
+                                    "<tr><td>Deferred checks</td><td>%"PRIu64"</td></tr>", s->deferral.count);
         for (Dependant_T d = s->dependantlist; d; d = d->next) {
                 if (d->dependant != NULL) {
                         StringBuffer_append(res->outputbuffer,
@@ -1127,6 +1971,8 @@ static void do_service(HttpRequest req, HttpResponse res, Service_T s) {
                         StringBuffer_append(res->outputbuffer, "every <code>\"%s\"</code>", s->every.spec.cron);
                 else if (s->every.type == Every_NotInCron)
                         StringBuffer_append(res->outputbuffer, "not every <code>\"%s\"</code>", s->every.spec.cron);
+                else if (s->every.type == Every_Adaptive)
+                        StringBuffer_append(res->outputbuffer, "every %d cycle (adaptive, at least every %d cycles)", s->every.spec.adaptive.interval, s->every.spec.adaptive.maximum);
                 StringBuffer_append(res->outputbuffer, "</td></tr>");
         }
         _printStatus(HTML, res, s);
@@ -1218,7 +2064,7 @@ static void do_home_process(HttpResponse res) {
         bool header = true;
 
         for (Service_T s = servicelist_conf; s; s = s->next_conf) {
-                if (s->type != Service_Process)
+                if (s->type != Service_Process && s->type != Service_Cgroup)
                         continue;
                 if (header) {
                         StringBuffer_append(res->outputbuffer,
@@ -2224,6 +3070,18 @@ static void print_service_rules_resource(HttpResponse res, Service_T s) {
                                 StringBuffer_append(res->outputbuffer, "CPU wait limit");
                                 break;
 
+                        case Resource_CpuSteal:
+                                StringBuffer_append(res->outputbuffer, "CPU steal limit");
+                                break;
+
+                        case Resource_CpuGuest:
+                                StringBuffer_append(res->outputbuffer, "CPU guest limit");
+                                break;
+
+                        case Resource_CpuCore:
+                                StringBuffer_append(res->outputbuffer, "CPU core limit");
+                                break;
+
                         case Resource_MemoryPercent:
                                 StringBuffer_append(res->outputbuffer, "Memory usage limit");
                                 break;
@@ -2284,6 +3142,18 @@ static void print_service_rules_resource(HttpResponse res, Service_T s) {
                                 StringBuffer_append(res->outputbuffer, "Disk write limit");
                                 break;
 
+                        case Resource_CpuPressure:
+                                StringBuffer_append(res->outputbuffer, "CPU pressure limit");
+                                break;
+
+                        case Resource_MemoryPressure:
+                                StringBuffer_append(res->outputbuffer, "Memory pressure limit");
+                                break;
+
+                        case Resource_IoPressure:
+                                StringBuffer_append(res->outputbuffer, "IO pressure limit");
+                                break;
+
                         default:
                                 break;
                 }
@@ -2295,6 +3165,9 @@ static void print_service_rules_resource(HttpResponse res, Service_T s) {
                         case Resource_CpuUser:
                         case Resource_CpuSystem:
                         case Resource_CpuWait:
+                        case Resource_CpuSteal:
+                        case Resource_CpuGuest:
+                        case Resource_CpuCore:
                         case Resource_MemoryPercent:
                         case Resource_SwapPercent:
                                 Util_printRule(res->outputbuffer, q->action, "If %s %.1f%%", operatornames[q->operator], q->limit);
@@ -2327,6 +3200,12 @@ static void print_service_rules_resource(HttpResponse res, Service_T s) {
                                 Util_printRule(res->outputbuffer, q->action, "if %s %.0f operations/s", operatornames[q->operator], q->limit);
                                 break;
 
+                        case Resource_CpuPressure:
+                        case Resource_MemoryPressure:
+                        case Resource_IoPressure:
+                                Util_printRule(res->outputbuffer, q->action, "If %s %s %s %.1f%%", q->pressure.full ? "full" : "some", pressurewindownames[q->pressure.window], operatornames[q->operator], q->limit);
+                                break;
+
                         default:
                                 break;
                 }
@@ -2357,6 +3236,16 @@ static void print_status(HttpRequest req, HttpResponse res, int version) {
                 StringBuffer_append(res->outputbuffer, "%s", StringBuffer_toString(sb));
                 StringBuffer_free(&sb);
                 set_content_type(res, "text/xml");
+        } else if (stringFormat && Str_startsWith(stringFormat, "json")) {
+                set_content_type(res, "application/json");
+                const char *stringGroup = Util_urlDecode((char *)get_parameter(req, "group"));
+                const char *stringServices = Util_urlDecode((char *)get_parameter(req, "services"));
+                if (status_json(res->outputbuffer, stringServices, stringGroup, Util_urlDecode((char *)get_parameter(req, "fields"))) == 0) {
+                        if (stringGroup && *stringGroup)
+                                send_error(req, res, SC_BAD_REQUEST, "Service group '%s' not found", stringGroup);
+                        else if (stringServices && *stringServices)
+                                send_error(req, res, SC_BAD_REQUEST, "Services '%s' not found", stringServices);
+                }
         } else {
                 set_content_type(res, "text/plain");
 
@@ -2448,6 +3337,7 @@ static void print_summary(HttpRequest req, HttpResponse res) {
         } else {
                 found += _printServiceSummaryByType(t, Service_System);
                 found += _printServiceSummaryByType(t, Service_Process);
+                found += _printServiceSummaryByType(t, Service_Cgroup);
                 found += _printServiceSummaryByType(t, Service_File);
                 found += _printServiceSummaryByType(t, Service_Fifo);
                 found += _printServiceSummaryByType(t, Service_Directory);
@@ -2542,6 +3432,9 @@ static void status_service_txt(Service_T s, HttpResponse res) {
         StringBuffer_append(res->outputbuffer,
                 "  %-28s %s\n",
                 "on reboot", onrebootnames[s->onreboot]);
+        StringBuffer_append(res->outputbuffer,
+                "  %-28s %s\n",
+                "priority", prioritynames[s->priority]);
         _printStatus(TXT, res, s);
         StringBuffer_append(res->outputbuffer, "\n");
 }
@@ -258,3 +258,11 @@ bool HttpClient_summary(const char *group, const char *service) {
         return rv;
 }
 
+
+bool HttpClient_runtime() {
+        StringBuffer_T data = StringBuffer_create(64);
+        bool rv = _client("/_runtime", data);
+        StringBuffer_free(&data);
+        return rv;
+}
+
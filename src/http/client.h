@@ -61,4 +61,11 @@ bool HttpClient_status(const char *group, const char *service);
 bool HttpClient_summary(const char *group, const char *service);
 
 
+/**
+ * Print Monit runtime profile
+ * @return true if succeeded otherwise false
+ */
+bool HttpClient_runtime(void);
+
+
 #endif
@@ -147,6 +147,7 @@ static struct {
 
 
 static volatile bool stopped = false;
+static Mutex_T mutex = PTHREAD_MUTEX_INITIALIZER;
 static int myServerSocketsCount = 0;
 static struct pollfd myServerSockets[3] = {};
 static HostsAllow_T allowlist = NULL;
@@ -396,29 +397,32 @@ static bool _authenticateHost(struct sockaddr *addr) {
 }
 
 
-static Socket_T _socketProducer() {
+static bool _waitForConnection() {
         int r = 0;
         do {
                 r = poll(myServerSockets, myServerSocketsCount, 1000);
         } while (r == -1 && errno == EINTR);
-        if (r > 0) {
-                for (int i = 0; i < myServerSocketsCount; i++) {
-                        if (myServerSockets[i].revents & POLLIN) {
-                                int client = accept(myServerSockets[i].fd, data[i].addr, &(data[i].addrlen));
-                                if (client < 0) {
-                                        LogError("HTTP server: cannot accept connection -- %s\n", stopped ? "service stopped" : STRERROR);
-                                        return NULL;
-                                }
-                                if (Net_setNonBlocking(client) < 0 || ! Net_canRead(client, 500) || ! Net_canWrite(client, 500) || ! _authenticateHost(data[i].addr)) {
-                                        Net_abort(client);
-                                        return NULL;
-                                }
+        return r > 0;
+}
+
+
+static Socket_T _socketProducer() {
+        for (int i = 0; i < myServerSocketsCount; i++) {
+                if (myServerSockets[i].revents & POLLIN) {
+                        int client = accept(myServerSockets[i].fd, data[i].addr, &(data[i].addrlen));
+                        if (client < 0) {
+                                LogError("HTTP server: cannot accept connection -- %s\n", stopped ? "service stopped" : STRERROR);
+                                return NULL;
+                        }
+                        if (Net_setNonBlocking(client) < 0 || ! Net_canRead(client, 500) || ! Net_canWrite(client, 500) || ! _authenticateHost(data[i].addr)) {
+                                Net_abort(client);
+                                return NULL;
+                        }
 #ifdef HAVE_OPENSSL
-                                return Socket_createAccepted(client, data[i].addr, data[i].ssl);
+                        return Socket_createAccepted(client, data[i].addr, data[i].ssl);
 #else
-                                return Socket_createAccepted(client, data[i].addr, NULL);
+                        return Socket_createAccepted(client, data[i].addr, NULL);
 #endif
-                        }
                 }
         }
         return NULL;
@@ -502,9 +506,16 @@ void Engine_start() {
                                 LogError("HTTP server -- %s\n", error[i]);
         } else {
                 while (! stopped) {
-                        Socket_T S = _socketProducer();
-                        if (S)
-                                http_processor(S);
+                        if (_waitForConnection()) {
+                                // The request is served in one critical section, the configuration may be replaced while the server is suspended
+                                LOCK(mutex)
+                                {
+                                        Socket_T S = _socketProducer();
+                                        if (S)
+                                                http_processor(S);
+                                }
+                                END_LOCK;
+                        }
                 }
                 for (int i = 0; i < myServerSocketsCount; i++) {
 #ifdef HAVE_OPENSSL
@@ -523,6 +534,16 @@ void Engine_stop() {
 }
 
 
+void Engine_suspend() {
+        Mutex_lock(mutex);
+}
+
+
+void Engine_resume() {
+        Mutex_unlock(mutex);
+}
+
+
 void Engine_cleanup() {
         myServerSocketsCount = 0;
         if (Run.httpd.flags & Httpd_Unix)
@@ -39,6 +39,20 @@ void Engine_start(void);
 void Engine_stop(void);
 
 
+/**
+ * Suspend the HTTPD server. Waits until the request in progress is served,
+ * new connections are queued until Engine_resume() is called. Used while
+ * the configuration is replaced.
+ */
+void Engine_suspend(void);
+
+
+/**
+ * Resume the HTTPD server suspended by Engine_suspend().
+ */
+void Engine_resume(void);
+
+
 /**
  * Cleanup the HTTPD server resources (remove unix socket).
  */
@@ -0,0 +1,600 @@
+/*
+ * Copyright (C) Tildeslash Ltd. All rights reserved.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ *
+ * You must obey the GNU Affero General Public License in all respects
+ * for all of the code used other than OpenSSL.
+ */
+
+
+#include "xconfig.h"
+
+#ifdef HAVE_STDIO_H
+#include <stdio.h>
+#endif
+
+#ifdef HAVE_STRING_H
+#include <string.h>
+#endif
+
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+
+#include "monit.h"
+#include "ProcessTree.h"
+#include "protocol.h"
+
+// libmonit
+#include "util/List.h"
+
+
+/**
+ *  JSON routines for the service status. The document is written
+ *  directly into the output buffer, the service list and the fields
+ *  of each service can be limited by a filter.
+ *
+ *  @file
+ */
+
+
+/* ----------------------------------------------------------- MARK: - Definitions */
+
+
+#define JSON_DEPTH 8  /* Maximum nesting level of the document */
+
+
+typedef struct Json_T {
+        StringBuffer_T B;
+        const char *fields;         /**< Comma separated list of service fields or NULL for all fields */
+        int depth;                                  /**< Current nesting level */
+        bool first[JSON_DEPTH];  /**< True if no member was written at the level yet */
+} *Json_T;
+
+
+/* --------------------------------------------------------- MARK: - Private */
+
+
+/**
+ * Test if the comma separated list contains the given token
+ */
+static bool _hasToken(const char *list, const char *token) {
+        size_t length = strlen(token);
+        for (const char *p = list; p && *p; ) {
+                const char *end = strchr(p, ',');
+                if (! end)
+                        end = p + strlen(p);
+                if ((size_t)(end - p) == length && strncmp(p, token, length) == 0)
+                        return true;
+                p = *end ? end + 1 : end;
+        }
+        return false;
+}
+
+
+static bool _selected(Json_T J, const char *field) {
+        return ! J->fields || ! *J->fields || _hasToken(J->fields, field);
+}
+
+
+static void _escape(StringBuffer_T B, const char *s) {
+        StringBuffer_append(B, "\"");
+        for (const unsigned char *p = (const unsigned char *)s; p && *p; p++) {
+                if (*p == '"' || *p == '\\')
+                        StringBuffer_append(B, "\\%c", *p);
+                else if (*p == '\n')
+                        StringBuffer_append(B, "\\n");
+                else if (*p == '\r')
+                        StringBuffer_append(B, "\\r");
+                else if (*p == '\t')
+                        StringBuffer_append(B, "\\t");
+                else if (*p < 0x20)
+                        StringBuffer_append(B, "\\u%04x", *p);
+                else
+                        StringBuffer_append(B, "%c", *p);
+        }
+        StringBuffer_append(B, "\"");
+}
+
+
+/**
+ * Write the member separator and the key (if not NULL) of the next member
+ */
+static void _key(Json_T J, const char *key) {
+        if (J->first[J->depth])
+                J->first[J->depth] = false;
+        else
+                StringBuffer_append(J->B, ",");
+        if (key) {
+                _escape(J->B, key);
+                StringBuffer_append(J->B, ":");
+        }
+}
+
+
+static void _open(Json_T J, const char *key, char bracket) {
+        _key(J, key);
+        StringBuffer_append(J->B, "%c", bracket);
+        ASSERT(J->depth < JSON_DEPTH - 1);
+        J->first[++J->depth] = true;
+}
+
+
+static void _close(Json_T J, char bracket) {
+        StringBuffer_append(J->B, "%c", bracket);
+        J->depth--;
+}
+
+
+static void _string(Json_T J, const char *key, const char *value) {
+        _key(J, key);
+        if (value)
+                _escape(J->B, value);
+        else
+                StringBuffer_append(J->B, "null");
+}
+
+
+static void _number(Json_T J, const char *key, const char *format, ...) __attribute__((format (printf, 3, 4)));
+static void _number(Json_T J, const char *key, const char *format, ...) {
+        _key(J, key);
+        va_list ap;
+        va_start(ap, format);
+        StringBuffer_vappend(J->B, format, ap);
+        va_end(ap);
+}
+
+
+static void _ioStatistics(Json_T J, const char *name, IOStatistics_T statistics) {
+        _open(J, name, '{');
+        if (Statistics_initialized(&(statistics->bytes))) {
+                _open(J, "bytes", '{');
+                _number(J, "rate", "%.0lf", Statistics_deltaNormalize(&(statistics->bytes)));
+                _number(J, "total", "%"PRIu64, Statistics_raw(&(statistics->bytes)));
+                _close(J, '}');
+        }
+        if (Statistics_initialized(&(statistics->operations))) {
+                _open(J, "operations", '{');
+                _number(J, "rate", "%.0lf", Statistics_deltaNormalize(&(statistics->operations)));
+                _number(J, "total", "%"PRIu64, Statistics_raw(&(statistics->operations)));
+                _close(J, '}');
+        }
+        _close(J, '}');
+}
+
+
+static void _pressureAverages(Json_T J, const char *name, float avg[3]) {
+        if (avg[0] >= 0.) {
+                _open(J, name, '{');
+                for (int i = 0; i < 3; i++)
+                        _number(J, pressurewindownames[i], "%.2f", avg[i]);
+                _close(J, '}');
+        }
+}
+
+
+static void _pressure(Json_T J, Pressure_T cpu, Pressure_T memory, Pressure_T io) {
+        if (_selected(J, "pressure") && (cpu->some[0] >= 0. || memory->some[0] >= 0. || io->some[0] >= 0.)) {
+                _open(J, "pressure", '{');
+                struct {const char *name; Pressure_T pressure;} resources[] = {{"cpu", cpu}, {"memory", memory}, {"io", io}};
+                for (int i = 0; i < 3; i++) {
+                        if (resources[i].pressure->some[0] >= 0.) {
+                                _open(J, resources[i].name, '{');
+                                _pressureAverages(J, "some", resources[i].pressure->some);
+                                _pressureAverages(J, "full", resources[i].pressure->full);
+                                _close(J, '}');
+                        }
+                }
+                _close(J, '}');
+        }
+}
+
+
+static void _timestamps(Json_T J, uint64_t access, uint64_t change, uint64_t modify) {
+        if (_selected(J, "timestamps")) {
+                _open(J, "timestamps", '{');
+                _number(J, "access", "%"PRIu64, access);
+                _number(J, "change", "%"PRIu64, change);
+                _number(J, "modify", "%"PRIu64, modify);
+                _close(J, '}');
+        }
+}
+
+
+static void _owner(Json_T J, mode_t mode, uid_t uid, gid_t gid) {
+        if (_selected(J, "mode"))
+                _number(J, "mode", "\"%o\"", mode & 07777);
+        if (_selected(J, "uid"))
+                _number(J, "uid", "%d", (int)uid);
+        if (_selected(J, "gid"))
+                _number(J, "gid", "%d", (int)gid);
+}
+
+
+static void _linkDirection(Json_T J, const char *name, int64_t packetsNow, int64_t packetsTotal, int64_t bytesNow, int64_t bytesTotal, int64_t errorsNow, int64_t errorsTotal) {
+        _open(J, name, '{');
+        _open(J, "packets", '{');
+        _number(J, "now", "%"PRId64, packetsNow);
+        _number(J, "total", "%"PRId64, packetsTotal);
+        _close(J, '}');
+        _open(J, "bytes", '{');
+        _number(J, "now", "%"PRId64, bytesNow);
+        _number(J, "total", "%"PRId64, bytesTotal);
+        _close(J, '}');
+        _open(J, "errors", '{');
+        _number(J, "now", "%"PRId64, errorsNow);
+        _number(J, "total", "%"PRId64, errorsTotal);
+        _close(J, '}');
+        _close(J, '}');
+}
+
+
+static void _responseTime(Json_T J, Connection_State state, double response) {
+        if (state == Connection_Ok)
+                _number(J, "responsetime", "%.6f", response / 1000.); // [s] with microseconds precision
+        else
+                _number(J, "responsetime", "null");
+}
+
+
+static void _connectTime(Json_T J, Connection_State state, double connect) {
+        if (state == Connection_Ok)
+                _number(J, "connecttime", "%.6f", connect / 1000.); // [s], zero if the kept-open connection was reused
+        else
+                _number(J, "connecttime", "null");
+}
+
+
+static void _histogram(Json_T J, const char *name, Histogram_T h) {
+        _open(J, name, '{');
+        _number(J, "count", "%"PRIu64, Histogram_count(h));
+        _number(J, "mean", "%.0f", Histogram_mean(h));
+        _number(J, "p50", "%"PRIu64, Histogram_percentile(h, 50));
+        _number(J, "p90", "%"PRIu64, Histogram_percentile(h, 90));
+        _number(J, "p99", "%"PRIu64, Histogram_percentile(h, 99));
+        _number(J, "max", "%"PRIu64, Histogram_max(h));
+        _close(J, '}');
+}
+
+
+static void _service(Json_T J, Service_T S) {
+        _open(J, NULL, '{');
+        _string(J, "name", S->name);
+        if (_selected(J, "type"))
+                _string(J, "type", servicetypes[S->type]);
+        if (_selected(J, "collected"))
+                _number(J, "collected", "%"PRId64".%06ld", (int64_t)S->collected.tv_sec, (long)S->collected.tv_usec);
+        if (_selected(J, "status"))
+                _number(J, "status", "%d", S->error);
+        if (_selected(J, "statushint"))
+                _number(J, "statushint", "%d", S->error_hint);
+        if (_selected(J, "monitor"))
+                _number(J, "monitor", "%d", S->monitor);
+        if (_selected(J, "monitormode"))
+                _string(J, "monitormode", modenames[S->mode]);
+        if (_selected(J, "pendingaction"))
+                _string(J, "pendingaction", actionnames[S->doaction]);
+        if (_selected(J, "priority"))
+                _string(J, "priority", prioritynames[S->priority]);
+        if (_selected(J, "deferred"))
+                _number(J, "deferred", "%"PRIu64, S->deferral.count);
+        if (_selected(J, "profile")) {
+                _open(J, "profile", '{');
+                _histogram(J, "wall", &(S->profile.wall));
+                _histogram(J, "cpu", &(S->profile.cpu));
+                _close(J, '}');
+        }
+        if (Util_hasServiceStatus(S)) {
+                switch (S->type) {
+                        case Service_File:
+                                _owner(J, S->inf.file->mode, S->inf.file->uid, S->inf.file->gid);
+                                _timestamps(J, S->inf.file->timestamp.access, S->inf.file->timestamp.change, S->inf.file->timestamp.modify);
+                                if (_selected(J, "size"))
+                                        _number(J, "size", "%"PRId64, (int64_t)S->inf.file->size);
+                                if (S->checksum && _selected(J, "checksum")) {
+                                        _open(J, "checksum", '{');
+                                        _string(J, "type", checksumnames[S->checksum->type]);
+                                        _string(J, "value", S->inf.file->cs_sum);
+                                        _close(J, '}');
+                                }
+                                break;
+
+                        case Service_Directory:
+                                _owner(J, S->inf.directory->mode, S->inf.directory->uid, S->inf.directory->gid);
+                                _timestamps(J, S->inf.directory->timestamp.access, S->inf.directory->timestamp.change, S->inf.directory->timestamp.modify);
+                                break;
+
+                        case Service_Fifo:
+                                _owner(J, S->inf.fifo->mode, S->inf.fifo->uid, S->inf.fifo->gid);
+                                _timestamps(J, S->inf.fifo->timestamp.access, S->inf.fifo->timestamp.change, S->inf.fifo->timestamp.modify);
+                                break;
+
+                        case Service_Filesystem:
+                                if (_selected(J, "fstype"))
+                                        _string(J, "fstype", S->inf.filesystem->object.type);
+                                if (_selected(J, "fsflags"))
+                                        _string(J, "fsflags", S->inf.filesystem->flags);
+                                _owner(J, S->inf.filesystem->mode, S->inf.filesystem->uid, S->inf.filesystem->gid);
+                                if (_selected(J, "block")) {
+                                        _open(J, "block", '{');
+                                        _number(J, "percent", "%.1f", S->inf.filesystem->space_percent);
+                                        _number(J, "usage", "%.0lf", S->inf.filesystem->f_bsize > 0 ? (double)S->inf.filesystem->f_blocksused * (double)S->inf.filesystem->f_bsize : 0.);
+                                        _number(J, "total", "%.0lf", S->inf.filesystem->f_bsize > 0 ? (double)S->inf.filesystem->f_blocks * (double)S->inf.filesystem->f_bsize : 0.);
+                                        _close(J, '}');
+                                }
+                                if (S->inf.filesystem->f_files > 0 && _selected(J, "inode")) {
+                                        _open(J, "inode", '{');
+                                        _number(J, "percent", "%.1f", S->inf.filesystem->inode_percent);
+                                        _number(J, "usage", "%"PRId64, S->inf.filesystem->f_filesused);
+                                        _number(J, "total", "%"PRId64, S->inf.filesystem->f_files);
+                                        _close(J, '}');
+                                }
+                                if (_selected(J, "read"))
+                                        _ioStatistics(J, "read", &(S->inf.filesystem->read));
+                                if (_selected(J, "write"))
+                                        _ioStatistics(J, "write", &(S->inf.filesystem->write));
+                                break;
+
+                        case Service_Net:
+                                if (_selected(J, "link")) {
+                                        _open(J, "link", '{');
+                                        _number(J, "state", "%d", Link_getState(S->inf.net->stats));
+                                        _number(J, "speed", "%"PRId64, Link_getSpeed(S->inf.net->stats));
+                                        _number(J, "duplex", "%d", Link_getDuplex(S->inf.net->stats));
+                                        _linkDirection(J, "download",
+                                                       Link_getPacketsInPerSecond(S->inf.net->stats),
+                                                       Link_getPacketsInTotal(S->inf.net->stats),
+                                                       Link_getBytesInPerSecond(S->inf.net->stats),
+                                                       Link_getBytesInTotal(S->inf.net->stats),
+                                                       Link_getErrorsInPerSecond(S->inf.net->stats),
+                                                       Link_getErrorsInTotal(S->inf.net->stats));
+                                        _linkDirection(J, "upload",
+                                                       Link_getPacketsOutPerSecond(S->inf.net->stats),
+                                                       Link_getPacketsOutTotal(S->inf.net->stats),
+                                                       Link_getBytesOutPerSecond(S->inf.net->stats),
+                                                       Link_getBytesOutTotal(S->inf.net->stats),
+                                                       Link_getErrorsOutPerSecond(S->inf.net->stats),
+                                                       Link_getErrorsOutTotal(S->inf.net->stats));
+                                        _close(J, '}');
+                                }
+                                break;
+
+                        case Service_Process:
+                                if (_selected(J, "pid"))
+                                        _number(J, "pid", "%d", S->inf.process->pid);
+                                if (_selected(J, "ppid"))
+                                        _number(J, "ppid", "%d", S->inf.process->ppid);
+                                if (_selected(J, "uid"))
+                                        _number(J, "uid", "%d", S->inf.process->uid);
+                                if (_selected(J, "euid"))
+                                        _number(J, "euid", "%d", S->inf.process->euid);
+                                if (_selected(J, "gid"))
+                                        _number(J, "gid", "%d", S->inf.process->gid);
+                                if (_selected(J, "uptime"))
+                                        _number(J, "uptime", "%"PRId64, (int64_t)S->inf.process->uptime);
+                                if (Run.flags & Run_ProcessEngineEnabled) {
+                                        if (_selected(J, "threads"))
+                                                _number(J, "threads", "%d", S->inf.process->threads);
+                                        if (_selected(J, "children"))
+                                                _number(J, "children", "%d", S->inf.process->children);
+                                        if (_selected(J, "memory")) {
+                                                _open(J, "memory", '{');
+                                                _number(J, "percent", "%.1f", S->inf.process->mem_percent);
+                                                _number(J, "percenttotal", "%.1f", S->inf.process->total_mem_percent);
+                                                _number(J, "bytes", "%"PRIu64, S->inf.process->mem);
+                                                _number(J, "bytestotal", "%"PRIu64, S->inf.process->total_mem);
+                                                _close(J, '}');
+                                        }
+                                        if (_selected(J, "cpu")) {
+                                                _open(J, "cpu", '{');
+                                                _number(J, "percent", "%.1f", S->inf.process->cpu_percent);
+                                                _number(J, "percenttotal", "%.1f", S->inf.process->total_cpu_percent);
+                                                _close(J, '}');
+                                        }
+                                }
+                                if (_selected(J, "read"))
+                                        _ioStatistics(J, "read", &(S->inf.process->read));
+                                if (_selected(J, "write"))
+                                        _ioStatistics(J, "write", &(S->inf.process->write));
+                                _pressure(J, &(S->inf.process->pressure.cpu), &(S->inf.process->pressure.memory), &(S->inf.process->pressure.io));
+                                break;
+
+                        case Service_Cgroup:
+                                if (_selected(J, "threads"))
+                                        _number(J, "threads", "%d", S->inf.process->threads);
+                                if (_selected(J, "memory")) {
+                                        _open(J, "memory", '{');
+                                        _number(J, "percent", "%.1f", S->inf.process->mem_percent);
+                                        _number(J, "percenttotal", "%.1f", S->inf.process->total_mem_percent);
+                                        _number(J, "bytes", "%"PRIu64, S->inf.process->mem);
+                                        _number(J, "bytestotal", "%"PRIu64, S->inf.process->total_mem);
+                                        _close(J, '}');
+                                }
+                                if (_selected(J, "cpu")) {
+                                        _open(J, "cpu", '{');
+                                        _number(J, "percenttotal", "%.1f", S->inf.process->total_cpu_percent);
+                                        _close(J, '}');
+                                }
+                                if (_selected(J, "read"))
+                                        _ioStatistics(J, "read", &(S->inf.process->read));
+                                if (_selected(J, "write"))
+                                        _ioStatistics(J, "write", &(S->inf.process->write));
+                                _pressure(J, &(S->inf.process->pressure.cpu), &(S->inf.process->pressure.memory), &(S->inf.process->pressure.io));
+                                break;
+
+                        case Service_System:
+                                if (_selected(J, "load")) {
+                                        _open(J, "load", '{');
+                                        _number(J, "avg01", "%.2f", systeminfo.loadavg[0]);
+                                        _number(J, "avg05", "%.2f", systeminfo.loadavg[1]);
+                                        _number(J, "avg15", "%.2f", systeminfo.loadavg[2]);
+                                        _close(J, '}');
+                                }
+                                if (_selected(J, "cpu")) {
+                                        _open(J, "cpu", '{');
+                                        _number(J, "user", "%.1f", systeminfo.cpu.usage.user > 0. ? systeminfo.cpu.usage.user : 0.);
+                                        _number(J, "system", "%.1f", systeminfo.cpu.usage.system > 0. ? systeminfo.cpu.usage.system : 0.);
+#ifdef HAVE_CPU_WAIT
+                                        _number(J, "wait", "%.1f", systeminfo.cpu.usage.wait > 0. ? systeminfo.cpu.usage.wait : 0.);
+#endif
+                                        if (systeminfo.cpu.usage.steal >= 0.) {
+                                                _number(J, "steal", "%.1f", systeminfo.cpu.usage.steal);
+                                                _number(J, "guest", "%.1f", systeminfo.cpu.usage.guest > 0. ? systeminfo.cpu.usage.guest : 0.);
+                                        }
+                                        if (systeminfo.cpu.core.count > 0) {
+                                                _open(J, "cores", '[');
+                                                for (int i = 0; i < systeminfo.cpu.core.count; i++)
+                                                        _number(J, NULL, "%.1f", systeminfo.cpu.core.usage[i]);
+                                                _close(J, ']');
+                                        }
+                                        _close(J, '}');
+                                }
+                                if (_selected(J, "memory")) {
+                                        _open(J, "memory", '{');
+                                        _number(J, "percent", "%.1f", systeminfo.memory.usage.percent);
+                                        _number(J, "bytes", "%"PRIu64, (uint64_t)systeminfo.memory.usage.bytes);
+                                        _close(J, '}');
+                                }
+                                if (_selected(J, "swap")) {
+                                        _open(J, "swap", '{');
+                                        _number(J, "percent", "%.1f", systeminfo.swap.usage.percent);
+                                        _number(J, "bytes", "%"PRIu64, (uint64_t)systeminfo.swap.usage.bytes);
+                                        _close(J, '}');
+                                }
+                                _pressure(J, &(systeminfo.pressure.cpu), &(systeminfo.pressure.memory), &(systeminfo.pressure.io));
+                                break;
+
+                        case Service_Program:
+                                if (S->program->started && _selected(J, "program")) {
+                                        _open(J, "program", '{');
+                                        _number(J, "started", "%"PRId64, (int64_t)S->program->started);
+                                        _number(J, "status", "%d", S->program->exitStatus);
+                                        _string(J, "output", StringBuffer_toString(S->program->lastOutput));
+                                        _close(J, '}');
+                                }
+                                break;
+
+                        default:
+                                break;
+                }
+                if (S->icmplist && _selected(J, "icmp")) {
+                        _open(J, "icmp", '[');
+                        for (Icmp_T i = S->icmplist; i; i = i->next) {
+                                _open(J, NULL, '{');
+                                _string(J, "type", icmpnames[i->type]);
+                                _responseTime(J, i->is_available, i->response);
+                                _close(J, '}');
+                        }
+                        _close(J, ']');
+                }
+                if (S->portlist && _selected(J, "port")) {
+                        _open(J, "port", '[');
+                        for (Port_T p = S->portlist; p; p = p->next) {
+                                _open(J, NULL, '{');
+                                _string(J, "hostname", p->hostname);
+                                _number(J, "portnumber", "%d", p->target.net.port);
+                                _string(J, "request", Util_portRequestDescription(p));
+                                _string(J, "protocol", p->protocol->name);
+                                _string(J, "type", Util_portTypeDescription(p));
+                                _responseTime(J, p->is_available, p->response);
+                                if (p->keepalive)
+                                        _connectTime(J, p->is_available, p->connect);
+                                if (p->target.net.ssl.options.flags)
+                                        _number(J, "certificatevalid", "%d", p->target.net.ssl.certificate.validDays);
+                                _close(J, '}');
+                        }
+                        _close(J, ']');
+                }
+                if (S->socketlist && _selected(J, "unix")) {
+                        _open(J, "unix", '[');
+                        for (Port_T p = S->socketlist; p; p = p->next) {
+                                _open(J, NULL, '{');
+                                _string(J, "path", p->target.unix.pathname);
+                                _string(J, "protocol", p->protocol->name);
+                                _responseTime(J, p->is_available, p->response);
+                                if (p->keepalive)
+                                        _connectTime(J, p->is_available, p->connect);
+                                _close(J, '}');
+                        }
+                        _close(J, ']');
+                }
+        }
+        _close(J, '}');
+}
+
+
+/* ---------------------------------------------------- MARK: - Public */
+
+
+/**
+ * Get a JSON formated status of monitored services. The document is
+ * written directly into the given buffer.
+ * @param B Output StringBuffer object
+ * @param services Comma separated list of service names or NULL for all services
+ * @param group Service group name or NULL
+ * @param fields Comma separated list of service fields or NULL for all fields
+ * @return The number of services written
+ */
+int status_json(StringBuffer_T B, const char *services, const char *group, const char *fields) {
+        int found = 0;
+        struct Json_T json = {.B = B, .fields = fields, .depth = 0, .first = {true}};
+        Json_T J = &json;
+        _open(J, NULL, '{');
+        _open(J, "server", '{');
+        _string(J, "id", Run.id);
+        _number(J, "incarnation", "%"PRId64, (int64_t)Run.incarnation);
+        _string(J, "version", VERSION);
+        _number(J, "uptime", "%"PRId64, (int64_t)ProcessTree_getProcessUptime(getpid()));
+        _number(J, "poll", "%d", Run.polltime);
+        _string(J, "localhostname", Run.system->name);
+        _open(J, "profile", '{');
+        _histogram(J, "cycle", &(Run.profile.cycle));
+        _histogram(J, "overrun", &(Run.profile.overrun));
+        _histogram(J, "processtree", &(Run.profile.processtree));
+        _histogram(J, "event", &(Run.profile.event));
+        _histogram(J, "notification", &(Run.profile.notification));
+        _close(J, '}');
+        _close(J, '}');
+        _open(J, "services", '[');
+        if (group && *group) {
+                for (ServiceGroup_T sg = servicegrouplist; sg; sg = sg->next) {
+                        if (IS(group, sg->name)) {
+                                for (list_t m = sg->members->head; m; m = m->next) {
+                                        Service_T s = m->e;
+                                        if (! services || ! *services || _hasToken(services, s->name)) {
+                                                _service(J, s);
+                                                found++;
+                                        }
+                                }
+                                break;
+                        }
+                }
+        } else {
+                for (Service_T s = servicelist_conf; s; s = s->next_conf) {
+                        if (! services || ! *services || _hasToken(services, s->name)) {
+                                _service(J, s);
+                                found++;
+                        }
+                }
+        }
+        _close(J, ']');
+        _close(J, '}');
+        return found;
+}
+
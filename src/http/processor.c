@@ -68,6 +68,10 @@
 #include <limits.h>
 #endif
 
+#ifdef HAVE_ZLIB_H
+#include <zlib.h>
+#endif
+
 #include "monit.h"
 #include "processor.h"
 #include "base64.h"
@@ -100,7 +104,18 @@
  */
 
 
+// The response output buffer is kept for the next request, unless the response was larger than this limit
+#define OUTPUTBUFFER_CACHE_LIMIT 1048576
+
+
 static int _httpPostLimit;
+static int _outputHint = 256;                   // The size of the previous response, used as the initial size of a new output buffer
+static StringBuffer_T _outputBuffer = NULL;     // The requests are processed sequentially, so one output buffer is reused
+#ifdef HAVE_LIBZ
+static bool _zstreamReady = false;              // The compressor is initialized once and reset for each response
+static z_stream _zstream;
+static unsigned char _zbuffer[16384];
+#endif
 
 
 /* -------------------------------------------------------------- Prototypes */
@@ -112,6 +127,8 @@ static char *get_date(char *, int);
 static char *get_server(char *, int);
 static void create_headers(HttpRequest);
 static void send_response(HttpRequest, HttpResponse);
+static void send_headers(HttpResponse, ssize_t);
+static bool flush(HttpResponse, bool);
 static bool basic_authenticate(HttpRequest);
 static void done(HttpRequest, HttpResponse);
 static void destroy_HttpRequest(HttpRequest);
@@ -231,6 +248,21 @@ void send_error(HttpRequest req, HttpResponse res, int code, const char *msg, ..
 }
 
 
+/**
+ * Send the content of the output buffer to the client and clear the
+ * buffer. The first call commits the response: the headers are sent
+ * without Content-Length and the body is delimited by closing the
+ * connection. If the client accepts gzip, the body is compressed as it
+ * is sent. Use this method to stream large responses.
+ * @param res HttpResponse object
+ * @return true if the data was sent, otherwise false
+ */
+bool flush_response(HttpResponse res) {
+        ASSERT(res);
+        return flush(res, false);
+}
+
+
 /* -------------------------------------------------------------- Properties */
 
 
@@ -443,6 +475,10 @@ static void do_service(Socket_T s) {
         volatile HttpResponse res = create_HttpResponse(s);
         volatile HttpRequest req = create_HttpRequest(s);
         if (res && req) {
+#ifdef HAVE_LIBZ
+                const char *acceptEncoding = get_header(req, "Accept-Encoding");
+                res->can_compress = acceptEncoding && Str_sub(acceptEncoding, "gzip");
+#endif
                 if (Run.httpd.socket.net.ssl.flags & SSL_Enabled)
                         set_header(res, "Strict-Transport-Security", "max-age=63072000; includeSubdomains; preload");
                 if (is_authenticated(req, res)) {
@@ -482,45 +518,124 @@ static char *get_server(char *result, int size) {
 
 
 /**
- * Send the response to the client. If the response has already been
- * commited, this function does nothing.
+ * Send the response status line and headers to the client and commit the
+ * response. If contentLength is negative, the Content-Length header is not
+ * sent and the body is delimited by closing the connection.
  */
-static void send_response(HttpRequest req, HttpResponse res) {
+static void send_headers(HttpResponse res, ssize_t contentLength) {
         Socket_T S = res->S;
+        char date[STRLEN];
+        char server[STRLEN];
+        char *headers = get_headers(res);
+        res->is_committed = true;
+        get_date(date, STRLEN);
+        get_server(server, STRLEN);
+        Socket_print(S, "%s %d %s\r\n", res->protocol, res->status, res->status_msg);
+        Socket_print(S, "Date: %s\r\n", date);
+        Socket_print(S, "Server: %s\r\n", server);
+        if (contentLength >= 0)
+                Socket_print(S, "Content-Length: %zd\r\n", contentLength);
+        Socket_print(S, "Connection: close\r\n");
+        if (headers)
+                Socket_print(S, "%s", headers);
+        Socket_print(S, "\r\n");
+        FREE(headers);
+}
 
-        if (! res->is_committed) {
-                char date[STRLEN];
-                char server[STRLEN];
+
+/**
+ * Start the gzip compression of the response body. The compressor is
+ * reused, so only the first response pays for its initialization.
+ */
+static bool start_compression(void) {
 #ifdef HAVE_LIBZ
-                const char *acceptEncoding = get_header(req, "Accept-Encoding");
-                bool canCompress = acceptEncoding && Str_sub(acceptEncoding, "gzip") ? true : false;
+        if (_zstreamReady)
+                return deflateReset(&_zstream) == Z_OK;
+        int status = deflateInit2(&_zstream, 6, Z_DEFLATED, 15 | 16, 8, Z_DEFAULT_STRATEGY);
+        if (status != Z_OK) {
+                LogError("HttpRequest: cannot initialize the compression -- %s\n", zError(status));
+                return false;
+        }
+        _zstreamReady = true;
+        return true;
 #else
-                bool canCompress = false;
+        return false;
 #endif
-                const void *body = NULL;
-                size_t bodyLength = 0;
-                if (canCompress && StringBuffer_length(res->outputbuffer) > 0) {
-                        body = StringBuffer_toCompressed(res->outputbuffer, 6, &bodyLength);
+}
+
+
+/**
+ * Compress the data and send the output to the client. The output is
+ * flushed, so the client can process the data received so far. If finish
+ * is true, the gzip stream is terminated.
+ */
+static bool write_compressed(HttpResponse res, const void *data, int length, bool finish) {
+#ifdef HAVE_LIBZ
+        _zstream.next_in = (Bytef *)data;
+        _zstream.avail_in = length;
+        int status;
+        do {
+                _zstream.next_out = _zbuffer;
+                _zstream.avail_out = sizeof(_zbuffer);
+                status = deflate(&_zstream, finish ? Z_FINISH : Z_SYNC_FLUSH);
+                if (status == Z_STREAM_ERROR)
+                        return false;
+                int n = sizeof(_zbuffer) - _zstream.avail_out;
+                if (n > 0 && Socket_write(res->S, _zbuffer, n) < 0)
+                        return false;
+        } while (_zstream.avail_out == 0 && status != Z_STREAM_END);
+        return true;
+#else
+        return false;
+#endif
+}
+
+
+/**
+ * Send the output buffer content, commit the response first if needed.
+ * If finish is true, the response is complete.
+ */
+static bool flush(HttpResponse res, bool finish) {
+        bool rv = true;
+        Socket_cork(res->S);
+        if (! res->is_committed) {
+                if (res->can_compress && start_compression()) {
+                        res->is_compressed = true;
                         set_header(res, "Content-Encoding", "gzip");
-                } else {
-                        body = StringBuffer_toString(res->outputbuffer);
-                        bodyLength = StringBuffer_length(res->outputbuffer);
                 }
-                char *headers = get_headers(res);
-                res->is_committed = true;
-                get_date(date, STRLEN);
-                get_server(server, STRLEN);
-                Socket_print(S, "%s %d %s\r\n", res->protocol, res->status, res->status_msg);
-                Socket_print(S, "Date: %s\r\n", date);
-                Socket_print(S, "Server: %s\r\n", server);
-                Socket_print(S, "Content-Length: %zu\r\n", bodyLength);
-                Socket_print(S, "Connection: close\r\n");
-                if (headers)
-                        Socket_print(S, "%s", headers);
-                Socket_print(S, "\r\n");
-                if (bodyLength)
-                        Socket_write(S, (unsigned char *)body, bodyLength);
-                FREE(headers);
+                send_headers(res, -1);
+        }
+        int length = StringBuffer_length(res->outputbuffer);
+        if (res->is_compressed)
+                rv = write_compressed(res, StringBuffer_toString(res->outputbuffer), length, finish);
+        else if (length > 0)
+                rv = Socket_write(res->S, (unsigned char *)StringBuffer_toString(res->outputbuffer), length) >= 0;
+        if (Socket_uncork(res->S) < 0)
+                rv = false;
+        StringBuffer_clear(res->outputbuffer);
+        return rv;
+}
+
+
+/**
+ * Send the response to the client. If the client accepts gzip, the body
+ * is compressed as it is sent and delimited by closing the connection,
+ * otherwise the headers and the body are sent together. If the response
+ * has already been commited by flush_response(), only the remaining
+ * content of the output buffer is sent.
+ */
+static void send_response(HttpRequest req, HttpResponse res) {
+        Socket_T S = res->S;
+        int length = StringBuffer_length(res->outputbuffer);
+        if (res->is_committed || (res->can_compress && length > 0)) {
+                flush(res, true);
+        } else {
+                // Send the headers and the body together
+                Socket_cork(S);
+                send_headers(res, length);
+                if (length)
+                        Socket_write(S, (unsigned char *)StringBuffer_toString(res->outputbuffer), length);
+                Socket_uncork(S);
         }
 }
 
@@ -575,8 +690,16 @@ static HttpResponse create_HttpResponse(Socket_T S) {
         NEW(res);
         res->S = S;
         res->status = SC_OK;
-        res->outputbuffer = StringBuffer_create(256);
+        if (_outputBuffer) {
+                res->outputbuffer = _outputBuffer;
+                _outputBuffer = NULL;
+                StringBuffer_reserve(res->outputbuffer, _outputHint);
+        } else {
+                res->outputbuffer = StringBuffer_create(_outputHint);
+        }
         res->is_committed = false;
+        res->can_compress = false;
+        res->is_compressed = false;
         res->protocol = SERVER_PROTOCOL;
         res->status_msg = get_status_string(SC_OK);
         Util_getToken(res->token);
@@ -696,7 +819,12 @@ static void destroy_HttpRequest(HttpRequest req) {
  */
 static void destroy_HttpResponse(HttpResponse res) {
         if (res) {
-                StringBuffer_free(&(res->outputbuffer));
+                int length = StringBuffer_length(res->outputbuffer);
+                _outputHint = MAX(256, MIN(length, OUTPUTBUFFER_CACHE_LIMIT));
+                if (! _outputBuffer && length <= OUTPUTBUFFER_CACHE_LIMIT)
+                        _outputBuffer = StringBuffer_clear(res->outputbuffer);
+                else
+                        StringBuffer_free(&(res->outputbuffer));
                 if (res->headers)
                         destroy_entry(res->headers);
                 FREE(res);
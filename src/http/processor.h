@@ -86,6 +86,8 @@ typedef struct response {
         Socket_T S;
         const char *protocol;
         bool is_committed;
+        bool can_compress;      // The client accepts gzip
+        bool is_compressed;     // The committed body is gzip compressed
         HttpHeader headers;
         const char *status_msg;
         StringBuffer_T outputbuffer;
@@ -106,6 +108,7 @@ void escapeHTML(StringBuffer_T sb, const char *s);
 void send_error(HttpRequest, HttpResponse, int status, const char *message, ...) __attribute__((format (printf, 4, 5)));
 const char *get_parameter(HttpRequest req, const char *parameter_name);
 void set_header(HttpResponse res, const char *name, const char *value, ...) __attribute__((format (printf, 3, 4)));
+bool flush_response(HttpResponse res);
 void Processor_setHttpPostLimit(void);
 
 #endif
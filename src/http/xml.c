@@ -209,8 +209,10 @@ static void status_service(Service_T S, StringBuffer_T B, int V) {
                             S->doaction);
         if (S->every.type != Every_Cycle) {
                 StringBuffer_append(B, "<every><type>%d</type>", S->every.type);
-                if (S->every.type == 1)
+                if (S->every.type == Every_SkipCycles)
                         StringBuffer_append(B, "<counter>%d</counter><number>%d</number>", S->every.spec.cycle.counter, S->every.spec.cycle.number);
+                else if (S->every.type == Every_Adaptive)
+                        StringBuffer_append(B, "<counter>%d</counter><number>%d</number><maximum>%d</maximum>", S->every.spec.adaptive.counter, S->every.spec.adaptive.interval, S->every.spec.adaptive.maximum);
                 else
                         StringBuffer_append(B, "<cron>%s</cron>", S->every.spec.cron);
                 StringBuffer_append(B, "</every>");
@@ -419,6 +421,28 @@ static void status_service(Service_T S, StringBuffer_T B, int V) {
                                 _ioStatistics(B, "write", &(S->inf.process->write));
                                 break;
 
+                        case Service_Cgroup:
+                                StringBuffer_append(B,
+                                        "<threads>%d</threads>"
+                                        "<memory>"
+                                        "<percent>%.1f</percent>"
+                                        "<percenttotal>%.1f</percenttotal>"
+                                        "<kilobyte>%"PRIu64"</kilobyte>"
+                                        "<kilobytetotal>%"PRIu64"</kilobytetotal>"
+                                        "</memory>"
+                                        "<cpu>"
+                                        "<percenttotal>%.1f</percenttotal>"
+                                        "</cpu>",
+                                        S->inf.process->threads,
+                                        S->inf.process->mem_percent,
+                                        S->inf.process->total_mem_percent,
+                                        (uint64_t)((double)S->inf.process->mem / 1024.),
+                                        (uint64_t)((double)S->inf.process->total_mem / 1024.),
+                                        S->inf.process->total_cpu_percent);
+                                _ioStatistics(B, "read", &(S->inf.process->read));
+                                _ioStatistics(B, "write", &(S->inf.process->write));
+                                break;
+
                         default:
                                 break;
                 }
@@ -68,10 +68,19 @@
 #include <sys/stat.h>
 #endif
 
+#ifdef HAVE_SYS_UIO_H
+#include <sys/uio.h>
+#endif
+
+#ifdef HAVE_FCNTL_H
+#include <fcntl.h>
+#endif
+
 #include "monit.h"
 
 // libmonit
 #include "system/Time.h"
+#include "exceptions/AssertException.h"
 
 
 /**
@@ -79,6 +88,13 @@
  *  with a preceding timestamp. Methods support both syslog or own
  *  logfile.
  *
+ *  When the writer thread is started (see log_start()), messages are
+ *  formatted by the caller into a lock-free ring buffer and written in
+ *  batches by the writer thread. If the ring buffer is full, messages
+ *  are dropped and the number of lost messages is logged when space is
+ *  available again. Messages with critical or higher priority flush the
+ *  ring buffer and are written synchronously.
+ *
  *  @file
  */
 
@@ -86,10 +102,51 @@
 /* ----------------------------------------------------- MARK: - Definitions */
 
 
-static FILE *LOG = NULL;
+#define LOG_SLOTS      1024 /* Number of ring buffer records, must be a power of 2 */
+#define LOG_RECORDSIZE 512  /* Inline message buffer, longer messages are allocated */
+#define LOG_BATCH      32   /* Maximum number of records written in one batch */
+
+
+typedef struct LogRecord_T {
+        unsigned int sequence;                      /**< Ring buffer slot sequence */
+        int priority;                                     /**< The log priority */
+        time_t timestamp;                            /**< When the message was logged */
+        size_t length;                                  /**< The message length */
+        char *message;        /**< The message, points to buffer if it fits there */
+        char prefix[64];                    /**< Timestamp and priority prefix */
+        char buffer[LOG_RECORDSIZE];
+} *LogRecord_T;
+
+
+static int LOG = -1;
 static Mutex_T log_mutex = PTHREAD_MUTEX_INITIALIZER;
 
 
+/* Ring buffer. Producers are lock-free, the consumer side is serialized by log_mutex */
+static struct {
+        unsigned int head;                        /**< Next slot for producers */
+        unsigned int tail;                         /**< Next slot for consumer */
+        unsigned int dropped;            /**< Messages dropped on ring overflow */
+        struct LogRecord_T records[LOG_SLOTS];
+} ring;
+
+
+static struct {
+        Thread_T thread;
+        Sem_T cond;
+        volatile bool running;
+        volatile bool stop;
+        bool sleeping;
+} writer = {.cond = PTHREAD_COND_INITIALIZER};
+
+
+/* The log timestamp is formatted at most once per second */
+static struct {
+        time_t second;
+        char datetime[STRLEN];
+} timestamp = {.second = -1};
+
+
 static struct mylogpriority {
         int  priority;
         char *description;
@@ -116,13 +173,11 @@ static bool open_log() {
         if (Run.flags & Run_UseSyslog) {
                 openlog(prog, LOG_PID, Run.facility);
         } else {
-                LOG = fopen(Run.files.log, "a+");
-                if (! LOG) {
+                LOG = open(Run.files.log, O_WRONLY | O_CREAT | O_APPEND, 0666);
+                if (LOG < 0) {
                         LogError("Error opening the log file '%s' for writing -- %s\n", Run.files.log, STRERROR);
                         return false;
                 }
-                /* Set logger in unbuffered mode */
-                setvbuf(LOG, NULL, _IONBF, 0);
         }
         return true;
 }
@@ -147,51 +202,194 @@ static const char *logPriorityDescription(int p) {
 
 
 /**
- * Log a message to monits logfile or syslog.
- * @param priority A message priority
- * @param s A formated (printf-style) string to log
+ * Format the message into the log record
  */
-static void log_log(int priority, const char *s, va_list ap) {
-        ASSERT(s);
-#ifdef HAVE_VA_COPY
+static void _format(LogRecord_T r, int priority, const char *s, va_list ap) {
         va_list ap_copy;
-#endif
-        LOCK(log_mutex)
-        {
-
-                FILE *output = priority < LOG_INFO ? stderr : stdout;
-#ifdef HAVE_VA_COPY
+        va_copy(ap_copy, ap);
+        int length = vsnprintf(r->buffer, sizeof(r->buffer), s, ap_copy);
+        va_end(ap_copy);
+        if (length < 0) {
+                *r->buffer = 0;
+                length = 0;
+        }
+        if (length < sizeof(r->buffer)) {
+                r->message = r->buffer;
+        } else {
                 va_copy(ap_copy, ap);
-                vfprintf(output, s, ap_copy);
+                r->message = Str_vcat(s, ap_copy);
                 va_end(ap_copy);
-#else
-                vfprintf(output, s, ap);
-#endif
-                fflush(output);
-                if (Run.flags & Run_Log) {
-                        if (Run.flags & Run_UseSyslog) {
-#ifdef HAVE_VA_COPY
-                                va_copy(ap_copy, ap);
-                                vsyslog(priority, s, ap_copy);
-                                va_end(ap_copy);
-#else
-                                vsyslog(priority, s, ap);
-#endif
-                        } else if (LOG) {
-                                char datetime[STRLEN];
-                                fprintf(LOG, "[%s] %-8s : ", Time_fmt(datetime, sizeof(datetime), TIMEFORMAT, time(NULL)), logPriorityDescription(priority));
-#ifdef HAVE_VA_COPY
-                                va_copy(ap_copy, ap);
-                                vfprintf(LOG, s, ap_copy);
-                                va_end(ap_copy);
-#else
-                                vfprintf(LOG, s, ap);
-#endif
+        }
+        r->length = length;
+        r->priority = priority;
+        r->timestamp = Time_now();
+}
+
 
+/**
+ * Write all iovecs to the file descriptor
+ */
+static void _writev(int fd, struct iovec *iov, int count) {
+        while (count > 0) {
+                ssize_t n = writev(fd, iov, count);
+                if (n < 0) {
+                        if (errno == EINTR)
+                                continue;
+                        return;
+                }
+                while (count > 0 && n >= iov->iov_len) {
+                        n -= iov->iov_len;
+                        iov++;
+                        count--;
+                }
+                if (count > 0) {
+                        iov->iov_base = (char *)iov->iov_base + n;
+                        iov->iov_len -= n;
+                }
+        }
+}
+
+
+/**
+ * Write the batch of log records to the console and to the log. Must be called with log_mutex locked
+ */
+static void _write(LogRecord_T *batch, int count) {
+        for (int i = 0; i < count; i++)
+                fwrite(batch[i]->message, 1, batch[i]->length, batch[i]->priority < LOG_INFO ? stderr : stdout);
+        fflush(stderr);
+        fflush(stdout);
+        if (Run.flags & Run_Log) {
+                if (Run.flags & Run_UseSyslog) {
+                        for (int i = 0; i < count; i++)
+                                syslog(batch[i]->priority, "%s", batch[i]->message);
+                } else if (LOG >= 0) {
+                        struct iovec iov[2 * LOG_BATCH];
+                        for (int i = 0; i < count; i++) {
+                                if (batch[i]->timestamp != timestamp.second) {
+                                        Time_fmt(timestamp.datetime, sizeof(timestamp.datetime), TIMEFORMAT, batch[i]->timestamp);
+                                        timestamp.second = batch[i]->timestamp;
+                                }
+                                iov[2 * i].iov_base = batch[i]->prefix;
+                                iov[2 * i].iov_len = snprintf(batch[i]->prefix, sizeof(batch[i]->prefix), "[%s] %-8s : ", timestamp.datetime, logPriorityDescription(batch[i]->priority));
+                                iov[2 * i + 1].iov_base = batch[i]->message;
+                                iov[2 * i + 1].iov_len = batch[i]->length;
                         }
+                        _writev(LOG, iov, 2 * count);
                 }
         }
+}
+
+
+/**
+ * Write all records pending in the ring buffer. Must be called with log_mutex locked
+ */
+static void _flush() {
+        int count;
+        LogRecord_T batch[LOG_BATCH];
+        do {
+                for (count = 0; count < LOG_BATCH; count++, ring.tail++) {
+                        LogRecord_T r = &ring.records[ring.tail & (LOG_SLOTS - 1)];
+                        if (__atomic_load_n(&r->sequence, __ATOMIC_ACQUIRE) != ring.tail + 1)
+                                break;
+                        batch[count] = r;
+                }
+                if (count) {
+                        _write(batch, count);
+                        for (int i = 0; i < count; i++) {
+                                if (batch[i]->message != batch[i]->buffer)
+                                        FREE(batch[i]->message);
+                                // Release the slot for the next round of producers
+                                __atomic_store_n(&batch[i]->sequence, batch[i]->sequence - 1 + LOG_SLOTS, __ATOMIC_RELEASE);
+                        }
+                }
+        } while (count == LOG_BATCH);
+        unsigned int dropped = __atomic_exchange_n(&ring.dropped, 0, __ATOMIC_ACQ_REL);
+        if (dropped) {
+                struct LogRecord_T r = {.priority = LOG_WARNING, .timestamp = Time_now()};
+                r.message = r.buffer;
+                r.length = snprintf(r.buffer, sizeof(r.buffer), "Log buffer overflow -- %u messages dropped\n", dropped);
+                _write((LogRecord_T[]){&r}, 1);
+        }
+}
+
+
+static bool _isEmpty() {
+        return __atomic_load_n(&ring.records[ring.tail & (LOG_SLOTS - 1)].sequence, __ATOMIC_SEQ_CST) != ring.tail + 1;
+}
+
+
+/**
+ * Push the message to the ring buffer. Returns false if the ring buffer is full
+ */
+static bool _push(int priority, const char *s, va_list ap) {
+        LogRecord_T r;
+        unsigned int position = __atomic_load_n(&ring.head, __ATOMIC_RELAXED);
+        while (true) {
+                r = &ring.records[position & (LOG_SLOTS - 1)];
+                int diff = (int)(__atomic_load_n(&r->sequence, __ATOMIC_ACQUIRE) - position);
+                if (diff == 0) {
+                        if (__atomic_compare_exchange_n(&ring.head, &position, position + 1, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+                                break;
+                } else if (diff < 0) {
+                        return false;
+                } else {
+                        position = __atomic_load_n(&ring.head, __ATOMIC_RELAXED);
+                }
+        }
+        _format(r, priority, s, ap);
+        __atomic_store_n(&r->sequence, position + 1, __ATOMIC_SEQ_CST);
+        if (__atomic_load_n(&writer.sleeping, __ATOMIC_SEQ_CST)) {
+                LOCK(log_mutex)
+                {
+                        Sem_signal(writer.cond);
+                }
+                END_LOCK;
+        }
+        return true;
+}
+
+
+static void *_writerThread(void *args) {
+        set_signal_block();
+        LOCK(log_mutex)
+        {
+                while (! writer.stop) {
+                        _flush();
+                        __atomic_store_n(&writer.sleeping, true, __ATOMIC_SEQ_CST);
+                        if (_isEmpty() && ! writer.stop)
+                                Sem_wait(writer.cond, log_mutex);
+                        __atomic_store_n(&writer.sleeping, false, __ATOMIC_SEQ_CST);
+                }
+                _flush();
+        }
         END_LOCK;
+        return NULL;
+}
+
+
+/**
+ * Log a message to monits logfile or syslog.
+ * @param priority A message priority
+ * @param s A formated (printf-style) string to log
+ */
+static void log_log(int priority, const char *s, va_list ap) {
+        ASSERT(s);
+        if (writer.running && priority > LOG_CRIT) {
+                if (! _push(priority, s, ap))
+                        __atomic_add_fetch(&ring.dropped, 1, __ATOMIC_ACQ_REL);
+        } else {
+                struct LogRecord_T r;
+                _format(&r, priority, s, ap);
+                LOCK(log_mutex)
+                {
+                        // Flush pending messages first to keep the log ordered
+                        _flush();
+                        _write((LogRecord_T[]){&r}, 1);
+                }
+                END_LOCK;
+                if (r.message != r.buffer)
+                        FREE(r.message);
+        }
 }
 
 
@@ -232,6 +430,28 @@ bool log_init() {
 }
 
 
+/**
+ * Start the log writer thread. Log messages with priority lower than
+ * critical are written asynchronously by the writer thread from then on.
+ * The thread is stopped by log_close(). Must be called after the process
+ * was daemonized, as the thread does not survive fork.
+ */
+void log_start() {
+        if (writer.running)
+                return;
+        LOCK(log_mutex)
+        {
+                ring.head = ring.tail = 0;
+                for (int i = 0; i < LOG_SLOTS; i++)
+                        ring.records[i].sequence = i;
+                writer.stop = false;
+                Thread_create(writer.thread, _writerThread, NULL);
+                writer.running = true;
+        }
+        END_LOCK;
+}
+
+
 /**
  * Logging interface with priority support
  * @param s A formated (printf-style) string to log
@@ -489,13 +709,24 @@ void vLogDebug(const char *s, va_list ap) {
  * Close the log file or syslog
  */
 void log_close() {
+        if (writer.running) {
+                writer.running = false;
+                LOCK(log_mutex)
+                {
+                        writer.stop = true;
+                        Sem_signal(writer.cond);
+                }
+                END_LOCK;
+                Thread_join(writer.thread);
+        }
         if (Run.flags & Run_UseSyslog) {
                 closelog();
         }
-        if (LOG  && (0 != fclose(LOG))) {
+        if (LOG >= 0 && close(LOG) != 0) {
+                LOG = -1;
                 LogError("Error closing the log file -- %s\n", STRERROR);
         }
-        LOG = NULL;
+        LOG = -1;
 }
 
 
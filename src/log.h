@@ -27,6 +27,7 @@
 #define LOG_INCLUDED
 
 bool log_init(void);
+void log_start(void);
 void LogEmergency(const char *, ...) __attribute__((format (printf, 1, 2)));
 void LogAlert(const char *, ...) __attribute__((format (printf, 1, 2)));
 void LogCritical(const char *, ...) __attribute__((format (printf, 1, 2)));
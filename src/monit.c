@@ -74,6 +74,10 @@
 #include <sys/wait.h>
 #endif
 
+#ifdef HAVE_POLL_H
+#include <poll.h>
+#endif
+
 #include "monit.h"
 #include "net.h"
 #include "ProcessTree.h"
@@ -83,6 +87,10 @@
 #include "client.h"
 #include "MMonit.h"
 #include "validate.h"
+#include "program.h"
+#include "watch.h"
+#include "pressure.h"
+#include "configcache.h"
 
 // libmonit
 #include "Bootstrap.h"
@@ -107,7 +115,7 @@
 /* -------------------------------------------------------------- Prototypes */
 
 
-static void  do_init(void);                   /* Initialize this application */
+static void  do_init(const char *);           /* Initialize this application */
 static void  do_reinit(void);       /* Re-initialize the runtime application */
 static void  do_action(int, char **);    /* Dispatch to the submitted action */
 static void  do_exit(bool);                           /* Finalize monit */
@@ -120,6 +128,8 @@ static RETSIGTYPE do_reload(int);       /* Signalhandler for a daemon reload */
 static RETSIGTYPE do_destroy(int);   /* Signalhandler for monit finalization */
 static RETSIGTYPE do_wakeup(int);  /* Signalhandler for a daemon wakeup call */
 static void waitforchildren(void); /* Wait for any child process not running */
+static void _sleep(int);          /* Sleep and validate out-of-cycle changes */
+static int  _reuseServices(Service_T);   /* Reuse unchanged services on reload */
 
 
 
@@ -137,20 +147,23 @@ Thread_T heartbeatThread;
 Sem_T    heartbeatCond;
 Mutex_T  heartbeatMutex;
 static volatile bool heartbeatRunning = false;
+static bool changesDeferred = false;
 
 char *actionnames[] = {"ignore", "alert", "restart", "stop", "exec", "unmonitor", "start", "monitor", ""};
 char *modenames[] = {"active", "passive"};
 char *onrebootnames[] = {"start", "nostart", "laststate"};
+char *prioritynames[] = {"normal", "high", "low"};
 char *checksumnames[] = {"UNKNOWN", "MD5", "SHA1"};
 char *operatornames[] = {"less than", "less than or equal to", "greater than", "greater than or equal to", "equal to", "not equal to", "changed"};
 char *operatorshortnames[] = {"<", "<=", ">", ">=", "=", "!=", "<>"};
-char *servicetypes[] = {"Filesystem", "Directory", "File", "Process", "Remote Host", "System", "Fifo", "Program", "Network"};
+char *servicetypes[] = {"Filesystem", "Directory", "File", "Process", "Remote Host", "System", "Fifo", "Program", "Network", "Cgroup"};
 char *pathnames[] = {"Path", "Path", "Path", "Pid file", "Path", "", "Path"};
 char *icmpnames[] = {"Reply", "", "", "Destination Unreachable", "Source Quench", "Redirect", "", "", "Ping", "", "", "Time Exceeded", "Parameter Problem", "Timestamp Request", "Timestamp Reply", "Information Request", "Information Reply", "Address Mask Request", "Address Mask Reply"};
 char *sslnames[] = {"auto", "v2", "v3", "tlsv1", "tlsv1.1", "tlsv1.2", "tlsv1.3"};
 char *socketnames[] = {"unix", "IP", "IPv4", "IPv6"};
 char *timestampnames[] = {"modify/change time", "access time", "change time", "modify time"};
 char *httpmethod[] = {"", "HEAD", "GET"};
+char *pressurewindownames[] = {"avg10", "avg60", "avg300"};
 
 
 /* ---------------------------------------------------- MARK: - Public */
@@ -170,7 +183,7 @@ int main(int argc, char **argv) {
 #endif
         init_env();
         handle_options(argc, argv);
-        do_init();
+        do_init(argv[optind]);
         do_action(argc, argv);
         do_exit(false);
         return 0;
@@ -203,6 +216,15 @@ bool interrupt() {
 /* --------------------------------------------------------- MARK: - Private */
 
 
+/**
+ * Test if the action only talks to the running daemon, so the global part of
+ * the configuration is sufficient and the configuration cache can be used
+ */
+static bool _isClientAction(const char *action) {
+        return action && (IS(action, "status") || IS(action, "summary") || IS(action, "report") || IS(action, "runtime") || IS(action, "reload") || IS(action, "quit"));
+}
+
+
 static void _validateOnce() {
         if (State_open()) {
                 State_restore();
@@ -218,7 +240,7 @@ static void _validateOnce() {
  * Parse the control file and initialize the program's
  * datastructures and the log system.
  */
-static void do_init() {
+static void do_init(const char *action) {
         /*
          * Register interest for the SIGTERM signal,
          * in case we run in daemon mode this signal
@@ -285,10 +307,15 @@ static void do_init() {
 
         /*
          * Start the Parser and create the service list. This will also set
-         * any Runtime constants defined in the controlfile.
+         * any Runtime constants defined in the controlfile. The client
+         * actions load the global configuration from the cache if valid.
          */
-        if (! parse(Run.files.control))
-                exit(1);
+        bool cached = _isClientAction(action) && ConfigCache_load();
+        if (! cached) {
+                if (! parse(Run.files.control))
+                        exit(1);
+                ConfigCache_save();
+        }
 
         /*
          * Initialize the log system
@@ -299,7 +326,7 @@ static void do_init() {
         /*
          * Did we find any service ?
          */
-        if (! servicelist) {
+        if (! cached && ! servicelist) {
                 LogError("No service has been specified\n");
                 exit(0);
         }
@@ -331,6 +358,11 @@ static void do_init() {
 static void do_reinit() {
         LogInfo("Reinitializing Monit -- control file '%s'\n", Run.files.control);
 
+        /* Stop the program supervisor, file watching and pressure triggers, the running programs are stopped when the services are freed or reused */
+        Program_stop();
+        Watch_stop();
+        Pressure_stop();
+
         /* Wait non-blocking for any children that has exited. Since we
          reinitialize any information about children we have setup to wait
          for will be lost. This may create zombie processes until Monit
@@ -347,21 +379,28 @@ static void do_reinit() {
 
         Run.flags &= ~Run_DoReload;
 
-        /* Stop http interface */
-        if (Run.httpd.flags & Httpd_Net || Run.httpd.flags & Httpd_Unix)
-                monit_http(Httpd_Stop);
+        /* Suspend the http interface, the requests are queued until the new configuration is ready */
+        monit_http(Httpd_Suspend);
 
-        /* Save the current state (no changes are possible now since the http thread is stopped) */
+        /* Save the current state (no changes are possible now since the http thread is suspended) */
         State_save();
         State_close();
 
-        /* Run the garbage collector */
-        gc();
+        /* Set the current services aside and free the global configuration */
+        Service_T services = servicelist;
+        ServiceGroup_T servicegroups = servicegrouplist;
+        uint64_t fingerprint = Run.fingerprint;
+        bool processEngine = Run.flags & Run_ProcessEngineEnabled;
+        servicelist = NULL;
+        servicegrouplist = NULL;
+        Util_resetServiceIndex();
+        gc_config();
 
         if (! parse(Run.files.control)) {
                 LogError("%s stopped -- error parsing configuration file\n", prog);
                 exit(1);
         }
+        ConfigCache_save();
 
         /* Close the current log */
         log_close();
@@ -369,6 +408,7 @@ static void do_reinit() {
         /* Reinstall the log system */
         if (! log_init())
                 exit(1);
+        log_start();
 
         /* Did we find any services ?  */
         if (! servicelist) {
@@ -389,9 +429,29 @@ static void do_reinit() {
                 exit(1);
         State_restore();
 
-        /* Start http interface */
-        if (can_http())
-                monit_http(Httpd_Start);
+        /* If the global configuration didn't change, the unchanged services are reused with their runtime data, otherwise all services are replaced */
+        bool changed = Run.fingerprint != fingerprint;
+        if (changed) {
+                if (processEngine)
+                        ProcessTree_delete();
+                LogInfo("Global configuration changed -- all services reloaded\n");
+        } else {
+                int reused = _reuseServices(services);
+                LogInfo("%d services reloaded, %d services unchanged\n", Util_getNumberOfServices() - reused, reused);
+        }
+        gc_services(&services, &servicegroups);
+
+        Program_start();
+        Watch_start();
+        Pressure_start();
+
+        /* Resume the http interface, restart it if the global configuration changed */
+        monit_http(Httpd_Resume);
+        if (changed) {
+                monit_http(Httpd_Stop);
+                if (can_http())
+                        monit_http(Httpd_Start);
+        }
 
         /* send the monit startup notification */
         Event_post(Run.system, Event_Instance, State_Changed, Run.system->action_MONIT_START, "Monit reloaded");
@@ -403,6 +463,53 @@ static void do_reinit() {
 }
 
 
+/**
+ * Copy the service list links. The links are not exchanged with the service content
+ */
+static void _copyLinks(Service_T s, struct Service_T *links) {
+        s->visited = links->visited;
+        s->next = links->next;
+        s->next_conf = links->next_conf;
+        s->next_depend = links->next_depend;
+        s->next_hash = links->next_hash;
+}
+
+
+/**
+ * Reuse the services which were not changed by the reload. The content of the
+ * service object in the new service list is exchanged with the old service,
+ * so the configuration and runtime data (service check results, statistics and
+ * events) are preserved and the new service object stays linked from the
+ * service list, index, groups and Run.system. The replaced content is freed
+ * with the old service list. Running check programs are stopped
+ * @param old The old service list
+ * @return The number of reused services
+ */
+static int _reuseServices(Service_T old) {
+        int count = 0;
+        for (Service_T o = old; o; o = o->next) {
+                Service_T s = Util_getService(o->name);
+                if (s && s->type == o->type && s->fingerprint == o->fingerprint) {
+                        struct Service_T new = *s, current = *o;
+                        *s = current;
+                        _copyLinks(s, &new);
+                        *o = new;
+                        _copyLinks(o, &current);
+                        for (Event_T e = s->eventlist; e; e = e->next)
+                                e->source = s;
+                        if (s->program && s->program->P)
+                                Process_free(&(s->program->P));
+                        count++;
+                }
+        }
+        // The dependencies of the reused services point to the old service objects
+        for (Service_T s = servicelist; s; s = s->next)
+                for (Dependant_T d = s->dependantlist; d; d = d->next)
+                        d->service = Util_getService(d->dependant);
+        return count;
+}
+
+
 /**
  * Dispatch to the submitted action - actions are program arguments
  */
@@ -466,6 +573,9 @@ static void do_action(int argc, char **args) {
                 char *type = args[++optind];
                 if (! HttpClient_report(type))
                         exit(1);
+        } else if (IS(action, "runtime")) {
+                if (! HttpClient_runtime())
+                        exit(1);
         } else if (IS(action, "procmatch")) {
                 char *pattern = args[++optind];
                 if (! pattern) {
@@ -506,6 +616,10 @@ static void do_exit(bool saveState) {
                         heartbeatRunning = false;
                 }
 
+                Program_stop();
+                Watch_stop();
+                Pressure_stop();
+
                 LogInfo("Monit daemon with pid [%d] stopped\n", (int)getpid());
 
                 /* send the monit stop notification */
@@ -548,6 +662,14 @@ static void do_default() {
                 if (! (Run.flags & Run_Foreground))
                         daemonize();
 
+                /* Write the log asynchronously from now on */
+                log_start();
+
+                /* Wait for the check programs in the supervisor thread, watch files for changes and arm the pressure triggers */
+                Program_start();
+                Watch_start();
+                Pressure_start();
+
                 if (! file_createPidFile(Run.files.pid)) {
                         LogError("Monit daemon died\n");
                         exit(1);
@@ -586,9 +708,10 @@ static void do_default() {
                 while (true) {
                         validate();
 
-                        /* In the case that there is no pending action then sleep */
-                        if (! (Run.flags & Run_ActionPending) && ! interrupt())
-                                sleep(Run.polltime);
+                        /* In the case that there is no pending action then sleep. If a check program finishes or a watched file changes meanwhile, validate the service and continue sleeping */
+                        time_t wakeup = Time_now() + Run.polltime;
+                        for (time_t now = Time_now(); now < wakeup && ! (Run.flags & (Run_ActionPending | Run_DoWakeup)) && ! interrupt(); now = Time_now())
+                                _sleep((int)(wakeup - now));
 
                         if (Run.flags & Run_DoWakeup) {
                                 Run.flags &= ~Run_DoWakeup;
@@ -772,14 +895,14 @@ static void handle_options(int argc, char **argv) {
         switch (deferred_opt) {
                 case 't':
                 {
-                        do_init(); // Parses control file and initialize program, exit on error
+                        do_init(NULL); // Parses control file and initialize program, exit on error
                         printf("Control file syntax OK\n");
                         exit(0);
                         break;
                 }
                 case 'r':
                 {
-                        do_init();
+                        do_init(NULL);
                         assert(Run.id);
                         printf("Reset Monit Id? [y/N]> ");
                         if (tolower(getchar()) == 'y') {
@@ -792,7 +915,7 @@ static void handle_options(int argc, char **argv) {
                 }
                 case 'i':
                 {
-                        do_init();
+                        do_init(NULL);
                         assert(Run.id);
                         printf("Monit ID: %s\n", Run.id);
                         exit(0);
@@ -841,6 +964,7 @@ static void help() {
                " status [name]         - Print full status information for service(s)\n"
                " summary [name]        - Print short status information for service(s)\n"
                " report [up|down|..]   - Report state of services. See manual for options\n"
+               " runtime               - Print Monit check and cycle duration profile\n"
                " quit                  - Kill the monit daemon process\n"
                " validate              - Check all services and start if not running\n"
                " procmatch <pattern>   - Test process matching pattern\n",
@@ -929,3 +1053,27 @@ static RETSIGTYPE do_wakeup(int sig) {
 static void waitforchildren(void) {
         while (waitpid(-1, NULL, WNOHANG) > 0) ;
 }
+
+
+/**
+ * Sleep until the timeout expires, a signal is received, a check program
+ * finishes, a watched file changes or a pressure trigger fires. The finished
+ * programs, changed files and services under pressure are validated
+ * immediately
+ */
+static void _sleep(int timeout) {
+        struct pollfd fds[3] = {
+                {.fd = Program_getDescriptor(), .events = POLLIN},
+                {.fd = Watch_getDescriptor(), .events = POLLIN},
+                {.fd = Pressure_getDescriptor(), .events = POLLIN}
+        };
+        // The changed file is validated at most once per second, if some changes were deferred, wake up in one second
+        if (poll(fds, 3, (changesDeferred ? MIN(timeout, 1) : timeout) * 1000) >= 0) {
+                if (fds[0].revents)
+                        validate_programs();
+                if (fds[1].revents || changesDeferred)
+                        changesDeferred = validate_changed() > 0;
+                if (fds[2].revents)
+                        validate_pressure();
+        }
+}
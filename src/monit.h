@@ -109,6 +109,7 @@
 #include "Address.h"
 #include "net/Link.h"
 #include "statistics/Statistics.h"
+#include "statistics/Histogram.h"
 
 
 // libmonit
@@ -147,6 +148,13 @@
 
 #define START_DELAY        0
 
+/* The proc filesystem mount point. The benchmark build replaces it with a variable pointing to the recorded snapshot */
+#ifndef PROCFS
+#define PROCFS             "/proc"
+#else
+extern const char *PROCFS;
+#endif
+
 
 /* ------------------------------------------------------ Type definitions */
 
@@ -171,7 +179,8 @@ typedef enum {
         Run_Stopped              = 0x400,                          /**< Stop Monit */
         Run_DoReload             = 0x800,                        /**< Reload Monit */
         Run_DoWakeup             = 0x1000,                       /**< Wakeup Monit */
-        Run_Batch                = 0x2000                      /**< CLI batch mode */
+        Run_Batch                = 0x2000,                     /**< CLI batch mode */
+        Run_ConfigCache          = 0x4000              /**< Configuration cache enabled */
 } __attribute__((__packed__)) Run_Flags;
 
 
@@ -183,7 +192,9 @@ typedef enum {
 
 typedef enum {
         Httpd_Start = 1,
-        Httpd_Stop
+        Httpd_Stop,
+        Httpd_Suspend,
+        Httpd_Resume
 } __attribute__((__packed__)) Httpd_Action;
 
 
@@ -191,7 +202,8 @@ typedef enum {
         Every_Cycle = 0,
         Every_SkipCycles,
         Every_Cron,
-        Every_NotInCron
+        Every_NotInCron,
+        Every_Adaptive
 } __attribute__((__packed__)) Every_Type;
 
 
@@ -275,6 +287,13 @@ typedef enum {
 } __attribute__((__packed__)) Onreboot_Type;
 
 
+typedef enum {
+        Priority_Normal = 0,
+        Priority_High,
+        Priority_Low
+} __attribute__((__packed__)) Priority_Type;
+
+
 typedef enum {
         Monitor_Not     = 0x0,
         Monitor_Yes     = 0x1,
@@ -300,7 +319,8 @@ typedef enum {
         Service_Fifo,
         Service_Program,
         Service_Net,
-        Service_Last = Service_Net
+        Service_Cgroup,
+        Service_Last = Service_Cgroup
 } __attribute__((__packed__)) Service_Type;
 
 
@@ -329,7 +349,13 @@ typedef enum {
         Resource_ReadOperations,
         Resource_WriteBytes,
         Resource_WriteOperations,
-        Resource_ServiceTime
+        Resource_ServiceTime,
+        Resource_CpuPressure,
+        Resource_MemoryPressure,
+        Resource_IoPressure,
+        Resource_CpuCore,
+        Resource_CpuSteal,
+        Resource_CpuGuest
 } __attribute__((__packed__)) Resource_Type;
 
 
@@ -381,14 +407,20 @@ typedef enum {
 #define ICMP_MAXSIZE 1500
 #define ICMP_ATTEMPT_COUNT 3
 
+#define EVERY_ADAPTIVE_MAXIMUM 16  /**< Default maximum adaptive check interval [cycles] */
+
 
 /* Default limits */
 #define LIMIT_SENDEXPECTBUFFER  256
 #define LIMIT_FILECONTENTBUFFER 512
 #define LIMIT_PROGRAMOUTPUT     512
 #define LIMIT_HTTPCONTENTBUFFER 1048576
+#define LIMIT_HTTPCONTENTLIMIT  16777216
 #define LIMIT_NETWORKTIMEOUT    5000
 #define LIMIT_PROGRAMTIMEOUT    300000
+#define LIMIT_PROGRAMCONCURRENCY 0
+#define LIMIT_PROBECACHE        0
+#define LIMIT_CYCLEBUDGET       0
 #define LIMIT_STOPTIMEOUT       30000
 #define LIMIT_STARTTIMEOUT      30000
 #define LIMIT_RESTARTTIMEOUT    30000
@@ -440,10 +472,14 @@ typedef char MD_T[MD_SIZE];
 typedef struct Limits_T {
         uint32_t sendExpectBuffer;  /**< Maximum send/expect response length [B] */
         uint32_t fileContentBuffer;  /**< Maximum tested file content length [B] */
-        uint32_t httpContentBuffer;  /**< Maximum tested HTTP content length [B] */
+        uint32_t httpContentBuffer;  /**< HTTP content test window size [B] */
+        uint32_t httpContentLimit;   /**< Maximum HTTP response body length [B] */
         uint32_t programOutput;           /**< Program output truncate limit [B] */
         uint32_t networkTimeout;               /**< Default network timeout [ms] */
         uint32_t programTimeout;               /**< Default program timeout [ms] */
+        uint32_t programConcurrency; /**< Maximum running check programs (0 = unlimited) */
+        uint32_t probeCache;    /**< Connection test result cache TTL [ms] (0 = off) */
+        uint32_t cycleBudget;       /**< Validation cycle time budget [ms] (0 = off) */
         uint32_t stopTimeout;                     /**< Default stop timeout [ms] */
         uint32_t startTimeout;                   /**< Default start timeout [ms] */
         uint32_t restartTimeout;               /**< Default restart timeout [ms] */
@@ -561,6 +597,13 @@ typedef struct Auth_T {
 
 
 /** Defines data for systemwide statistic */
+/** Pressure stall information, the share of time in which some or all tasks were stalled [%], -1 if not available */
+typedef struct Pressure_T {
+        float some[3];                    /**< Some tasks stalled (avg10, avg60, avg300) */
+        float full[3];                     /**< All tasks stalled (avg10, avg60, avg300) */
+} *Pressure_T;
+
+
 typedef struct SystemInfo_T {
         struct {
                 int count;                                      /**< Number of CPUs */
@@ -568,7 +611,13 @@ typedef struct SystemInfo_T {
                         float user;         /**< Total CPU in use in user space [%] */
                         float system;     /**< Total CPU in use in kernel space [%] */
                         float wait;            /**< Total CPU in use in waiting [%] */
+                        float steal;    /**< Total CPU stolen by the hypervisor [%] */
+                        float guest;       /**< Total CPU running guest systems [%] */
                 } usage;
+                struct {
+                        int count;               /**< Number of cores in the usage array */
+                        float *usage;        /**< CPU usage per core [%], -1 if offline */
+                } core;
         } cpu;
         struct {
                 uint64_t size;                      /**< Maximal system real memory */
@@ -586,6 +635,11 @@ typedef struct SystemInfo_T {
         } swap;
         size_t argmax;                                                   /**< Program arguments maximum [B] */
         double loadavg[3];                                                         /**< Load average triple */
+        struct {
+                struct Pressure_T cpu;                                                 /**< CPU pressure */
+                struct Pressure_T memory;                                           /**< Memory pressure */
+                struct Pressure_T io;                                                   /**< I/O pressure */
+        } pressure;
         struct utsname uname;                                 /**< Platform information provided by uname() */
         struct timeval collected;                                             /**< When were data collected */
         uint64_t booted; /**< System boot time (seconds since UNIX epoch, using platform-agnostic uint64_t) */
@@ -598,6 +652,7 @@ typedef struct SystemInfo_T {
 typedef struct Protocol_T {
         const char *name;                                       /**< Protocol name */
         void (*check)(Socket_T);          /**< Protocol verification function */
+        void (*ping)(Socket_T);      /**< Liveness test on an open connection */
 } *Protocol_T;
 
 
@@ -617,6 +672,10 @@ typedef struct Outgoing_T {
 } Outgoing_T;
 
 
+/** Shared connection test result (see probe.h) */
+typedef struct Probe_T *Probe_T;
+
+
 /** Defines a port object */
 typedef struct Port_T {
         char *hostname;                                     /**< Hostname to check */
@@ -640,6 +699,10 @@ typedef struct Port_T {
         int retry;       /**< Number of connection retry before reporting an error */
         volatile int socket;                       /**< Socket used for connection */
         double response;                 /**< Socket connection response time [ms] */
+        double connect;     /**< Time to open the connection used by the test [ms] */
+        bool keepalive;            /**< Keep the connection open between the tests */
+        Socket_T connection;                  /**< The open connection (keepalive) */
+        Probe_T probe;           /**< Test result shared with identical port tests */
         Socket_Type type;           /**< Socket type used for connection (UDP/TCP) */
         Socket_Family family;    /**< Socket family used for connection (NET/UNIX) */
         Connection_State is_available;               /**< Server/port availability */
@@ -735,6 +798,7 @@ typedef struct Icmp_T {
 
 typedef struct Dependant_T {
         char *dependant;                            /**< name of dependant service */
+        struct Service_T *service;   /**< Dependant service, resolved on config load */
 
         /** For internal use */
         struct Dependant_T *next;             /**< next dependant service in chain */
@@ -746,6 +810,10 @@ typedef struct Resource_T {
         Resource_Type resource_id;                     /**< Which value is checked */
         Operator_Type operator;                           /**< Comparison operator */
         double limit;                                   /**< Limit of the resource */
+        struct {
+                bool full;          /**< Pressure of all tasks (full) or some tasks */
+                int window;      /**< Pressure average window (0=10s, 1=60s, 2=300s) */
+        } pressure;
         EventAction_T action;  /**< Description of the action upon event occurence */
 
         /** For internal use */
@@ -782,13 +850,18 @@ typedef struct ActionRate_T {
 /** Defines when to run a check for a service. This type suports both the old
  cycle based every statement and the new cron-format version */
 typedef struct Every_T {
-        Every_Type type; /**< 0 = not set, 1 = cycle, 2 = cron, 3 = negated cron */
+        Every_Type type; /**< 0 = not set, 1 = cycle, 2 = cron, 3 = negated cron, 4 = adaptive */
         time_t last_run;
         union {
                 struct {
                         int number; /**< Check this program at a given cycles */
                         int counter; /**< Counter for number. When counter == number, check */
                 } cycle; /**< Old cycle based every check */
+                struct {
+                        int interval; /**< Current check interval in cycles */
+                        int counter; /**< Cycles since the last check */
+                        int maximum; /**< Maximum check interval in cycles */
+                } adaptive; /**< Check interval adapted to the service state */
                 char *cron; /* A crontab format string */
         } spec;
 } Every_T;
@@ -814,6 +887,8 @@ typedef struct Program_T {
         int exitStatus;                 /**< Sub-process exit status for reporting */
         StringBuffer_T lastOutput;                        /**< Last program output */
         StringBuffer_T inprogressOutput; /**< Output of the pending program instance */
+        bool timedOut;            /**< The sub-process was killed after timeout */
+        bool finished;       /**< The sub-process exited and the output was read */
 } *Program_T;
 
 
@@ -1091,6 +1166,21 @@ typedef struct ProcessInfo_T {
         struct IOStatistics_T read;                       /**< Read statistics */
         struct IOStatistics_T write;                     /**< Write statistics */
         char secattr[STRLEN];                         /**< Security attributes */
+        struct {
+                pid_t pid;       /**< The process matching the pattern or -1 */
+                unsigned resolved;   /**< Process tree generation of the pid */
+                unsigned used;  /**< Process tree generation of the last lookup */
+        } match;
+        struct {
+                bool enabled;      /**< Process totals from the process cgroup */
+                uint64_t cpuTime;       /**< cgroup CPU time from last cycle */
+                uint64_t time;        /**< Time of the last cgroup sample [us] */
+        } cgroup;
+        struct {
+                struct Pressure_T cpu;                        /**< cgroup CPU pressure */
+                struct Pressure_T memory;                  /**< cgroup memory pressure */
+                struct Pressure_T io;                          /**< cgroup I/O pressure */
+        } pressure;
 } *ProcessInfo_T;
 
 
@@ -1123,14 +1213,30 @@ typedef struct Service_T {
         Monitor_State monitor;                             /**< Monitor state flag */
         Monitor_Mode mode;                    /**< Monitoring mode for the service */
         Onreboot_Type onreboot;                                /**< On reboot mode */
+        Priority_Type priority;          /**< Check order and cycle budget priority */
         Action_Type doaction;                 /**< Action scheduled by http thread */
         int  ncycle;                          /**< The number of the current cycle */
         int  nstart;           /**< The number of current starts with this service */
         Every_T every;              /**< Timespec for when to run check of service */
+        struct {
+                bool pending;        /**< The check was deferred in the previous cycle */
+                bool deferred;               /**< The check was deferred in this cycle */
+                uint64_t count;                       /**< Number of deferred checks */
+        } deferral;
         command_t start;                    /**< The start command for the service */
         command_t stop;                      /**< The stop command for the service */
         command_t restart;                /**< The restart command for the service */
         Program_T program;                            /**< Program execution check */
+        int watch;          /**< Path change notification watch, 0 if not watched */
+        bool changed;            /**< Path changed since the last check was notified */
+        dev_t watchDevice;                /**< Device of the watched path target */
+        ino_t watchInode;                  /**< Inode of the watched path target */
+        uint64_t fingerprint;   /**< Hash of the service configuration statements */
+        char *labels;   /**< OpenMetrics labels, built on the first metrics request */
+        struct {
+                struct Histogram_T wall;                /**< Check wall time [μs] */
+                struct Histogram_T cpu;                  /**< Check CPU time [μs] */
+        } profile;
 
         Dependant_T dependantlist;                     /**< Dependant service list */
         Mail_T maillist;                       /**< Alert notification mailinglist */
@@ -1202,6 +1308,11 @@ typedef struct Service_T {
                 /** For internal use */
                 struct myevent   *next;                         /**< next event in chain */
         } *eventlist;                                     /**< Pending events list */
+        struct {
+                int size;                         /**< Number of slots, power of 2 */
+                int count;                           /**< Number of indexed events */
+                struct myevent **table;     /**< Pending events by id and action */
+        } eventindex;
 
         /** Context specific parameters */
         char *path;  /**< Path to the filesys, file, directory or process pid file */
@@ -1211,6 +1322,7 @@ typedef struct Service_T {
         struct Service_T *next;                         /**< next service in chain */
         struct Service_T *next_conf;      /**< next service according to conf file */
         struct Service_T *next_depend;           /**< next depend service in chain */
+        struct Service_T *next_hash;          /**< next service in name index bucket */
 } *Service_T;
 
 
@@ -1251,6 +1363,7 @@ typedef struct Run_T {
         time_t incarnation;              /**< Unique ID for running monit instance */
         int  handler_queue[Handler_Max + 1];       /**< The handlers queue counter */
         Service_T system;                          /**< The general system service */
+        uint64_t fingerprint;     /**< Hash of the global configuration statements */
         char *eventlist_dir;                   /**< The event queue base directory */
 
         /** An object holding Monit HTTP interface setup */
@@ -1292,6 +1405,16 @@ typedef struct Run_T {
                 char *message;                            /**< The standard mail message */
         } MailFormat;
 
+        /** Monit self-instrumentation, all durations in microseconds */
+        struct {
+                struct Histogram_T cycle;              /**< Validation cycle duration */
+                struct Histogram_T overrun; /**< Cycle time past the budget or poll interval */
+                struct Histogram_T processtree;    /**< Process tree collection time */
+                struct Histogram_T event;                 /**< Event handling time */
+                struct Histogram_T notification; /**< Alert delivery latency since the event */
+                struct Histogram_T check[Service_Last + 1]; /**< Check time per service type */
+        } profile;
+
         Mutex_T mutex;            /**< Mutex used for service data synchronization */
 } Run_T;
 
@@ -1310,6 +1433,7 @@ extern SystemInfo_T   systeminfo;
 extern char *actionnames[];
 extern char *modenames[];
 extern char *onrebootnames[];
+extern char *prioritynames[];
 extern char *checksumnames[];
 extern char *operatornames[];
 extern char *operatorshortnames[];
@@ -1320,6 +1444,7 @@ extern char *sslnames[];
 extern char *socketnames[];
 extern char *timestampnames[];
 extern char *httpmethod[];
+extern char *pressurewindownames[];
 
 
 /* ------------------------------------------------------- Public prototypes */
@@ -1339,6 +1464,8 @@ bool control_service(const char *, Action_Type);
 bool control_service_string(List_T, const char *);
 void  daemonize(void);
 void  gc(void);
+void  gc_config(void);
+void  gc_services(Service_T *, ServiceGroup_T *);
 void  gc_mail_list(Mail_T *);
 void  gccmd(command_t *);
 void  gc_event(Event_T *e);
@@ -1350,6 +1477,7 @@ void  monit_http(Httpd_Action);
 bool can_http(void);
 void set_signal_block(void);
 void status_xml(StringBuffer_T, Event_T, int, const char *);
+int  status_json(StringBuffer_T, const char *, const char *, const char *);
 bool  do_wakeupcall(void);
 bool interrupt(void);
 
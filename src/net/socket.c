@@ -72,6 +72,10 @@
 #include <netdb.h>
 #endif
 
+#ifdef HAVE_SYS_UIO_H
+#include <sys/uio.h>
+#endif
+
 #include "net.h"
 #include "monit.h"
 #include "socket.h"
@@ -102,8 +106,13 @@ typedef enum {
 } __attribute__((__packed__)) Connection_Type;
 
 
-// One TCP frame data size
-#define RBUFFER_SIZE 1460
+// The read buffer starts small, as most checks read a short response, and doubles each time a read fills it, up to the maximum
+#define RBUFFER_INITIAL 4096
+#define RBUFFER_MAX     65536
+
+
+// The output buffer of a corked socket, the maximum TLS record payload
+#define WBUFFER_SIZE 16384
 
 
 #define T Socket_T
@@ -116,13 +125,18 @@ struct T {
         int timeout; // milliseconds
         int length;
         int offset;
+        int capacity;
+        bool saturated; // The last read filled the whole buffer
+        bool corked;    // Writes are collected in the output buffer
+        int wlength;
         char *host;
         Port_T Port;
 #ifdef HAVE_OPENSSL
         Ssl_T ssl;
         SslServer_T sslserver;
 #endif
-        unsigned char buffer[RBUFFER_SIZE + 1];
+        unsigned char *buffer;
+        unsigned char *wbuffer;
 };
 
 
@@ -130,34 +144,174 @@ struct T {
 
 
 /*
- * Fill the internal buffer. If an error occurs or if the read
- * operation timed out -1 is returned.
+ * Write the data to the socket.
  * @param S A Socket object
+ * @param b The data
+ * @param size The data size
+ * @return the length of data written or -1 if an error occurred
+ */
+static int _write(T S, const void *b, size_t size) {
+        ssize_t n = 0;
+        const unsigned char *p = b;
+        while (size > 0) {
+#ifdef HAVE_OPENSSL
+                if (S->ssl) {
+                        n = Ssl_write(S->ssl, (void *)p, (int)size, S->timeout);
+                } else {
+#endif
+                        n = Net_write(S->socket, p, size, S->timeout);
+#ifdef HAVE_OPENSSL
+                }
+#endif
+                if (n <= 0)
+                        break;
+                p += n;
+                size -= n;
+        }
+        if (n < 0) {
+                /* No write or a partial write is an error */
+                return -1;
+        }
+        return (int)(p - (const unsigned char *)b);
+}
+
+
+/*
+ * Write the data vectors to the plain socket with as few system calls as
+ * possible.
+ * @param S A Socket object
+ * @param iov The data vectors, modified on partial write
+ * @param count The number of vectors
+ * @return the length of data written or -1 if an error occurred
+ */
+static int _writev(T S, struct iovec *iov, int count) {
+        int total = 0;
+        while (count > 0) {
+                ssize_t n;
+                do {
+                        n = writev(S->socket, iov, count);
+                } while (n == -1 && errno == EINTR);
+                if (n == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+                        if (Net_canWrite(S->socket, S->timeout))
+                                continue;
+                        break; // Timeout
+                } else if (n < 0) {
+                        return -1;
+                }
+                total += n;
+                for (; count > 0 && (size_t)n >= iov->iov_len; count--, iov++)
+                        n -= iov->iov_len;
+                if (count > 0) {
+                        iov->iov_base = (unsigned char *)iov->iov_base + n;
+                        iov->iov_len -= n;
+                }
+        }
+        return total;
+}
+
+
+/*
+ * Write the output buffer of the corked socket followed by the given data.
+ * A plain socket writes both with one writev call, a TLS connection sends
+ * the data in full records.
+ * @param S A Socket object
+ * @param b The data to write after the buffered output (may be NULL)
+ * @param size The data size
+ * @return 0 if all data were written or -1 if an error occurred
+ */
+static int _flush(T S, const void *b, size_t size) {
+#ifdef HAVE_OPENSSL
+        if (S->ssl) {
+                const unsigned char *p = b;
+                do {
+                        size_t n = MIN(size, (size_t)(WBUFFER_SIZE - S->wlength));
+                        if (n > 0) {
+                                memcpy(S->wbuffer + S->wlength, p, n);
+                                S->wlength += n;
+                                p += n;
+                                size -= n;
+                        }
+                        int length = S->wlength;
+                        S->wlength = 0;
+                        if (length > 0 && _write(S, S->wbuffer, length) != length)
+                                return -1;
+                } while (size > 0);
+                return 0;
+        }
+#endif
+        struct iovec iov[2] = {{S->wbuffer, S->wlength}, {(void *)b, size}};
+        size_t total = S->wlength + size;
+        S->wlength = 0;
+        return _writev(S, iov, 2) == (int)total ? 0 : -1;
+}
+
+
+/*
+ * Read the data from the socket to the given buffer.
+ * @param S A Socket object
+ * @param b The buffer
+ * @param size The buffer size
  * @param timeout The number of milliseconds to wait for data to be read
- * @return the length of data read or -1 if an error occurred
+ * @return the length of data read, 0 if the read operation timed out or
+ * -1 if an error occurred or the peer closed the connection
  */
-static int _fill(T S, int timeout) {
-        S->offset = 0;
-        S->length = 0;
-        if (S->type == Socket_Udp)
-                timeout = 500;
+static int _read(T S, void *b, int size, int timeout) {
+        // Send the pending output first, the peer may wait for it before responding
+        if (S->wlength > 0 && _flush(S, NULL, 0) < 0)
+                return -1;
         int n;
 #ifdef HAVE_OPENSSL
         if (S->ssl)
-                n = Ssl_read(S->ssl, S->buffer + S->length, RBUFFER_SIZE - S->length, timeout);
+                n = Ssl_read(S->ssl, b, size, timeout);
         else
 #endif
-                n = (int)Net_read(S->socket, S->buffer + S->length,  RBUFFER_SIZE - S->length, timeout);
-        if (n > 0)
-                S->length += n;
-        else if (n < 0)
+                n = (int)Net_read(S->socket, b, size, timeout);
+        if (n < 0)
                 return -1;
-        else if (! (errno == EAGAIN || errno == EWOULDBLOCK)) // Peer closed connection
+        else if (n == 0 && ! (errno == EAGAIN || errno == EWOULDBLOCK)) // Peer closed connection
                 return -1;
         return n;
 }
 
 
+/*
+ * Fill the internal buffer. The unread data are moved to the beginning of
+ * the buffer and the new data are appended. The buffer grows if it is full
+ * or if the previous read filled it completely.
+ * @param S A Socket object
+ * @param timeout The number of milliseconds to wait for data to be read
+ * @return the length of data read, 0 if the read operation timed out or
+ * the buffer is full or -1 if an error occurred
+ */
+static int _fill(T S, int timeout) {
+        if (S->offset > 0) {
+                S->length -= S->offset;
+                if (S->length > 0)
+                        memmove(S->buffer, S->buffer + S->offset, S->length);
+                S->offset = 0;
+        }
+        if (S->type == Socket_Udp) {
+                // The datagram must be read at once, the excess data would be discarded
+                timeout = 500;
+                if (! S->capacity)
+                        S->capacity = RBUFFER_MAX;
+        } else if (! S->capacity) {
+                S->capacity = RBUFFER_INITIAL;
+        } else if ((S->length == S->capacity || S->saturated) && S->capacity < RBUFFER_MAX) {
+                S->capacity = MIN(S->capacity * 2, RBUFFER_MAX);
+        }
+        RESIZE(S->buffer, S->capacity);
+        if (S->length == S->capacity)
+                return 0; // Nothing was consumed from the full buffer
+        int n = _read(S, S->buffer + S->length, S->capacity - S->length, timeout);
+        if (n > 0) {
+                S->saturated = n == S->capacity - S->length;
+                S->length += n;
+        }
+        return n;
+}
+
+
 int _getPort(const struct sockaddr *addr) {
         if (addr->sa_family == AF_INET)
                 return ntohs(((struct sockaddr_in *)addr)->sin_port);
@@ -467,6 +621,8 @@ void Socket_free(T *S) {
                 Net_shutdown((*S)->socket, SHUT_RDWR);
                 Net_close((*S)->socket);
         }
+        FREE((*S)->buffer);
+        FREE((*S)->wbuffer);
         FREE((*S)->host);
         FREE(*S);
 }
@@ -555,17 +711,56 @@ const char *Socket_getLocalHost(T S, char *host, int hostlen) {
 }
 
 
+/**
+ * Test the connection kept open from the previous cycle using the protocol
+ * ping. Unread data or readable socket means that the peer closed the
+ * connection or sent something unexpected. TLS may deliver records on an
+ * idle connection, so for SSL we rely on the ping only. If the test failed,
+ * the connection is dropped and the caller opens a new one
+ */
+static bool _ping(Port_T p) {
+        volatile bool ok = false;
+        T S = p->connection;
+        if (S->offset == S->length && (
+#ifdef HAVE_OPENSSL
+            S->ssl ||
+#endif
+            ! Net_canRead(S->socket, 0))) {
+                TRY
+                {
+                        p->protocol->ping(S);
+                        ok = true;
+                }
+                ELSE
+                {
+                        DEBUG("Persistent connection test failed -- %s, reconnecting\n", Exception_frame.message);
+                }
+                END_TRY;
+        }
+        if (! ok)
+                Socket_free(&(p->connection));
+        return ok;
+}
+
+
 static void _testUnix(Port_T p) {
-        T S = Socket_createUnix(p->target.unix.pathname, p->type, p->timeout);
+        int64_t start = Time_micro();
+        volatile T S = Socket_createUnix(p->target.unix.pathname, p->type, p->timeout);
+        p->connect = (double)(Time_micro() - start) / 1000.;
         if (S) {
                 S->Port = p;
                 TRY
                 {
                         p->protocol->check(S);
+                        if (p->keepalive) {
+                                p->connection = S;
+                                S = NULL;
+                        }
                 }
                 FINALLY
                 {
-                        Socket_free(&S);
+                        if (S)
+                                Socket_free((Socket_T *)&S);
                 }
                 END_TRY;
         } else {
@@ -586,7 +781,9 @@ static void _testIp(Port_T p) {
                                 volatile T S = NULL;
                                 TRY
                                 {
+                                        int64_t start = Time_micro();
                                         S = _createIpSocket(p->hostname, r->ai_addr, r->ai_addrlen, localaddr, p->outgoing.addrlen, r->ai_family, r->ai_socktype, r->ai_protocol, &(p->target.net.ssl.options), p->timeout);
+                                        p->connect = (double)(Time_micro() - start) / 1000.;
                                         S->Port = p;
                                         TRY
                                         {
@@ -602,6 +799,10 @@ static void _testIp(Port_T p) {
                                         }
                                         END_TRY;
                                         is_available = Connection_Ok;
+                                        if (p->keepalive) {
+                                                p->connection = S;
+                                                S = NULL;
+                                        }
 
                                 }
                                 ELSE
@@ -638,26 +839,33 @@ void Socket_test(void *P) {
         TRY
         {
                 int64_t start = Time_micro();
-                switch (p->family) {
-                        case Socket_Unix:
-                                _testUnix(p);
-                                break;
-                        case Socket_Ip:
-                        case Socket_Ip4:
-                        case Socket_Ip6:
-                                _testIp(p);
-                                break;
-                        default:
-                                THROW(IOException, "Invalid socket family %d\n", p->family);
-                                break;
+                if (p->connection && _ping(p)) {
+                        p->connect = 0.;
+                } else {
+                        switch (p->family) {
+                                case Socket_Unix:
+                                        _testUnix(p);
+                                        break;
+                                case Socket_Ip:
+                                case Socket_Ip4:
+                                case Socket_Ip6:
+                                        _testIp(p);
+                                        break;
+                                default:
+                                        THROW(IOException, "Invalid socket family %d\n", p->family);
+                                        break;
+                        }
                 }
                 p->response = (double)(Time_micro() - start) / 1000.; // Convert microseconds to milliseconds
+                if (p->keepalive)
+                        p->response -= p->connect; // Report the protocol command latency, the connection setup is reported separately
                 p->is_available = Connection_Ok;
         }
         ELSE
         {
                 p->is_available = Connection_Failed;
                 p->response = -1.;
+                p->connect = -1.;
                 RETHROW;
         }
         END_TRY;
@@ -674,45 +882,70 @@ void Socket_enableSsl(T S, SslOptions_T options, const char *name)  {
 
 
 int Socket_print(T S, const char *m, ...) {
-        int n;
-        va_list ap;
-        char *buf = NULL;
         ASSERT(S);
         ASSERT(m);
+        int n;
+        va_list ap;
+        if (S->corked) {
+                // Format the text directly to the output buffer if it fits
+                int room = WBUFFER_SIZE - S->wlength;
+                va_start(ap, m);
+                n = vsnprintf((char *)S->wbuffer + S->wlength, room, m, ap);
+                va_end(ap);
+                if (n >= 0 && n < room) {
+                        S->wlength += n;
+                        return n;
+                }
+        }
+        char buf[1024];
+        va_start(ap, m);
+        n = vsnprintf(buf, sizeof(buf), m, ap);
+        va_end(ap);
+        if (n < 0)
+                return -1;
+        if (n < (int)sizeof(buf))
+                return Socket_write(S, buf, n);
         va_start(ap, m);
-        buf = Str_vcat(m, ap);
+        char *s = Str_vcat(m, ap);
         va_end(ap);
-        n = Socket_write(S, buf, strlen(buf));
-        FREE(buf);
+        n = Socket_write(S, s, strlen(s));
+        FREE(s);
         return n;
 }
 
 
 int Socket_write(T S, void *b, size_t size) {
-        ssize_t n = 0;
-        void *p = b;
         ASSERT(S);
-        while (size > 0) {
-#ifdef HAVE_OPENSSL
-                if (S->ssl) {
-                        n = Ssl_write(S->ssl, p, (int)size, S->timeout);
-                } else {
-#endif
-                        n = Net_write(S->socket, p, size, S->timeout);
-#ifdef HAVE_OPENSSL
+        if (S->corked) {
+                if (S->wlength + size <= WBUFFER_SIZE) {
+                        memcpy(S->wbuffer + S->wlength, b, size);
+                        S->wlength += size;
+                } else if (_flush(S, b, size) < 0) {
+                        return -1;
                 }
-#endif
-                if (n <= 0)
-                        break;
-                p += n;
-                size -= n;
-
+                return (int)size;
         }
-        if (n < 0) {
-                /* No write or a partial write is an error */
-                return -1;
+        return _write(S, b, size);
+}
+
+
+void Socket_cork(T S) {
+        ASSERT(S);
+        if (! S->wbuffer)
+                S->wbuffer = ALLOC(WBUFFER_SIZE);
+        S->corked = true;
+}
+
+
+int Socket_uncork(T S) {
+        ASSERT(S);
+        int rv = 0;
+        if (S->corked) {
+                S->corked = false;
+                if (S->wlength > 0)
+                        rv = _flush(S, NULL, 0);
         }
-        return  (int)(p - b);
+        return rv;
 }
 
 
@@ -726,22 +959,59 @@ int Socket_readByte(T S) {
 
 
 int Socket_read(T S, void *b, int size) {
-        int c;
-        unsigned char *p = b;
         ASSERT(S);
-        while ((size-- > 0) && ((c = Socket_readByte(S)) >= 0))
-                *p++ = c;
-        return (int)((long)p - (long)b);
+        unsigned char *p = b;
+        while (size > 0) {
+                int n = S->length - S->offset;
+                if (n <= 0) {
+                        if (size >= S->capacity && S->capacity && S->type != Socket_Udp) {
+                                // The buffer is empty and the request is larger than the buffer => read directly to the caller's buffer
+                                if ((n = _read(S, p, size, S->timeout)) <= 0)
+                                        break;
+                                p += n;
+                                size -= n;
+                                continue;
+                        }
+                        if ((n = _fill(S, S->timeout)) <= 0)
+                                break;
+                }
+                n = MIN(n, size);
+                memcpy(p, S->buffer + S->offset, n);
+                S->offset += n;
+                p += n;
+                size -= n;
+        }
+        return (int)(p - (unsigned char *)b);
 }
 
 
 char *Socket_readLine(T S, char *s, int size) {
-        int c;
-        unsigned char *p = (unsigned char *)s;
         ASSERT(S);
-        while (--size && ((c = Socket_readByte(S)) > 0)) { // Stop when \0 is read
-                *p++ = c;
-                if (c == '\n')
+        ASSERT(s);
+        char *p = s;
+        for (int room = size - 1; room > 0;) {
+                if (S->offset >= S->length)
+                        if (_fill(S, S->timeout) <= 0)
+                                break;
+                unsigned char *start = S->buffer + S->offset;
+                int n = MIN(S->length - S->offset, room);
+                unsigned char *newline = memchr(start, '\n', n);
+                if (newline)
+                        n = (int)(newline - start) + 1;
+                unsigned char *zero = memchr(start, 0, n);
+                if (zero) {
+                        // Stop when \0 is read
+                        n = (int)(zero - start);
+                        memcpy(p, start, n);
+                        p += n;
+                        S->offset += n + 1;
+                        break;
+                }
+                memcpy(p, start, n);
+                p += n;
+                S->offset += n;
+                room -= n;
+                if (newline)
                         break;
         }
         *p = 0;
@@ -750,3 +1020,26 @@ char *Socket_readLine(T S, char *s, int size) {
         return NULL;
 }
 
+
+int Socket_peek(T S, int size, const void **data) {
+        ASSERT(S);
+        ASSERT(data);
+        if (size > RBUFFER_MAX)
+                size = RBUFFER_MAX;
+        while (S->length - S->offset < size) {
+                if (size > S->capacity)
+                        S->saturated = true; // Grow the buffer, so the requested data fit
+                if (_fill(S, S->timeout) <= 0)
+                        break;
+        }
+        *data = S->buffer + S->offset;
+        int n = S->length - S->offset;
+        return n > 0 ? n : -1;
+}
+
+
+void Socket_consume(T S, int size) {
+        ASSERT(S);
+        ASSERT(size >= 0 && size <= S->length - S->offset);
+        S->offset += size;
+}
@@ -205,7 +205,9 @@ const char *Socket_getLocalHost(T S, char *host, int hostlen);
 
 
 /**
- * Test a Port_T object
+ * Test a Port_T object. If the port has keepalive enabled, the connection
+ * is kept open after a successful test and the next test runs the protocol
+ * ping on it; if that fails, a new connection is opened and fully tested
  * @param P A port object to test
  * @exception IOException if test failed
  */
@@ -224,7 +226,8 @@ void Socket_enableSsl(T S, SslOptions_T options, const char *name);
 
 /**
  * Writes a character string. Use this function to send text based
- * messages to a client.
+ * messages to a client. If the socket is corked, the text is formatted
+ * directly to the output buffer.
  * @param S A Socket_T object
  * @param m A String to send to the client
  * @return The bytes sent or -1 if an error occurred
@@ -233,7 +236,9 @@ int Socket_print(T S, const char *m, ...) __attribute__((format (printf, 2, 3)))
 
 
 /**
- * Write size bytes from the buffer b.
+ * Write size bytes from the buffer b. If the socket is corked, the data
+ * are collected in the output buffer and sent together with the buffered
+ * output when the buffer is full.
  * @param S A Socket_T object
  * @param b The data to be written
  * @param size The size of the data in b
@@ -242,6 +247,27 @@ int Socket_print(T S, const char *m, ...) __attribute__((format (printf, 2, 3)))
 int Socket_write(T S, void *b, size_t size);
 
 
+/**
+ * Cork the socket: the data written by Socket_print() and Socket_write()
+ * are collected in an output buffer instead of being sent at once. When
+ * the buffer is full, its content is sent together with the data which
+ * did not fit in one writev(2) call or in full TLS records. Use this to
+ * send a message assembled from several writes, such as HTTP headers and
+ * body, with as few system calls and TLS records as possible. The pending
+ * output is sent before the socket is read.
+ * @param S A Socket_T object
+ */
+void Socket_cork(T S);
+
+
+/**
+ * Send the pending output and stop collecting written data
+ * @param S A Socket_T object
+ * @return 0 if the pending output was sent or -1 if an error occurred
+ */
+int Socket_uncork(T S);
+
+
 /**
  * Read a single byte. The byte is returned as an int in the range 0
  * to 255.
@@ -253,6 +279,8 @@ int Socket_readByte(T S);
 
 /**
  * Reads size bytes and stores them into the byte buffer pointed to by b.
+ * The buffered data are copied first, if the buffer is empty and the
+ * request is larger than the buffer, the data are read directly to b.
  * @param S A Socket_T object
  * @param b A Byte buffer
  * @param size The size of the buffer b
@@ -275,6 +303,39 @@ int Socket_read(T S, void *b, int size);
 char *Socket_readLine(T S, char *s, int size);
 
 
+/**
+ * Get a view of the buffered input data without consuming it. If less
+ * than size bytes are buffered, the data are read from the socket until
+ * size bytes are available, the read times out or the connection is
+ * closed. Use Socket_consume() to remove the processed data from the
+ * buffer. The view is valid until the next read operation on the socket.
+ * Example:
+ * <pre>
+ * const void *data;
+ * int n = Socket_peek(S, 1, &data);
+ * if (n > 0) {
+ *      process(data, n);
+ *      Socket_consume(S, n);
+ * }
+ * </pre>
+ * @param S A Socket_T object
+ * @param size The number of bytes wanted (at most 64kB)
+ * @param data Set to the buffered data
+ * @return The number of bytes available at data, which can be less or
+ * more than size, or -1 if no data are available
+ */
+int Socket_peek(T S, int size, const void **data);
+
+
+/**
+ * Consume size bytes of the buffered input data returned by Socket_peek()
+ * @param S A Socket_T object
+ * @param size The number of bytes to consume, at most the number of bytes
+ * returned by Socket_peek()
+ */
+void Socket_consume(T S, int size);
+
+
 #undef T
 #endif
 
@@ -79,6 +79,7 @@ static bool _send(Socket_T socket, Mmonit_T C, StringBuffer_T sb) {
                 body = StringBuffer_toString(sb);
                 bodyLength = StringBuffer_length(sb);
         }
+        Socket_cork(socket); // Send the headers and the body together
         int rv = Socket_print(socket,
                               "POST %s HTTP/1.1\r\n"
                               "Host: %s%s%s:%d\r\n"
@@ -97,7 +98,7 @@ static bool _send(Socket_T socket, Mmonit_T C, StringBuffer_T sb) {
                               C->compress == MmonitCompress_Yes ? "Content-Encoding: gzip\r\n" : "",
                               auth ? auth : "");
         FREE(auth);
-        if (rv < 0 || Socket_write(socket, (unsigned char *)body, bodyLength) < 0) {
+        if (rv < 0 || Socket_write(socket, (unsigned char *)body, bodyLength) < 0 || Socket_uncork(socket) < 0) {
                 LogError("M/Monit: error sending data to %s -- %s\n", C->url->url, STRERROR);
                 return false;
         }
@@ -126,6 +126,8 @@
 #include "device.h"
 #include "processor.h"
 #include "validate.h"
+#include "configcache.h"
+#include "probe.h"
 
 // libmonit
 #include "io/File.h"
@@ -147,11 +149,19 @@ struct rate_t {
         unsigned cycles;
 };
 
+/* Configuration fingerprint (64-bit FNV-1a hash of the statement tokens) */
+#define FINGERPRINT_SEED  0xcbf29ce484222325ULL
+#define FINGERPRINT_PRIME 0x100000001b3ULL
+
 /* yacc interface */
 void  yyerror(const char *,...);
 void  yyerror2(const char *,...);
 void  yywarning(const char *,...);
 void  yywarning2(const char *,...);
+void  fingerprint(const char *, int);
+void  fingerprintservice(void);
+void  fingerprintglobal(void);
+static void fingerprintcommit(void);
 
 /* lexer interface */
 int yylex(void);
@@ -166,6 +176,14 @@ extern int buffer_stack_ptr;
 
 /* Local variables */
 static int cfg_errflag = 0;
+static struct {
+        bool service;        /**< true if the tokens belong to a service statement */
+        bool pending;       /**< true if the last token was not added to a statement */
+        uint64_t token;                              /**< Hash of the last token */
+        int count;                         /**< Number of service fingerprints */
+        int size;                    /**< Allocated number of service fingerprints */
+        uint64_t *hash;   /**< Service fingerprints in the order of definition */
+} cfg_fingerprint = {};
 static Service_T tail = NULL;
 static Service_T current = NULL;
 static Request_T urlrequest = NULL;
@@ -322,11 +340,11 @@ static void addsecurityattribute(char *, Action_Type, Action_Type);
 %token PEMFILE ENABLE DISABLE SSL CIPHER CLIENTPEMFILE ALLOWSELFCERTIFICATION SELFSIGNED VERIFY CERTIFICATE CACERTIFICATEFILE CACERTIFICATEPATH VALID
 %token INTERFACE LINK PACKET BYTEIN BYTEOUT PACKETIN PACKETOUT SPEED SATURATION UPLOAD DOWNLOAD TOTAL
 %token IDFILE STATEFILE SEND EXPECT CYCLE COUNT REMINDER REPEAT
-%token LIMITS SENDEXPECTBUFFER EXPECTBUFFER FILECONTENTBUFFER HTTPCONTENTBUFFER PROGRAMOUTPUT NETWORKTIMEOUT PROGRAMTIMEOUT STARTTIMEOUT STOPTIMEOUT RESTARTTIMEOUT
+%token LIMITS SENDEXPECTBUFFER EXPECTBUFFER FILECONTENTBUFFER HTTPCONTENTBUFFER HTTPCONTENTLIMIT PROGRAMOUTPUT NETWORKTIMEOUT PROGRAMTIMEOUT PROGRAMCONCURRENCY PROBECACHE CYCLEBUDGET STARTTIMEOUT STOPTIMEOUT RESTARTTIMEOUT
 %token PIDFILE START STOP PATHTOK
 %token HOST HOSTNAME PORT IPV4 IPV6 TYPE UDP TCP TCPSSL PROTOCOL CONNECTION
 %token ALERT NOALERT MAILFORMAT UNIXSOCKET SIGNATURE
-%token TIMEOUT RETRY RESTART CHECKSUM EVERY NOTEVERY
+%token TIMEOUT RETRY KEEPALIVE RESTART CHECKSUM EVERY NOTEVERY ADAPTIVE
 %token DEFAULT HTTP HTTPS APACHESTATUS FTP SMTP SMTPS POP POPS IMAP IMAPS CLAMAV NNTP NTP3 MYSQL DNS WEBSOCKET
 %token SSH DWP LDAP2 LDAP3 RDATE RSYNC TNS PGSQL POSTFIXPOLICY SIP LMTP GPS RADIUS MEMCACHE REDIS MONGODB SIEVE SPAMASSASSIN FAIL2BAN
 %token <string> STRING PATH MAILADDR MAILFROM MAILREPLYTO MAILSUBJECT
@@ -335,10 +353,11 @@ static void addsecurityattribute(char *, Action_Type, Action_Type);
 %token <number> REPLYLIMIT REQUESTLIMIT STARTLIMIT WAITLIMIT GRACEFULLIMIT
 %token <number> CLEANUPLIMIT
 %token <real> REAL
-%token CHECKPROC CHECKFILESYS CHECKFILE CHECKDIR CHECKHOST CHECKSYSTEM CHECKFIFO CHECKPROGRAM CHECKNET
+%token CHECKPROC CHECKFILESYS CHECKFILE CHECKDIR CHECKHOST CHECKSYSTEM CHECKFIFO CHECKPROGRAM CHECKNET CHECKCGROUP
 %token THREADS CHILDREN METHOD GET HEAD STATUS ORIGIN VERSIONOPT READ WRITE OPERATION SERVICETIME DISK
 %token RESOURCE MEMORY TOTALMEMORY LOADAVG1 LOADAVG5 LOADAVG15 SWAP
-%token MODE ACTIVE PASSIVE MANUAL ONREBOOT NOSTART LASTSTATE CPU TOTALCPU CPUUSER CPUSYSTEM CPUWAIT
+%token MODE ACTIVE PASSIVE MANUAL ONREBOOT NOSTART LASTSTATE PRIORITY PRIORITYHIGH PRIORITYNORMAL PRIORITYLOW CPU TOTALCPU CPUUSER CPUSYSTEM CPUWAIT
+%token CPUSTEAL CPUGUEST CPUCORE CPUPRESSURE MEMORYPRESSURE IOPRESSURE SOME FULL AVG10 AVG60 AVG300
 %token GROUP REQUEST DEPENDS BASEDIR SLOT EVENTQUEUE SECRET HOSTHEADER
 %token UID EUID GID MMONIT INSTANCE USERNAME PASSWORD
 %token TIME ATIME CTIME MTIME CHANGED MILLISECOND SECOND MINUTE HOUR DAY MONTH
@@ -352,8 +371,8 @@ static void addsecurityattribute(char *, Action_Type, Action_Type);
 %token <address> ADDRESSOBJECT
 %token <string> TARGET TIMESPEC HTTPHEADER
 %token <number> MAXFORWARD
-%token FIPS
-%token SECURITY ATTRIBUTE
+%token FIPS CONFIGCACHE
+%token SECURITY ATTRIBUTE CGROUP
 
 %left GREATER GREATEROREQUAL LESS LESSOREQUAL EQUAL NOTEQUAL
 
@@ -385,6 +404,7 @@ statement       : setalert
                 | setlimits
                 | setonreboot
                 | setfips
+                | setconfigcache
                 | checkproc optproclist
                 | checkfile optfilelist
                 | checkfilesys optfilesyslist
@@ -394,6 +414,7 @@ statement       : setalert
                 | checkfifo optfifolist
                 | checkprogram optprogramlist
                 | checknet optnetlist
+                | checkcgroup optcgrouplist
                 ;
 
 optproclist     : /* EMPTY */
@@ -419,9 +440,11 @@ optproc         : start
                 | every
                 | mode
                 | onreboot
+                | priority
                 | group
                 | depend
                 | resourceprocess
+                | cgroupaccounting
                 ;
 
 optfilelist      : /* EMPTY */
@@ -444,6 +467,7 @@ optfile         : start
                 | match
                 | mode
                 | onreboot
+                | priority
                 | group
                 | depend
                 ;
@@ -464,6 +488,7 @@ optfilesys      : start
                 | gid
                 | mode
                 | onreboot
+                | priority
                 | group
                 | depend
                 | inode
@@ -491,6 +516,7 @@ optdir          : start
                 | gid
                 | mode
                 | onreboot
+                | priority
                 | group
                 | depend
                 ;
@@ -510,6 +536,7 @@ opthost         : start
                 | every
                 | mode
                 | onreboot
+                | priority
                 | group
                 | depend
                 ;
@@ -530,11 +557,31 @@ optnet          : start
                 | every
                 | mode
                 | onreboot
+                | priority
                 | alert
                 | group
                 | depend
                 ;
 
+optcgrouplist   : /* EMPTY */
+                | optcgrouplist optcgroup
+                ;
+
+optcgroup       : start
+                | stop
+                | restart
+                | exist
+                | actionrate
+                | alert
+                | every
+                | mode
+                | onreboot
+                | priority
+                | group
+                | depend
+                | resourceprocess
+                ;
+
 optsystemlist   : /* EMPTY */
                 | optsystemlist optsystem
                 ;
@@ -547,6 +594,7 @@ optsystem       : start
                 | every
                 | mode
                 | onreboot
+                | priority
                 | group
                 | depend
                 | resourcesystem
@@ -570,6 +618,7 @@ optfifo         : start
                 | gid
                 | mode
                 | onreboot
+                | priority
                 | group
                 | depend
                 ;
@@ -586,6 +635,7 @@ optprogram      : start
                 | every
                 | mode
                 | onreboot
+                | priority
                 | group
                 | depend
                 | statusvalue
@@ -665,6 +715,9 @@ limit           : SENDEXPECTBUFFER ':' NUMBER unit {
                 | HTTPCONTENTBUFFER ':' NUMBER unit {
                         Run.limits.httpContentBuffer = $3 * $<number>4;
                   }
+                | HTTPCONTENTLIMIT ':' NUMBER unit {
+                        Run.limits.httpContentLimit = $3 * $<number>4;
+                  }
                 | PROGRAMOUTPUT ':' NUMBER unit {
                         Run.limits.programOutput = $3 * $<number>4;
                   }
@@ -680,6 +733,21 @@ limit           : SENDEXPECTBUFFER ':' NUMBER unit {
                 | PROGRAMTIMEOUT ':' NUMBER SECOND {
                         Run.limits.programTimeout = $3 * 1000;
                   }
+                | PROGRAMCONCURRENCY ':' NUMBER {
+                        Run.limits.programConcurrency = $3;
+                  }
+                | PROBECACHE ':' NUMBER MILLISECOND {
+                        Run.limits.probeCache = $3;
+                  }
+                | PROBECACHE ':' NUMBER SECOND {
+                        Run.limits.probeCache = $3 * 1000;
+                  }
+                | CYCLEBUDGET ':' NUMBER MILLISECOND {
+                        Run.limits.cycleBudget = $3;
+                  }
+                | CYCLEBUDGET ':' NUMBER SECOND {
+                        Run.limits.cycleBudget = $3 * 1000;
+                  }
                 | STOPTIMEOUT ':' NUMBER MILLISECOND {
                         Run.limits.stopTimeout = $3;
                   }
@@ -705,6 +773,11 @@ setfips         : SET FIPS {
                   }
                 ;
 
+setconfigcache  : SET CONFIGCACHE {
+                        Run.flags |= Run_ConfigCache;
+                  }
+                ;
+
 setlog          : SET LOGFILE PATH   {
                         if (! Run.files.log || ihp.logfile) {
                                 ihp.logfile = true;
@@ -1249,6 +1322,19 @@ checknet        : CHECKNET SERVICENAME ADDRESS STRING {
                   }
                 ;
 
+checkcgroup     : CHECKCGROUP SERVICENAME PATHTOK PATH {
+                        createservice(Service_Cgroup, $<string>2, $4, check_cgroup);
+                  }
+                | CHECKCGROUP SERVICENAME PATHTOK STRING {
+                        createservice(Service_Cgroup, $<string>2, $4, check_cgroup);
+                  }
+                ;
+
+cgroupaccounting : CGROUP {
+                        current->inf.process->cgroup.enabled = true;
+                  }
+                ;
+
 checksystem     : CHECKSYSTEM SERVICENAME {
                         char *servicename = $<string>2;
                         if (Str_sub(servicename, "$HOST")) {
@@ -1386,6 +1472,7 @@ connectionopt   : ip
                 | connectiontimeout
                 | outgoing
                 | retry
+                | keepalive
                 | ssl
                 | sslchecksum
                 | sslexpire
@@ -1405,6 +1492,7 @@ connectionurloptlist : /* EMPTY */
 connectionurlopt : urloption
                  | connectiontimeout
                  | retry
+                 | keepalive
                  | ssl
                  | sslchecksum
                  | sslexpire
@@ -1425,6 +1513,7 @@ connectionuxopt : type
                 | sendexpect
                 | connectiontimeout
                 | retry
+                | keepalive
                 ;
 
 icmp            : IF FAILED ICMP icmptype icmpoptlist rate1 THEN action1 recovery {
@@ -1958,6 +2047,11 @@ retry           : RETRY NUMBER {
                   }
                 ;
 
+keepalive       : KEEPALIVE {
+                        portset.keepalive = true;
+                  }
+                ;
+
 actionrate      : IF NUMBER RESTART NUMBER CYCLE THEN action1 {
                         actionrateset.count = $2;
                         actionrateset.cycle = $4;
@@ -2066,6 +2160,18 @@ every           : EVERY NUMBER CYCLE {
                         current->every.type = Every_NotInCron;
                         current->every.spec.cron = $2;
                  }
+                | EVERY ADAPTIVE {
+                        current->every.type = Every_Adaptive;
+                        current->every.spec.adaptive.interval = 1;
+                        current->every.spec.adaptive.maximum = EVERY_ADAPTIVE_MAXIMUM;
+                 }
+                | EVERY ADAPTIVE NUMBER CYCLE {
+                        if ($3 < 1)
+                                yyerror2("The maximum adaptive check interval must be at least 1 cycle");
+                        current->every.type = Every_Adaptive;
+                        current->every.spec.adaptive.interval = 1;
+                        current->every.spec.adaptive.maximum = $3;
+                 }
                 ;
 
 mode            : MODE ACTIVE {
@@ -2092,6 +2198,17 @@ onreboot        : ONREBOOT START {
                   }
                 ;
 
+priority        : PRIORITY PRIORITYHIGH {
+                        current->priority = Priority_High;
+                  }
+                | PRIORITY PRIORITYNORMAL {
+                        current->priority = Priority_Normal;
+                  }
+                | PRIORITY PRIORITYLOW {
+                        current->priority = Priority_Low;
+                  }
+                ;
+
 group           : GROUP STRINGNAME {
                         addservicegroup($2);
                         FREE($2);
@@ -2142,6 +2259,7 @@ resourceprocessopt  : resourcecpuproc
                     | resourceload
                     | resourceread
                     | resourcewrite
+                    | resourcepressure
                     ;
 
 resourcesystem  : IF resourcesystemlist rate1 THEN action1 recovery {
@@ -2158,6 +2276,7 @@ resourcesystemopt  : resourceload
                    | resourcemem
                    | resourceswap
                    | resourcecpu
+                   | resourcepressure
                    ;
 
 resourcecpuproc : CPU operator value PERCENT {
@@ -2182,6 +2301,9 @@ resourcecpu     : resourcecpuid operator value PERCENT {
 resourcecpuid   : CPUUSER   { $<number>$ = Resource_CpuUser; }
                 | CPUSYSTEM { $<number>$ = Resource_CpuSystem; }
                 | CPUWAIT   { $<number>$ = Resource_CpuWait; }
+                | CPUSTEAL  { $<number>$ = Resource_CpuSteal; }
+                | CPUGUEST  { $<number>$ = Resource_CpuGuest; }
+                | CPUCORE   { $<number>$ = Resource_CpuCore; }
                 | CPU       { $<number>$ = Resource_CpuPercent; }
                 ;
 
@@ -2257,6 +2379,31 @@ resourceloadavg : LOADAVG1  { $<number>$ = Resource_LoadAverage1m; }
                 | LOADAVG15 { $<number>$ = Resource_LoadAverage15m; }
                 ;
 
+resourcepressure : pressureresource pressurekind pressurewindow operator value PERCENT {
+                        resourceset.resource_id = $<number>1;
+                        resourceset.pressure.full = $<number>2;
+                        resourceset.pressure.window = $<number>3;
+                        resourceset.operator = $<number>4;
+                        resourceset.limit = $<real>5;
+                  }
+                ;
+
+pressureresource : CPUPRESSURE    { $<number>$ = Resource_CpuPressure; }
+                 | MEMORYPRESSURE { $<number>$ = Resource_MemoryPressure; }
+                 | IOPRESSURE     { $<number>$ = Resource_IoPressure; }
+                 ;
+
+pressurekind    : /* EMPTY */ { $<number>$ = false; }
+                | SOME        { $<number>$ = false; }
+                | FULL        { $<number>$ = true; }
+                ;
+
+pressurewindow  : /* EMPTY */ { $<number>$ = 0; }
+                | AVG10       { $<number>$ = 0; }
+                | AVG60       { $<number>$ = 1; }
+                | AVG300      { $<number>$ = 2; }
+                ;
+
 resourceread    : DISK READ operator value unit currenttime {
                         resourceset.resource_id = Resource_ReadBytes;
                         resourceset.operator = $<number>3;
@@ -2933,6 +3080,58 @@ void yywarning2(const char *s, ...) {
 }
 
 
+/*
+ * Add the token to the configuration fingerprint. The tokens of a service
+ * statement are hashed into the service fingerprint, other tokens into the
+ * global fingerprint. White space and comments are skipped. The lexer calls
+ * this function before the token's rule action, which may start the next
+ * statement ('check' or 'set' token), so the token is added to the statement
+ * fingerprint when the next token is read (or the parsing finished).
+ */
+void fingerprint(const char *text, int length) {
+        if (*text == '#' || strspn(text, " \t\r\n;,()\\") == (size_t)length)
+                return;
+        fingerprintcommit();
+        cfg_fingerprint.token = FINGERPRINT_SEED;
+        for (int i = 0; i < length; i++)
+                cfg_fingerprint.token = (cfg_fingerprint.token ^ (unsigned char)text[i]) * FINGERPRINT_PRIME;
+        cfg_fingerprint.pending = true;
+}
+
+
+/*
+ * Start the fingerprint of the next service statement (the 'check' token)
+ */
+void fingerprintservice() {
+        if (cfg_fingerprint.count == cfg_fingerprint.size) {
+                cfg_fingerprint.size = cfg_fingerprint.size ? cfg_fingerprint.size * 2 : 64;
+                RESIZE(cfg_fingerprint.hash, cfg_fingerprint.size * sizeof(uint64_t));
+        }
+        cfg_fingerprint.hash[cfg_fingerprint.count++] = FINGERPRINT_SEED;
+        cfg_fingerprint.service = true;
+}
+
+
+/*
+ * Start the global statement (the 'set' token)
+ */
+void fingerprintglobal() {
+        cfg_fingerprint.service = false;
+}
+
+
+/*
+ * Add the last token to the fingerprint of the current statement
+ */
+static void fingerprintcommit() {
+        if (cfg_fingerprint.pending) {
+                uint64_t *hash = cfg_fingerprint.service ? &(cfg_fingerprint.hash[cfg_fingerprint.count - 1]) : &(Run.fingerprint);
+                *hash = (*hash ^ cfg_fingerprint.token) * FINGERPRINT_PRIME;
+                cfg_fingerprint.pending = false;
+        }
+}
+
+
 /*
  * The Parser hook - start parsing the control file
  * Returns true if parsing succeeded, otherwise false
@@ -2948,6 +3147,8 @@ bool parse(char *controlfile) {
         }
 
         currentfile = Str_dup(controlfile);
+        ConfigCache_reset();
+        ConfigCache_addFile(controlfile);
 
         /*
          * Creation of the global service list is synchronized
@@ -2957,11 +3158,14 @@ bool parse(char *controlfile) {
                 preparse();
                 yyparse();
                 fclose(yyin);
+                fingerprintcommit();
                 postparse();
         }
         END_LOCK;
 
         FREE(currentfile);
+        FREE(cfg_fingerprint.hash);
+        cfg_fingerprint.size = cfg_fingerprint.count = 0;
 
         if (argyytext != NULL)
                 FREE(argyytext);
@@ -2987,6 +3191,11 @@ bool parse(char *controlfile) {
 static void preparse() {
         /* Set instance incarnation ID */
         time(&Run.incarnation);
+        /* Reset configuration fingerprints */
+        Run.fingerprint             = FINGERPRINT_SEED;
+        cfg_fingerprint.service     = false;
+        cfg_fingerprint.pending     = false;
+        cfg_fingerprint.count       = 0;
         /* Reset lexer */
         buffer_stack_ptr            = 0;
         lineno                      = 1;
@@ -2997,9 +3206,13 @@ static void preparse() {
         Run.limits.sendExpectBuffer  = LIMIT_SENDEXPECTBUFFER;
         Run.limits.fileContentBuffer = LIMIT_FILECONTENTBUFFER;
         Run.limits.httpContentBuffer = LIMIT_HTTPCONTENTBUFFER;
+        Run.limits.httpContentLimit  = LIMIT_HTTPCONTENTLIMIT;
         Run.limits.programOutput     = LIMIT_PROGRAMOUTPUT;
         Run.limits.networkTimeout    = LIMIT_NETWORKTIMEOUT;
         Run.limits.programTimeout    = LIMIT_PROGRAMTIMEOUT;
+        Run.limits.programConcurrency = LIMIT_PROGRAMCONCURRENCY;
+        Run.limits.probeCache        = LIMIT_PROBECACHE;
+        Run.limits.cycleBudget       = LIMIT_CYCLEBUDGET;
         Run.limits.stopTimeout       = LIMIT_STOPTIMEOUT;
         Run.limits.startTimeout      = LIMIT_STARTTIMEOUT;
         Run.limits.restartTimeout    = LIMIT_RESTARTTIMEOUT;
@@ -3021,6 +3234,7 @@ static void preparse() {
         Run.MailFormat.message       = NULL;
         depend_list                  = NULL;
         Run.flags |= Run_HandlerInit | Run_MmonitCredentials;
+        Run.flags &= ~Run_ConfigCache;
         for (int i = 0; i <= Handler_Max; i++)
                 Run.handler_queue[i] = 0;
 
@@ -3064,6 +3278,11 @@ static void postparse() {
         if (current)
                 addservice(current);
 
+        /* Assign the fingerprints to the services in the order of definition (the automatic system service has none) */
+        int i = 0;
+        for (Service_T s = servicelist_conf; s && i < cfg_fingerprint.count; s = s->next_conf)
+                s->fingerprint = cfg_fingerprint.hash[i++];
+
         /* Check that we do not start monit in daemon mode without having a poll time */
         if (! Run.polltime && ((Run.flags & Run_Daemon) || (Run.flags & Run_Foreground))) {
                 LogError("Poll time is invalid or not defined. Please define poll time in the control file\nas a number (> 0)  or use the -d option when starting monit\n");
@@ -3168,6 +3387,7 @@ static Service_T createservice(Service_Type type, char *name, char *value, State
                         NEW(current->inf.net);
                         break;
                 case Service_Process:
+                case Service_Cgroup:
                         NEW(current->inf.process);
                         break;
                 default:
@@ -3264,11 +3484,28 @@ static void addservice(Service_T s) {
                 case Service_Fifo:
                 case Service_File:
                 case Service_Process:
+                case Service_Cgroup:
                         if (! s->nonexistlist && ! s->existlist) {
                                 // Add existence test if not defined
                                 addeventaction(&(nonexistset).action, Action_Restart, Action_Alert);
                                 addnonexist(&nonexistset);
                         }
+                        if (s->type == Service_Cgroup) {
+                                for (Resource_T r = s->resourcelist; r; r = r->next) {
+                                        if (r->resource_id == Resource_Children) {
+                                                LogError("'check cgroup %s' doesn't support the children test, please use the threads test for the number of tasks\n", s->name);
+                                                cfg_errflag++;
+                                        }
+                                }
+                        } else if (s->type == Service_Process && ! s->inf.process->cgroup.enabled) {
+                                for (Resource_T r = s->resourcelist; r; r = r->next) {
+                                        if (r->resource_id == Resource_CpuPressure || r->resource_id == Resource_MemoryPressure || r->resource_id == Resource_IoPressure) {
+                                                LogError("'check process %s' pressure test requires the cgroup accounting, please add the cgroup statement\n", s->name);
+                                                cfg_errflag++;
+                                                break;
+                                        }
+                                }
+                        }
                         break;
                 default:
                         break;
@@ -3283,6 +3520,7 @@ static void addservice(Service_T s) {
                 servicelist_conf = s;
         }
         tail = s;
+        Util_indexService(s);
 }
 
 
@@ -3364,6 +3602,8 @@ static void addport(Port_T *list, Port_T port) {
 
         if (port->protocol->check == check_radius && port->type != Socket_Udp)
                 yyerror("Radius protocol test supports UDP only");
+        if (port->keepalive && ! port->protocol->ping)
+                yyerror2("The %s protocol test doesn't support keepalive", port->protocol->name);
 
         Port_T p;
         NEW(p);
@@ -3374,6 +3614,7 @@ static void addport(Port_T *list, Port_T port) {
         p->action             = port->action;
         p->timeout            = port->timeout;
         p->retry              = port->retry;
+        p->keepalive          = port->keepalive;
         p->protocol           = port->protocol;
         p->hostname           = port->hostname;
         p->url_request        = port->url_request;
@@ -3417,6 +3658,8 @@ static void addport(Port_T *list, Port_T port) {
                 }
         }
 
+        Probe_attach(p);
+
         p->next = *list;
         *list = p;
 
@@ -3431,7 +3674,7 @@ static void addhttpheader(Port_T port, const char *header) {
                 port->parameters.http.headers = List_new();
         }
         if (Str_startsWith(header, "Connection:") && ! Str_sub(header, "close")) {
-                yywarning("We don't recommend setting the Connection header. Monit will always close the connection even if 'keep-alive' is set\n");
+                yywarning("We don't recommend setting the Connection header. Monit will always close the connection even if 'keep-alive' is set, use the 'keepalive' option instead\n");
         }
         List_append(port->parameters.http.headers, (char *)header);
 }
@@ -3449,6 +3692,7 @@ static void addresource(Resource_T rr) {
                 r->limit       = rr->limit;
                 r->action      = rr->action;
                 r->operator    = rr->operator;
+                r->pressure    = rr->pressure;
                 r->next        = current->resourcelist;
                 current->resourcelist = r;
         } else {
@@ -4559,6 +4803,8 @@ static void reset_resourceset() {
         resourceset.limit = 0;
         resourceset.action = NULL;
         resourceset.operator = Operator_Equal;
+        resourceset.pressure.full = false;
+        resourceset.pressure.window = 0;
 }
 
 
@@ -4816,6 +5062,7 @@ static void check_depend() {
                                         LogError("Depend service '%s' is not defined in the control file\n", d->dependant);
                                         exit(1);
                                 }
+                                d->service = dp;
                                 if (! dp->visited) {
                                         depends_on = dp;
                                 }
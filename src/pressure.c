@@ -0,0 +1,255 @@
+/*
+ * Copyright (C) Tildeslash Ltd. All rights reserved.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ *
+ * You must obey the GNU Affero General Public License in all respects
+ * for all of the code used other than OpenSSL.
+ */
+
+
+#include "xconfig.h"
+
+#ifdef HAVE_STDIO_H
+#include <stdio.h>
+#endif
+
+#ifdef HAVE_STRING_H
+#include <string.h>
+#endif
+
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+
+#ifdef HAVE_ERRNO_H
+#include <errno.h>
+#endif
+
+#ifdef HAVE_FCNTL_H
+#include <fcntl.h>
+#endif
+
+#ifdef HAVE_SYS_EPOLL_H
+#include <sys/epoll.h>
+#endif
+
+#include "monit.h"
+#include "pressure.h"
+#include "Cgroup.h"
+
+
+/**
+ * Implementation of the pressure stall information using the /proc/pressure
+ * and cgroup pressure files and the pressure triggers (see the kernel
+ * Documentation/accounting/psi.rst).
+ *
+ * The trigger is a pressure file descriptor with the "<some|full> <stall us>
+ * <window us>" threshold written to it. The kernel signals POLLPRI on the
+ * descriptor when the stall time within the window crosses the threshold,
+ * at most once per window. All triggers are registered in one epoll
+ * descriptor which the daemon polls while sleeping between cycles.
+ *
+ * The trigger threshold is the test limit applied to the 10 seconds window,
+ * so the trigger of the avg60 and avg300 tests wakes the daemon as soon as
+ * the stall is seen in the last 10 seconds and the test itself evaluates the
+ * longer average.
+ *
+ * On systems without pressure stall information the values are not available
+ * and all trigger methods are no-op.
+ *
+ * @file
+ */
+
+
+/* ----------------------------------------------------------- MARK: - Definitions */
+
+
+#define PRESSURE_WINDOW 10000000ULL       /* The trigger window [us], the maximum allowed by the kernel */
+
+
+static int pressurefd = -1;
+static int *triggers = NULL;
+static int triggerCount = 0;
+
+
+/* ------------------------------------------------------------------ MARK: - Private */
+
+
+static bool _isPressure(Resource_T r) {
+        return r->resource_id == Resource_CpuPressure || r->resource_id == Resource_MemoryPressure || r->resource_id == Resource_IoPressure;
+}
+
+
+#ifdef HAVE_SYS_EPOLL_H
+
+
+static const char *_name(Resource_T r) {
+        switch (r->resource_id) {
+                case Resource_CpuPressure:
+                        return "cpu";
+                case Resource_MemoryPressure:
+                        return "memory";
+                default:
+                        return "io";
+        }
+}
+
+
+/**
+ * Register the pressure trigger for the test. Only the tests which fail if
+ * the pressure is above the limit are supported by the kernel triggers
+ */
+static void _arm(Service_T s, Resource_T r) {
+        if ((r->operator != Operator_Greater && r->operator != Operator_GreaterOrEqual) || r->limit <= 0. || r->limit >= 100.)
+                return;
+        char file[PATH_MAX];
+        if (s->type == Service_Cgroup) {
+                char name[STRLEN];
+                snprintf(name, sizeof(name), "%s.pressure", _name(r));
+                Cgroup_getFile(s->path, name, file, sizeof(file));
+        } else {
+                snprintf(file, sizeof(file), "%s/pressure/%s", PROCFS, _name(r));
+        }
+        int fd = open(file, O_RDWR | O_NONBLOCK | O_CLOEXEC);
+        if (fd < 0) {
+                DEBUG("'%s' cannot open %s for the pressure trigger -- %s\n", s->name, file, STRERROR);
+                return;
+        }
+        char trigger[STRLEN];
+        int length = snprintf(trigger, sizeof(trigger), "%s %llu %llu", r->pressure.full ? "full" : "some", (unsigned long long)(r->limit * PRESSURE_WINDOW / 100.), PRESSURE_WINDOW);
+        struct epoll_event event = {.events = EPOLLPRI, .data.fd = fd};
+        if (write(fd, trigger, length + 1) < 0 || epoll_ctl(pressurefd, EPOLL_CTL_ADD, fd, &event) < 0) {
+                DEBUG("'%s' cannot register the pressure trigger '%s' on %s -- %s\n", s->name, trigger, file, STRERROR);
+                close(fd);
+                return;
+        }
+        RESIZE(triggers, (triggerCount + 1) * sizeof(int));
+        triggers[triggerCount++] = fd;
+}
+
+
+#endif
+
+
+/* ------------------------------------------------------------------- MARK: - Public */
+
+
+bool Pressure_read(const char *file, Pressure_T pressure) {
+        ASSERT(file);
+        ASSERT(pressure);
+        bool rv = false;
+        Pressure_reset(pressure);
+        FILE *f = fopen(file, "r");
+        if (f) {
+                char line[STRLEN];
+                while (fgets(line, sizeof(line), f)) {
+                        // The lines have the format "some|full avg10=n avg60=n avg300=n total=n"
+                        float avg[3];
+                        if (sscanf(line, "some avg10=%f avg60=%f avg300=%f", &avg[0], &avg[1], &avg[2]) == 3) {
+                                memcpy(pressure->some, avg, sizeof(avg));
+                                rv = true;
+                        } else if (sscanf(line, "full avg10=%f avg60=%f avg300=%f", &avg[0], &avg[1], &avg[2]) == 3) {
+                                memcpy(pressure->full, avg, sizeof(avg));
+                        }
+                }
+                fclose(f);
+        }
+        return rv;
+}
+
+
+void Pressure_reset(Pressure_T pressure) {
+        ASSERT(pressure);
+        for (int i = 0; i < 3; i++)
+                pressure->some[i] = pressure->full[i] = -1.;
+}
+
+
+void Pressure_updateSystem() {
+        char file[PATH_MAX];
+        snprintf(file, sizeof(file), "%s/pressure/cpu", PROCFS);
+        Pressure_read(file, &(systeminfo.pressure.cpu));
+        snprintf(file, sizeof(file), "%s/pressure/memory", PROCFS);
+        Pressure_read(file, &(systeminfo.pressure.memory));
+        snprintf(file, sizeof(file), "%s/pressure/io", PROCFS);
+        Pressure_read(file, &(systeminfo.pressure.io));
+}
+
+
+bool Pressure_hasResource(Service_T s) {
+        ASSERT(s);
+        for (Resource_T r = s->resourcelist; r; r = r->next)
+                if (_isPressure(r))
+                        return true;
+        return false;
+}
+
+
+void Pressure_start() {
+#ifdef HAVE_SYS_EPOLL_H
+        if (pressurefd < 0) {
+                for (Service_T s = servicelist; s; s = s->next) {
+                        if ((s->type == Service_System || s->type == Service_Cgroup) && Pressure_hasResource(s)) {
+                                if (pressurefd < 0 && (pressurefd = epoll_create1(EPOLL_CLOEXEC)) < 0) {
+                                        LogWarning("Pressure stall triggers are not available, pressure will be polled -- %s\n", STRERROR);
+                                        return;
+                                }
+                                for (Resource_T r = s->resourcelist; r; r = r->next)
+                                        if (_isPressure(r))
+                                                _arm(s, r);
+                        }
+                }
+        }
+#endif
+}
+
+
+void Pressure_stop() {
+        for (int i = 0; i < triggerCount; i++)
+                close(triggers[i]); // Removes the trigger
+        FREE(triggers);
+        triggerCount = 0;
+        if (pressurefd >= 0) {
+                close(pressurefd);
+                pressurefd = -1;
+        }
+}
+
+
+int Pressure_getDescriptor() {
+        return pressurefd;
+}
+
+
+void Pressure_process() {
+#ifdef HAVE_SYS_EPOLL_H
+        if (pressurefd >= 0) {
+                struct epoll_event events[16];
+                // Polling the trigger acknowledges the event (the poll of the epoll descriptor itself may have done it already), the kernel signals the trigger again in the next window if the stall persists
+                int n = epoll_wait(pressurefd, events, 16, 0);
+                for (int i = 0; i < n; i++) {
+                        if (events[i].events & (EPOLLERR | EPOLLHUP)) {
+                                // The cgroup was removed, the trigger is closed when stopped
+                                epoll_ctl(pressurefd, EPOLL_CTL_DEL, events[i].data.fd, NULL);
+                        }
+                }
+        }
+#endif
+}
+
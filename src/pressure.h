@@ -0,0 +1,106 @@
+/*
+ * Copyright (C) Tildeslash Ltd. All rights reserved.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ *
+ * You must obey the GNU Affero General Public License in all respects
+ * for all of the code used other than OpenSSL.
+ */
+
+#ifndef MONIT_PRESSURE_H
+#define MONIT_PRESSURE_H
+
+
+/**
+ * Pressure stall information (PSI) of the system and cgroups.
+ *
+ * The share of time in which some or all tasks were stalled waiting for the
+ * CPU, memory or I/O is read from the /proc/pressure files for the system and
+ * from the cpu.pressure, memory.pressure and io.pressure files for the cgroup.
+ *
+ * If the system supports it (Linux 5.2 or later), the daemon also registers a
+ * pressure trigger for each "greater than" pressure test of the system and
+ * cgroup services. The trigger descriptor is signalled by the kernel as soon
+ * as the stall time crosses the test limit, so the service can be validated
+ * immediately, without waiting for the next validation cycle.
+ *
+ *  @file
+ */
+
+
+/**
+ * Read the pressure stall information file. The values which are not
+ * available are set to -1
+ * @param file The pressure file path
+ * @param pressure The pressure data
+ * @return true if succeeded otherwise false
+ */
+bool Pressure_read(const char *file, Pressure_T pressure);
+
+
+/**
+ * Reset the pressure data to not available
+ * @param pressure The pressure data
+ */
+void Pressure_reset(Pressure_T pressure);
+
+
+/**
+ * Update the system pressure stall information
+ */
+void Pressure_updateSystem(void);
+
+
+/**
+ * Test if the service has a pressure resource test
+ * @param s A service
+ * @return true if the service has a pressure test otherwise false
+ */
+bool Pressure_hasResource(Service_T s);
+
+
+/**
+ * Start the pressure triggers for the pressure tests of the system and
+ * cgroup services
+ */
+void Pressure_start(void);
+
+
+/**
+ * Stop the pressure triggers
+ */
+void Pressure_stop(void);
+
+
+/**
+ * Get the pressure trigger descriptor. The descriptor is readable if some
+ * pressure trigger fired. Use Pressure_process() to acknowledge the triggers
+ * @return The descriptor or -1 if no pressure trigger is running
+ */
+int Pressure_getDescriptor(void);
+
+
+/**
+ * Acknowledge the pending pressure triggers and remove the triggers of the
+ * cgroups which don't exist anymore
+ */
+void Pressure_process(void);
+
+
+#endif
+
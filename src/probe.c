@@ -0,0 +1,211 @@
+/*
+ * Copyright (C) Tildeslash Ltd. All rights reserved.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ *
+ * You must obey the GNU Affero General Public License in all respects
+ * for all of the code used other than OpenSSL.
+ */
+
+
+
+#include "xconfig.h"
+
+#ifdef HAVE_STDIO_H
+#include <stdio.h>
+#endif
+
+#ifdef HAVE_STRING_H
+#include <string.h>
+#endif
+
+#include "monit.h"
+#include "probe.h"
+#include "protocol.h"
+
+// libmonit
+#include "system/Time.h"
+#include "exceptions/IOException.h"
+
+
+/**
+ * Implementation of the shared connection test results.
+ *
+ * The probe is identified by a key composed of all port test settings
+ * which affect the test result. Probes are kept in a list which is only
+ * searched when the configuration is parsed, the ports keep a reference to
+ * their probe. Services which were not changed by a reload keep their
+ * ports and probes, so the list is reference counted instead of being
+ * rebuilt with the configuration.
+ *
+ * @file
+ */
+
+
+/* ----------------------------------------------------------- MARK: - Definitions */
+
+
+struct Probe_T {
+        char *key;
+        int count;                                    /**< Number of attached ports */
+        int64_t tested;                        /**< Time of the last test [ms] or 0 */
+        bool succeeded;
+        double response;
+        double connect;
+        int validDays;
+        char error[STRLEN];
+        struct Probe_T *next;
+};
+
+
+static struct Probe_T *probelist = NULL;
+
+
+/* ------------------------------------------------------------------ MARK: - Private */
+
+
+static void _appendSsl(StringBuffer_T sb, SslOptions_T o) {
+        StringBuffer_append(sb, "|ssl:%d:%d:%d:%d:%d:%s:%s:%s:%s:%s:%s", o->flags, o->verify, o->allowSelfSigned, o->version, o->checksumType, NVLSTR(o->checksum), NVLSTR(o->pemfile), NVLSTR(o->clientpemfile), NVLSTR(o->ciphers), NVLSTR(o->CACertificateFile), NVLSTR(o->CACertificatePath));
+}
+
+
+/**
+ * Compose the probe key. Returns NULL if the test cannot be shared
+ */
+static char *_key(Port_T p) {
+        if (p->keepalive || p->protocol->check == check_generic || p->protocol->check == check_apache_status || (p->url_request && p->url_request->regex))
+                return NULL;
+        StringBuffer_T sb = StringBuffer_create(256);
+        StringBuffer_append(sb, "%s|%d|%d|%d|%d", p->protocol->name, p->type, p->family, p->timeout, p->retry);
+        if (p->family == Socket_Unix) {
+                StringBuffer_append(sb, "|%s", p->target.unix.pathname);
+        } else {
+                StringBuffer_append(sb, "|%s|%d|%s", NVLSTR(p->hostname), p->target.net.port, NVLSTR(p->outgoing.ip));
+                _appendSsl(sb, &(p->target.net.ssl.options));
+        }
+        if (p->protocol->check == check_http) {
+                StringBuffer_append(sb, "|%d:%d:%d:%d:%s:%s:%s:%s", p->parameters.http.method, p->parameters.http.hasStatus, p->parameters.http.operator, p->parameters.http.status, NVLSTR(p->parameters.http.username), NVLSTR(p->parameters.http.password), NVLSTR(p->parameters.http.request), NVLSTR(p->parameters.http.checksum));
+                if (p->parameters.http.headers)
+                        for (list_t h = p->parameters.http.headers->head; h; h = h->next)
+                                StringBuffer_append(sb, "|%s", (char *)h->e);
+                if (p->url_request && p->url_request->url)
+                        StringBuffer_append(sb, "|%s:%s", NVLSTR(p->url_request->url->user), NVLSTR(p->url_request->url->password));
+        } else if (p->protocol->check == check_mysql) {
+                StringBuffer_append(sb, "|%s:%s", NVLSTR(p->parameters.mysql.username), NVLSTR(p->parameters.mysql.password));
+        } else if (p->protocol->check == check_radius) {
+                StringBuffer_append(sb, "|%s", NVLSTR(p->parameters.radius.secret));
+        } else if (p->protocol->check == check_sip) {
+                StringBuffer_append(sb, "|%d:%s", p->parameters.sip.maxforward, NVLSTR(p->parameters.sip.target));
+        } else if (p->protocol->check == check_smtp || p->protocol->check == check_lmtp) {
+                StringBuffer_append(sb, "|%s:%s", NVLSTR(p->parameters.smtp.username), NVLSTR(p->parameters.smtp.password));
+        } else if (p->protocol->check == check_websocket) {
+                StringBuffer_append(sb, "|%d:%s:%s:%s", p->parameters.websocket.version, NVLSTR(p->parameters.websocket.host), NVLSTR(p->parameters.websocket.origin), NVLSTR(p->parameters.websocket.request));
+        }
+        char *key = Str_dup(StringBuffer_toString(sb));
+        StringBuffer_free(&sb);
+        return key;
+}
+
+
+static void _save(Port_T p, Probe_T probe, const char *error) {
+        probe->succeeded = error == NULL;
+        if (error)
+                snprintf(probe->error, sizeof(probe->error), "%s", error);
+        probe->response = p->response;
+        probe->connect = p->connect;
+        if (p->family != Socket_Unix)
+                probe->validDays = p->target.net.ssl.certificate.validDays;
+}
+
+
+/* ------------------------------------------------------------------- MARK: - Public */
+
+
+void Probe_attach(Port_T p) {
+        ASSERT(p);
+        char *key = _key(p);
+        if (key) {
+                Probe_T probe;
+                for (probe = probelist; probe; probe = probe->next)
+                        if (Str_isEqual(probe->key, key))
+                                break;
+                if (probe) {
+                        FREE(key);
+                } else {
+                        NEW(probe);
+                        probe->key = key;
+                        probe->next = probelist;
+                        probelist = probe;
+                }
+                probe->count++;
+                p->probe = probe;
+        }
+}
+
+
+void Probe_detach(Port_T p) {
+        ASSERT(p);
+        Probe_T probe = p->probe;
+        if (probe) {
+                p->probe = NULL;
+                if (--probe->count == 0) {
+                        for (Probe_T *q = &probelist; *q; q = &(*q)->next) {
+                                if (*q == probe) {
+                                        *q = probe->next;
+                                        break;
+                                }
+                        }
+                        FREE(probe->key);
+                        FREE(probe);
+                }
+        }
+}
+
+
+void Probe_test(Port_T p, bool cached) {
+        ASSERT(p);
+        Probe_T probe = p->probe;
+        if (! probe || probe->count < 2 || ! Run.limits.probeCache) {
+                Socket_test(p);
+        } else if (cached && probe->tested && Time_milli() - probe->tested < Run.limits.probeCache) {
+                DEBUG("Using the cached result of the connection test at %s\n", Util_portDescription(p, (char[STRLEN]){}, STRLEN));
+                p->response = probe->response;
+                p->connect = probe->connect;
+                if (p->family != Socket_Unix)
+                        p->target.net.ssl.certificate.validDays = probe->validDays;
+                if (! probe->succeeded) {
+                        p->is_available = Connection_Failed;
+                        THROW(IOException, "%s", probe->error);
+                }
+                p->is_available = Connection_Ok;
+        } else {
+                probe->tested = Time_milli();
+                TRY
+                {
+                        Socket_test(p);
+                        _save(p, probe, NULL);
+                }
+                ELSE
+                {
+                        _save(p, probe, Exception_frame.message);
+                        RETHROW;
+                }
+                END_TRY;
+        }
+}
+
@@ -0,0 +1,74 @@
+/*
+ * Copyright (C) Tildeslash Ltd. All rights reserved.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ *
+ * You must obey the GNU Affero General Public License in all respects
+ * for all of the code used other than OpenSSL.
+ */
+
+
+#ifndef MONIT_PROBE_H
+#define MONIT_PROBE_H
+
+
+/**
+ * Shared connection test results.
+ *
+ * Port and unix socket tests which are configured identically (same
+ * target, protocol, request, SSL options and timeouts) share one probe
+ * object, even if they belong to different services. If the probe cache
+ * is enabled using the probeCache limit, the result of a test is reused by
+ * the other tests of the same probe until it is older than the limit, so
+ * the target is tested only once.
+ *
+ * Tests which cannot be compared reliably (send/expect, HTTP content and
+ * apache-status tests and keepalive connections) are not shared.
+ *
+ *  @file
+ */
+
+
+/**
+ * Attach the port test to a probe shared with the identical port tests
+ * @param p A port object
+ */
+void Probe_attach(Port_T p);
+
+
+/**
+ * Detach the port test from its probe. The probe is freed when the last
+ * port is detached
+ * @param p A port object
+ */
+void Probe_detach(Port_T p);
+
+
+/**
+ * Test the port. If the port shares a probe and the probe result is not
+ * older than the probe cache limit, the cached result is used instead of
+ * testing the port again
+ * @param p A port object
+ * @param cached true if a cached result can be used
+ * @exception IOException if test failed
+ */
+void Probe_test(Port_T p, bool cached);
+
+
+#endif
+
@@ -0,0 +1,209 @@
+
+
+#include "xconfig.h"
+
+#ifdef HAVE_STDIO_H
+#include <stdio.h>
+#endif
+
+#ifdef HAVE_STDLIB_H
+#include <stdlib.h>
+#endif
+
+#ifdef HAVE_STRING_H
+#include <string.h>
+#endif
+
+#ifdef HAVE_INTTYPES_H
+#include <inttypes.h>
+#endif
+
+#include "monit.h"
+#include "ProcessTree.h"
+#include "Cgroup.h"
+#include "pressure.h"
+
+// libmonit
+#include "system/Time.h"
+
+
+/**
+ * Implementation of the cgroup v2 resource accounting. The statistics are
+ * read from the cpu.stat, memory.current, memory.stat, io.stat and
+ * pids.current files of the cgroup, the pressure stall information from the
+ * cpu.pressure, memory.pressure and io.pressure files. Only the unified (v2) hierarchy is
+ * supported, on systems without cgroups all methods fail.
+ *
+ * @file
+ */
+
+
+/* ----------------------------------------------------------- MARK: - Definitions */
+
+
+#define CGROUPFS "/sys/fs/cgroup"
+
+
+/* ------------------------------------------------------------------ MARK: - Private */
+
+
+#ifdef LINUX
+
+
+static FILE *_open(const char *path, const char *name) {
+        char file[PATH_MAX];
+        return fopen(Cgroup_getFile(path, name, file, sizeof(file)), "r");
+}
+
+
+static bool _readValue(const char *path, const char *name, uint64_t *value) {
+        bool rv = false;
+        FILE *f = _open(path, name);
+        if (f) {
+                rv = fscanf(f, "%"SCNu64, value) == 1;
+                fclose(f);
+        }
+        return rv;
+}
+
+
+/**
+ * Read the "key value" formatted file (cpu.stat, memory.stat)
+ */
+static bool _readKey(const char *path, const char *name, const char *key, uint64_t *value) {
+        bool rv = false;
+        FILE *f = _open(path, name);
+        if (f) {
+                char line[STRLEN];
+                size_t length = strlen(key);
+                while (fgets(line, sizeof(line), f)) {
+                        if (! strncmp(line, key, length) && line[length] == ' ') {
+                                rv = sscanf(line + length, "%"SCNu64, value) == 1;
+                                break;
+                        }
+                }
+                fclose(f);
+        }
+        return rv;
+}
+
+
+/**
+ * Sum the io.stat counters of all devices. The lines have the format
+ * "<major>:<minor> rbytes=n wbytes=n rios=n wios=n dbytes=n dios=n"
+ */
+static void _readIO(const char *path, CgroupInfo_T info) {
+        FILE *f = _open(path, "io.stat");
+        if (f) {
+                char line[STRLEN];
+                while (fgets(line, sizeof(line), f)) {
+                        for (char *token = strtok(line, " \n"); token; token = strtok(NULL, " \n")) {
+                                uint64_t value;
+                                if (sscanf(token, "rbytes=%"SCNu64, &value) == 1)
+                                        info->read.bytes += value;
+                                else if (sscanf(token, "wbytes=%"SCNu64, &value) == 1)
+                                        info->write.bytes += value;
+                                else if (sscanf(token, "rios=%"SCNu64, &value) == 1)
+                                        info->read.operations += value;
+                                else if (sscanf(token, "wios=%"SCNu64, &value) == 1)
+                                        info->write.operations += value;
+                        }
+                }
+                fclose(f);
+        }
+}
+
+
+#endif
+
+
+/* ------------------------------------------------------------------- MARK: - Public */
+
+
+bool Cgroup_read(const char *path, CgroupInfo_T info) {
+        ASSERT(path);
+        ASSERT(info);
+        memset(info, 0, sizeof(*info));
+#ifdef LINUX
+        // The cpu.stat and memory.current files exist in every non-root cgroup (the cpu controller statistics are always available in cpu.stat)
+        if (_readKey(path, "cpu.stat", "usage_usec", &info->cpuTime) && _readValue(path, "memory.current", &info->memory)) {
+                uint64_t pids = 0;
+                _readKey(path, "memory.stat", "anon", &info->anonymous);
+                info->pids = _readValue(path, "pids.current", &pids) ? (int)pids : -1;
+                _readIO(path, info);
+                return true;
+        }
+#endif
+        return false;
+}
+
+
+char *Cgroup_getFile(const char *path, const char *name, char *file, int size) {
+        ASSERT(path);
+        ASSERT(name);
+        ASSERT(file);
+        if (Str_startsWith(path, CGROUPFS "/"))
+                snprintf(file, size, "%s/%s", path, name);
+        else
+                snprintf(file, size, "%s%s%s/%s", CGROUPFS, *path == '/' ? "" : "/", path, name);
+        return file;
+}
+
+
+bool Cgroup_getPath(pid_t pid, char *path, int size) {
+        ASSERT(path);
+#ifdef LINUX
+        char buf[PATH_MAX];
+        if (file_readProc(buf, sizeof(buf), "cgroup", pid, NULL)) {
+                // The unified hierarchy entry has the format "0::<path>"
+                for (char *line = buf; line && *line; line = strchr(line, '\n') ? strchr(line, '\n') + 1 : NULL) {
+                        if (Str_startsWith(line, "0::")) {
+                                snprintf(path, size, "%.*s", (int)strcspn(line + 3, "\n"), line + 3);
+                                return true;
+                        }
+                }
+        }
+#endif
+        return false;
+}
+
+
+bool Cgroup_updateService(Service_T s, const char *path) {
+        ASSERT(s);
+        ASSERT(path);
+        struct CgroupInfo_T info;
+        if (! Cgroup_read(path, &info))
+                return false;
+        ProcessInfo_T p = s->inf.process;
+        uint64_t now = Time_micro();
+        if (p->cgroup.time && now > p->cgroup.time && info.cpuTime >= p->cgroup.cpuTime && systeminfo.cpu.count > 0) {
+                double usage = 100. * (double)(info.cpuTime - p->cgroup.cpuTime) / (double)(now - p->cgroup.time) / systeminfo.cpu.count;
+                p->total_cpu_percent = usage > 100. ? 100. : usage;
+        } else {
+                p->total_cpu_percent = -1.;
+        }
+        p->cgroup.cpuTime = info.cpuTime;
+        p->cgroup.time = now;
+        char file[PATH_MAX];
+        Pressure_read(Cgroup_getFile(path, "cpu.pressure", file, sizeof(file)), &(p->pressure.cpu));
+        Pressure_read(Cgroup_getFile(path, "memory.pressure", file, sizeof(file)), &(p->pressure.memory));
+        Pressure_read(Cgroup_getFile(path, "io.pressure", file, sizeof(file)), &(p->pressure.io));
+        p->total_mem = info.memory;
+        if (systeminfo.memory.size > 0)
+                p->total_mem_percent = info.memory >= systeminfo.memory.size ? 100. : 100. * (double)info.memory / (double)systeminfo.memory.size;
+        if (s->type == Service_Cgroup) {
+                // The cgroup as a whole: the anonymous memory is the counterpart of the process resident memory, the tasks count includes all threads
+                p->cpu_percent = p->total_cpu_percent;
+                p->mem = info.anonymous;
+                if (systeminfo.memory.size > 0)
+                        p->mem_percent = info.anonymous >= systeminfo.memory.size ? 100. : 100. * (double)info.anonymous / (double)systeminfo.memory.size;
+                p->threads = info.pids;
+                uint64_t milli = now / 1000;
+                Statistics_update(&(p->read.bytes), milli, info.read.bytes);
+                Statistics_update(&(p->read.operations), milli, info.read.operations);
+                Statistics_update(&(p->write.bytes), milli, info.write.bytes);
+                Statistics_update(&(p->write.operations), milli, info.write.operations);
+        }
+        return true;
+}
+
@@ -0,0 +1,79 @@
+
+#ifndef MONIT_CGROUP_H
+#define MONIT_CGROUP_H
+
+#include "xconfig.h"
+
+
+/**
+ * Resource accounting from the cgroup v2 controllers. The cgroup statistics
+ * include all processes in the cgroup, including processes which daemonized
+ * away from the parent, and are read from a few files, independently of the
+ * number of processes.
+ *
+ * @file
+ */
+
+
+typedef struct CgroupInfo_T {
+        uint64_t cpuTime;                                  /**< CPU time [us] */
+        uint64_t memory;              /**< Memory usage including page cache */
+        uint64_t anonymous;                             /**< Anonymous memory */
+        int pids;                                         /**< Number of tasks */
+        struct {
+                uint64_t bytes;
+                uint64_t operations;
+        } read;
+        struct {
+                uint64_t bytes;
+                uint64_t operations;
+        } write;
+} *CgroupInfo_T;
+
+
+/**
+ * Read the cgroup statistics
+ * @param path The cgroup path relative to the cgroup2 mount point
+ * (/sys/fs/cgroup) or absolute path
+ * @param info The cgroup statistics
+ * @return true if succeeded otherwise false
+ */
+bool Cgroup_read(const char *path, CgroupInfo_T info);
+
+
+/**
+ * Get the cgroup v2 path of the process
+ * @param pid The process id
+ * @param path The buffer for the cgroup path
+ * @param size The buffer size
+ * @return true if succeeded otherwise false
+ */
+bool Cgroup_getPath(pid_t pid, char *path, int size);
+
+
+/**
+ * Get the path of the cgroup interface file
+ * @param path The cgroup path relative to the cgroup2 mount point
+ * (/sys/fs/cgroup) or absolute path
+ * @param name The interface file name (e.g. cpu.stat)
+ * @param file The buffer for the file path
+ * @param size The buffer size
+ * @return The file path
+ */
+char *Cgroup_getFile(const char *path, const char *name, char *file, int size);
+
+
+/**
+ * Update the resource usage of the service from the cgroup statistics. The
+ * "check cgroup" service gets all values, the process service with the
+ * cgroup accounting gets the totals. The cgroup pressure stall information
+ * is updated for both
+ * @param s The service
+ * @param path The cgroup path
+ * @return true if succeeded otherwise false
+ */
+bool Cgroup_updateService(Service_T s, const char *path);
+
+
+#endif
+
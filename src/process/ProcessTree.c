@@ -68,6 +68,7 @@
 #include "event.h"
 #include "ProcessTree.h"
 #include "process_sysdep.h"
+#include "pressure.h"
 #include "Box.h"
 #include "Color.h"
 
@@ -85,8 +86,38 @@
 /* ----------------------------------------------------- MARK: - Definitions */
 
 
+typedef enum {
+        Match_Unknown = 0,
+        Match_No,
+        Match_Yes
+} __attribute__((__packed__)) Match_Result;
+
+
+typedef struct MatchRow_T {
+        pid_t pid;
+        time_t start;
+        int row;                                       /**< Row in the results matrix */
+} MatchRow_T;
+
+
 static int ptreesize = 0;
 static ProcessTree_T *ptree = NULL;
+static unsigned ptreegeneration = 0;                 /**< Incremented with each process tree scan */
+static bool ptreecommandline = false;      /**< The process tree includes the command line */
+
+/**
+ * The command line match results from the last pass. The matrix has one row
+ * per process, sorted by pid, and one column per pattern. The process
+ * command line doesn't change usually, so the result is reused while the
+ * process with the same pid and start time exists
+ */
+static struct {
+        int rows;
+        int columns;
+        MatchRow_T *row;
+        char **pattern;
+        Match_Result *result;
+} matchcache = {};
 
 
 /* --------------------------------------------------------- MARK: - Private */
@@ -186,6 +217,135 @@ static float _cpuUsage(float rawUsage, unsigned threads) {
 }
 
 
+static bool _isRunning(pid_t pid) {
+        errno = 0;
+        return getpgid(pid) > -1 || errno == EPERM;
+}
+
+
+static int _compareRow(const void *a, const void *b) {
+        const MatchRow_T *x = a, *y = b;
+        return x->pid < y->pid ? -1 : x->pid > y->pid;
+}
+
+
+static void _freeMatchCache(void) {
+        for (int i = 0; i < matchcache.columns; i++)
+                FREE(matchcache.pattern[i]);
+        FREE(matchcache.pattern);
+        FREE(matchcache.row);
+        FREE(matchcache.result);
+        matchcache.rows = matchcache.columns = 0;
+}
+
+
+/**
+ * Test if the process service has to look up the process in the process
+ * tree: it uses the "matching" statement and the cached pid is not running
+ */
+static bool _isPending(Service_T s) {
+        return s->type == Service_Process && s->matchlist && s->monitor != Monitor_Not && ! (s->inf.process->pid > 0 && _isRunning(s->inf.process->pid));
+}
+
+
+static int _findColumn(char **pattern, int columns, const char *match) {
+        int c;
+        for (c = 0; c < columns && ! IS(pattern[c], match); c++)
+                ;
+        return c;
+}
+
+
+/**
+ * Resolve the process of all pending matching services (and the given
+ * service) in one pass over the process tree. The pattern is tested once for
+ * each process, the result is reused from the previous pass if the process
+ * with the same pid and start time was tested already. The found pid is saved
+ * in the service with the process tree generation. The results of the other
+ * services' patterns are carried over from the previous pass
+ */
+static void _matchPending(Service_T service) {
+        // Collect the pending services and their distinct patterns
+        int count = 1, columns = 0;
+        for (Service_T s = servicelist; s; s = s->next)
+                count++;
+        Service_T *pending = CALLOC(sizeof(Service_T), count);
+        regex_t **regex = CALLOC(sizeof(regex_t *), count + matchcache.columns);
+        char **pattern = CALLOC(sizeof(char *), count + matchcache.columns);
+        pending[0] = service;
+        count = 1;
+        for (Service_T s = servicelist; s; s = s->next)
+                if (s != service && _isPending(s))
+                        pending[count++] = s;
+        for (int k = 0; k < count; k++) {
+                int c = _findColumn(pattern, columns, pending[k]->matchlist->match_string);
+                if (c == columns) {
+                        regex[c] = pending[k]->matchlist->regex_comp;
+                        pattern[c] = Str_dup(pending[k]->matchlist->match_string);
+                        columns++;
+                }
+        }
+        // Keep the cached results of the other services, so they're available if the service's process stops
+        for (int j = 0; j < matchcache.columns; j++) {
+                if (_findColumn(pattern, columns, matchcache.pattern[j]) == columns) {
+                        for (Service_T s = servicelist; s; s = s->next) {
+                                if (s->type == Service_Process && s->matchlist && IS(s->matchlist->match_string, matchcache.pattern[j])) {
+                                        pattern[columns++] = Str_dup(matchcache.pattern[j]);
+                                        break;
+                                }
+                        }
+                }
+        }
+        // Map the columns to the previous pass
+        int *previous = CALLOC(sizeof(int), columns);
+        for (int c = 0; c < columns; c++) {
+                int j = _findColumn(matchcache.pattern, matchcache.columns, pattern[c]);
+                previous[c] = j < matchcache.columns ? j : -1;
+        }
+        // Test the processes
+        MatchRow_T *row = CALLOC(sizeof(MatchRow_T), ptreesize);
+        Match_Result *result = CALLOC(sizeof(Match_Result), (size_t)ptreesize * columns);
+        for (int i = 0; i < ptreesize; i++) {
+                row[i].pid = ptree[i].pid;
+                row[i].start = (time_t)(systeminfo.time / 10. - ptree[i].uptime);
+                row[i].row = i;
+                if (ptree[i].cmdline) {
+                        MatchRow_T *old = matchcache.rows ? bsearch(&row[i], matchcache.row, matchcache.rows, sizeof(MatchRow_T), _compareRow) : NULL;
+                        if (old && old->start != row[i].start)
+                                old = NULL; // The pid was reused by another process
+                        for (int c = 0; c < columns; c++) {
+                                Match_Result *r = &result[(size_t)i * columns + c];
+                                if (old && previous[c] >= 0)
+                                        *r = matchcache.result[(size_t)old->row * matchcache.columns + previous[c]];
+                                if (*r == Match_Unknown && regex[c])
+                                        *r = regexec(regex[c], ptree[i].cmdline, 0, NULL, 0) == 0 ? Match_Yes : Match_No;
+                        }
+                }
+        }
+        // Select the oldest matching process whose parent doesn't match the pattern
+        for (int k = 0; k < count; k++) {
+                int c = _findColumn(pattern, columns, pending[k]->matchlist->match_string);
+                int found = -1;
+                for (int i = 0; i < ptreesize; i++)
+                        if (result[(size_t)i * columns + c] == Match_Yes && (i == ptree[i].parent || result[(size_t)ptree[i].parent * columns + c] != Match_Yes) && (found == -1 || ptree[found].uptime < ptree[i].uptime))
+                                found = i;
+                pending[k]->inf.process->match.pid = found >= 0 ? ptree[found].pid : -1;
+                pending[k]->inf.process->match.resolved = ptreegeneration;
+        }
+        // Save the results for the next pass
+        _freeMatchCache();
+        qsort(row, ptreesize, sizeof(MatchRow_T), _compareRow);
+        matchcache.rows = ptreesize;
+        matchcache.columns = columns;
+        matchcache.row = row;
+        matchcache.pattern = pattern;
+        matchcache.result = result;
+        FREE(previous);
+        FREE(regex);
+        FREE(pending);
+}
+
+
 static int _match(regex_t *regex) {
         int found = -1;
         // Scan the whole process tree and find the oldest matching process whose parent doesn't match the pattern
@@ -219,6 +379,8 @@ int ProcessTree_init(ProcessEngine_Flags pflags) {
 
         systeminfo.time_prev = systeminfo.time;
         systeminfo.time = Time_milli() / 100.;
+        ptreegeneration++;
+        ptreecommandline = false;
         if ((ptreesize = initprocesstree_sysdep(&ptree, pflags)) <= 0 || ! ptree) {
                 DEBUG("System statistic -- cannot initialize the process tree -- process resource monitoring disabled\n");
                 Run.flags &= ~Run_ProcessEngineEnabled;
@@ -272,6 +434,7 @@ int ProcessTree_init(ProcessEngine_Flags pflags) {
         }
 
         _fillProcessTree(pt, root);
+        ptreecommandline = pflags & ProcessEngine_CollectCommandLine;
 
         return ptreesize;
 }
@@ -282,6 +445,15 @@ int ProcessTree_init(ProcessEngine_Flags pflags) {
  */
 void ProcessTree_delete() {
         _delete(&ptree, &ptreesize);
+        _freeMatchCache();
+}
+
+
+bool ProcessTree_hasPendingMatch() {
+        for (Service_T s = servicelist; s; s = s->next)
+                if (_isPending(s))
+                        return true;
+        return false;
 }
 
 
@@ -349,19 +521,19 @@ time_t ProcessTree_getProcessUptime(pid_t pid) {
 pid_t ProcessTree_findProcess(Service_T s) {
         ASSERT(s);
         // Test the cached PID first
-        if (s->inf.process->pid > 0) {
-                errno = 0;
-                if (getpgid(s->inf.process->pid) > -1 || errno == EPERM)
-                        return s->inf.process->pid;
-        }
+        if (s->inf.process->pid > 0 && _isRunning(s->inf.process->pid))
+                return s->inf.process->pid;
         // If the cached PID is not running, scan for the process again
         if (s->matchlist) {
-                // Update the process tree including command line
-                ProcessTree_init(ProcessEngine_CollectCommandLine);
+                // Update the process tree including command line, unless the current tree has it already. If the service was looked up in the current tree already, the caller waits for the process => scan again
+                if (! ptreecommandline || s->inf.process->match.used == ptreegeneration)
+                        ProcessTree_init(ProcessEngine_CollectCommandLine);
                 if (Run.flags & Run_ProcessEngineEnabled) {
-                        int pid = _match(s->matchlist->regex_comp);
-                        if (pid >= 0)
-                                return pid;
+                        if (s->inf.process->match.resolved != ptreegeneration)
+                                _matchPending(s);
+                        s->inf.process->match.used = ptreegeneration;
+                        if (s->inf.process->match.pid >= 0)
+                                return s->inf.process->match.pid;
                 } else {
                         DEBUG("Process information not available -- skipping service %s process existence check for this cycle\n", s->name);
                         // Return value is NOOP - it is based on existing errors bitmap so we don't generate false recovery/failures
@@ -370,8 +542,7 @@ pid_t ProcessTree_findProcess(Service_T s) {
         } else {
                 pid_t pid = Util_getPid(s->path);
                 if (pid > 0) {
-                        errno = 0;
-                        if (getpgid(pid) > -1 || errno == EPERM)
+                        if (_isRunning(pid))
                                 return pid;
                         DEBUG("'%s' process test failed [pid=%d] -- %s\n", s->name, pid, STRERROR);
                 }
@@ -479,12 +650,16 @@ bool init_system_info(void) {
         systeminfo.cpu.usage.user = -1.;
         systeminfo.cpu.usage.system = -1.;
         systeminfo.cpu.usage.wait = -1.;
+        systeminfo.cpu.usage.steal = -1.;
+        systeminfo.cpu.usage.guest = -1.;
         return (init_process_info_sysdep());
 }
 
 
 //FIXME: move to standalone system class
 bool update_system_info() {
+        Pressure_updateSystem();
+
         if (getloadavg_sysdep(systeminfo.loadavg, 3) == -1) {
                 LogError("'%s' statistic error -- load average data collection failed\n", Run.system->name);
                 goto error1;
@@ -89,6 +89,16 @@ int ProcessTree_init(ProcessEngine_Flags pflags);
 void ProcessTree_delete(void);
 
 
+/**
+ * Test if a process service with the "matching" statement has to look up
+ * its process, because the cached pid is not running. The caller collects
+ * the process tree including the command line in that case, so all pending
+ * services are resolved in one pass over the same tree
+ * @return true if the process command line is needed otherwise false
+ */
+bool ProcessTree_hasPendingMatch(void);
+
+
 /**
  * Update the process infomation.
  * @param s A Service object
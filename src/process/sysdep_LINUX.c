@@ -61,6 +61,10 @@
 #include <string.h>
 #endif
 
+#ifdef HAVE_CTYPE_H
+#include <ctype.h>
+#endif
+
 #ifdef HAVE_ASM_PARAM_H
 #include <asm/param.h>
 #endif
@@ -133,8 +137,13 @@ static void __attribute__ ((constructor)) _constructor() {
 static uint64_t old_cpu_user     = 0;
 static uint64_t old_cpu_syst     = 0;
 static uint64_t old_cpu_wait     = 0;
+static uint64_t old_cpu_steal    = 0;
+static uint64_t old_cpu_guest    = 0;
 static uint64_t old_cpu_total    = 0;
 
+static uint64_t *old_core_busy   = NULL; // Per core busy ticks from last cycle, systeminfo.cpu.core.count entries
+static uint64_t *old_core_total  = NULL; // Per core total ticks from last cycle, systeminfo.cpu.core.count entries
+
 static long page_size = 0;
 
 static double hz = 0.;
@@ -283,6 +292,32 @@ static double _usagePercent(uint64_t previous, uint64_t current, double total) {
 }
 
 
+/**
+ * Update the usage of the given core. The arrays grow when a core appears
+ */
+static void _updateCore(SystemInfo_T *si, int core, uint64_t busy, uint64_t total) {
+        if (core >= si->cpu.core.count) {
+                int count = core + 1;
+                RESIZE(old_core_busy, count * sizeof(uint64_t));
+                RESIZE(old_core_total, count * sizeof(uint64_t));
+                RESIZE(si->cpu.core.usage, count * sizeof(float));
+                for (int i = si->cpu.core.count; i < count; i++) {
+                        old_core_busy[i] = old_core_total[i] = 0;
+                        si->cpu.core.usage[i] = -1.;
+                }
+                si->cpu.core.count = count;
+        }
+        if (old_core_total[core] && total > old_core_total[core]) {
+                double usage = _usagePercent(old_core_busy[core], busy, total - old_core_total[core]);
+                si->cpu.core.usage[core] = usage > 100. ? 100. : usage;
+        } else {
+                si->cpu.core.usage[core] = -1.;
+        }
+        old_core_busy[core] = busy;
+        old_core_total[core] = total;
+}
+
+
 /* ---------------------------------------------------- MARK: - Public */
 
 
@@ -353,7 +388,9 @@ int initprocesstree_sysdep(ProcessTree_T **reference, ProcessEngine_Flags pflags
 
         // Find all processes in the /proc directory
         glob_t globbuf;
-        int rv = glob("/proc/[0-9]*", 0, NULL, &globbuf);
+        char pattern[PATH_MAX];
+        snprintf(pattern, sizeof(pattern), "%s/[0-9]*", PROCFS);
+        int rv = glob(pattern, 0, NULL, &globbuf);
         if (rv) {
                 LogError("system statistic error -- glob failed: %d (%s)\n", rv, STRERROR);
                 return 0;
@@ -364,7 +401,7 @@ int initprocesstree_sysdep(ProcessTree_T **reference, ProcessEngine_Flags pflags
         struct Proc_T proc = {};
         time_t starttime = _getStartTime();
         for (int i = 0; i < globbuf.gl_pathc; i++) {
-                proc.pid = atoi(globbuf.gl_pathv[i] + 6); // skip "/proc/"
+                proc.pid = atoi(globbuf.gl_pathv[i] + strlen(PROCFS) + 1); // skip "/proc/"
                 if (_parseProcPidStat(&proc) && _parseProcPidStatus(&proc) && _parseProcPidIO(&proc) && _parseProcPidCmdline(&proc, pflags)) {
                         // Non-mandatory statistics (may not exist)
                         _parseProcPidAttrCurrent(&proc);
@@ -490,64 +527,77 @@ error:
  * @return: true if successful, false if failed (or not available)
  */
 bool used_system_cpu_sysdep(SystemInfo_T *si) {
-        bool rv;
-        uint64_t cpu_total;
-        uint64_t cpu_user;
-        uint64_t cpu_nice;
-        uint64_t cpu_syst;
-        uint64_t cpu_idle;
-        uint64_t cpu_wait;
-        uint64_t cpu_irq;
-        uint64_t cpu_softirq;
-        char buf[STRLEN];
-
-        if (! file_readProc(buf, sizeof(buf), "stat", -1, NULL)) {
+        char path[STRLEN];
+        snprintf(path, sizeof(path), "%s/stat", PROCFS);
+        FILE *f = fopen(path, "r");
+        if (! f) {
                 LogError("system statistic error -- cannot read /proc/stat\n");
                 goto error;
         }
 
-        rv = sscanf(buf, "cpu %llu %llu %llu %llu %llu %llu %llu",
-                    &cpu_user,
-                    &cpu_nice,
-                    &cpu_syst,
-                    &cpu_idle,
-                    &cpu_wait,
-                    &cpu_irq,
-                    &cpu_softirq);
-        if (rv < 4) {
+        // The offline cores have no line
+        for (int i = 0; i < si->cpu.core.count; i++)
+                si->cpu.core.usage[i] = -1.;
+
+        // The aggregate "cpu" line is followed by the "cpuN" line of each online core, the other statistics follow, so we can stop at the first line without the "cpu" prefix
+        bool rv = false;
+        char line[STRLEN];
+        while (fgets(line, sizeof(line), f) && Str_startsWith(line, "cpu")) {
+                char *p = line + 3;
+                int core = -1;
+                if (isdigit(*p))
+                        core = (int)strtol(p, &p, 10);
+                // user, nice, system, idle, iowait, irq, softirq, steal, guest, guest_nice. Linux 2.4.x doesn't support iowait and later values, they stay 0
+                uint64_t ticks[10] = {};
+                if (sscanf(p, "%"SCNu64" %"SCNu64" %"SCNu64" %"SCNu64" %"SCNu64" %"SCNu64" %"SCNu64" %"SCNu64" %"SCNu64" %"SCNu64,
+                           &ticks[0], &ticks[1], &ticks[2], &ticks[3], &ticks[4], &ticks[5], &ticks[6], &ticks[7], &ticks[8], &ticks[9]) < 4)
+                        continue;
+                // The guest time is included in the user time
+                uint64_t cpu_total = ticks[0] + ticks[1] + ticks[2] + ticks[3] + ticks[4] + ticks[5] + ticks[6] + ticks[7];
+                if (core >= 0) {
+                        _updateCore(si, core, cpu_total - ticks[3] - ticks[4], cpu_total);
+                } else {
+                        uint64_t cpu_user  = ticks[0] + ticks[1];
+                        uint64_t cpu_syst  = ticks[2];
+                        uint64_t cpu_wait  = ticks[4];
+                        uint64_t cpu_steal = ticks[7];
+                        uint64_t cpu_guest = ticks[8] + ticks[9];
+                        if (old_cpu_total == 0 || cpu_total <= old_cpu_total) {
+                                si->cpu.usage.user = -1.;
+                                si->cpu.usage.system = -1.;
+                                si->cpu.usage.wait = -1.;
+                                si->cpu.usage.steal = -1.;
+                                si->cpu.usage.guest = -1.;
+                        } else {
+                                double delta = cpu_total - old_cpu_total;
+                                si->cpu.usage.user = _usagePercent(old_cpu_user, cpu_user, delta);
+                                si->cpu.usage.system = _usagePercent(old_cpu_syst, cpu_syst, delta);
+                                si->cpu.usage.wait = _usagePercent(old_cpu_wait, cpu_wait, delta);
+                                si->cpu.usage.steal = _usagePercent(old_cpu_steal, cpu_steal, delta);
+                                si->cpu.usage.guest = _usagePercent(old_cpu_guest, cpu_guest, delta);
+                        }
+                        old_cpu_user  = cpu_user;
+                        old_cpu_syst  = cpu_syst;
+                        old_cpu_wait  = cpu_wait;
+                        old_cpu_steal = cpu_steal;
+                        old_cpu_guest = cpu_guest;
+                        old_cpu_total = cpu_total;
+                        rv = true;
+                }
+        }
+        fclose(f);
+        if (! rv) {
                 LogError("system statistic error -- cannot read cpu usage\n");
                 goto error;
-        } else if (rv == 4) {
-                /* linux 2.4.x doesn't support these values */
-                cpu_wait    = 0;
-                cpu_irq     = 0;
-                cpu_softirq = 0;
         }
-
-        cpu_total = cpu_user + cpu_nice + cpu_syst + cpu_idle + cpu_wait + cpu_irq + cpu_softirq;
-        cpu_user  = cpu_user + cpu_nice;
-
-        if (old_cpu_total == 0) {
-                si->cpu.usage.user = -1.;
-                si->cpu.usage.system = -1.;
-                si->cpu.usage.wait = -1.;
-        } else {
-                double delta = cpu_total - old_cpu_total;
-                si->cpu.usage.user = _usagePercent(old_cpu_user, cpu_user, delta);
-                si->cpu.usage.system = _usagePercent(old_cpu_syst, cpu_syst, delta);
-                si->cpu.usage.wait = _usagePercent(old_cpu_wait, cpu_wait, delta);
-        }
-
-        old_cpu_user  = cpu_user;
-        old_cpu_syst  = cpu_syst;
-        old_cpu_wait  = cpu_wait;
-        old_cpu_total = cpu_total;
         return true;
 
 error:
         si->cpu.usage.user = 0.;
         si->cpu.usage.system = 0.;
         si->cpu.usage.wait = 0.;
+        si->cpu.usage.steal = 0.;
+        si->cpu.usage.guest = 0.;
         return false;
 }
 
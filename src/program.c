@@ -0,0 +1,434 @@
+/*
+ * Copyright (C) Tildeslash Ltd. All rights reserved.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ *
+ * You must obey the GNU Affero General Public License in all respects
+ * for all of the code used other than OpenSSL.
+ */
+
+
+#include "xconfig.h"
+
+#ifdef HAVE_STDIO_H
+#include <stdio.h>
+#endif
+
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+
+#ifdef HAVE_ERRNO_H
+#include <errno.h>
+#endif
+
+#ifdef HAVE_FCNTL_H
+#include <fcntl.h>
+#endif
+
+#ifdef HAVE_POLL_H
+#include <poll.h>
+#endif
+
+#ifdef HAVE_SYS_SYSCALL_H
+#include <sys/syscall.h>
+#endif
+
+#include "monit.h"
+#include "program.h"
+
+// libmonit
+#include "system/Net.h"
+#include "system/Time.h"
+#include "util/Fmt.h"
+#include "io/InputStream.h"
+#include "exceptions/AssertException.h"
+
+
+/**
+ * Implementation of the check program supervisor.
+ *
+ * The supervisor thread keeps the list of the running programs and waits in
+ * poll(2) for the program output, the program exit and the nearest program
+ * timeout. On Linux the program exit is signalled by a process file descriptor
+ * (pidfd), on other systems the exit status is tested when the program closed
+ * its output or at least once per second. New programs are announced to the
+ * supervisor using a self-pipe, finished programs are announced to the main
+ * thread using another pipe, so the daemon sleeping in poll(2) wakes up on
+ * both the program exit and a signal.
+ *
+ * @file
+ */
+
+
+/* ----------------------------------------------------------- MARK: - Definitions */
+
+
+#define PROGRAM_POLLINTERVAL 100       /* Exit status poll interval if the pidfd is not supported [ms] */
+#define PROGRAM_MAXWAIT      1000      /* Maximum wait if the program output is open and pidfd is not supported [ms] */
+
+
+typedef struct Supervised_T {
+        Service_T service;
+        int output[2];                 /**< Program stdout and stderr descriptors, -1 on EOF */
+        int pidfd;             /**< Program process descriptor, -1 if not supported */
+        int64_t deadline;                            /**< Program timeout [ms] */
+        /** For internal use */
+        struct Supervised_T *next;              /**< next supervised program */
+} *Supervised_T;
+
+
+static struct {
+        Thread_T thread;
+        Mutex_T mutex;
+        int wakeup[2];
+        int notify[2];
+        int running;
+        bool started;
+        bool stop;
+        Supervised_T list;
+} supervisor = {.wakeup = {-1, -1}, .notify = {-1, -1}, .mutex = PTHREAD_MUTEX_INITIALIZER};
+
+
+/* ------------------------------------------------------------------ MARK: - Private */
+
+
+/**
+ * Read program output. The output is saved to StringBuffer up to Run.limits.programOutput,
+ * remaining bytes are dropped (must read whole output so the program doesn't hang on full
+ * stdout / stderr pipe). Returns false on EOF
+ */
+static bool _readOutput(int fd, StringBuffer_T S) {
+        ssize_t n;
+        char buf[STRLEN];
+        do {
+                n = read(fd, buf, sizeof(buf) - 1);
+                if (n > 0 && StringBuffer_length(S) < Run.limits.programOutput) {
+                        buf[n] = 0;
+                        StringBuffer_append(S, "%s", buf);
+                }
+        } while (n > 0 || (n < 0 && errno == EINTR));
+        return n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK);
+}
+
+
+/**
+ * Read program output using the non-blocking input stream (used if the supervisor is not running)
+ */
+static void _pollOutput(InputStream_T I, StringBuffer_T S) {
+        int n;
+        char buf[STRLEN];
+        InputStream_setTimeout(I, 0);
+        do {
+                n = InputStream_readBytes(I, buf, sizeof(buf) - 1);
+                if (n > 0 && StringBuffer_length(S) < Run.limits.programOutput) {
+                        buf[n] = 0;
+                        StringBuffer_append(S, "%s", buf);
+                }
+        } while (n > 0);
+}
+
+
+static int _pidfd(pid_t pid) {
+#if defined HAVE_SYS_SYSCALL_H && defined SYS_pidfd_open
+        int fd = (int)syscall(SYS_pidfd_open, pid, 0);
+        if (fd >= 0)
+                fcntl(fd, F_SETFD, FD_CLOEXEC);
+        return fd;
+#else
+        return -1;
+#endif
+}
+
+
+static void _signal(int fd) {
+        ssize_t n;
+        do
+                n = write(fd, "", 1);
+        while (n < 0 && errno == EINTR);
+}
+
+
+static void _drain(int fd) {
+        char buf[STRLEN];
+        while (read(fd, buf, sizeof(buf)) > 0)
+                ;
+}
+
+
+static void _closePipes(void) {
+        for (int i = 0; i < 2; i++) {
+                if (supervisor.wakeup[i] >= 0)
+                        close(supervisor.wakeup[i]);
+                if (supervisor.notify[i] >= 0)
+                        close(supervisor.notify[i]);
+                supervisor.wakeup[i] = supervisor.notify[i] = -1;
+        }
+}
+
+
+/**
+ * Collect the remaining output and mark the program as finished. The main thread is
+ * woken up to evaluate the program status
+ */
+static void _finish(Supervised_T e) {
+        Program_T P = e->service->program;
+        for (int i = 0; i < 2; i++) {
+                if (e->output[i] >= 0) {
+                        _readOutput(e->output[i], P->inprogressOutput);
+                        e->output[i] = -1;
+                }
+        }
+        if (e->pidfd >= 0) {
+                close(e->pidfd);
+                e->pidfd = -1;
+        }
+        P->finished = true;
+        supervisor.running--;
+        _signal(supervisor.notify[1]);
+}
+
+
+/**
+ * Test the program status and timeout, returns true if the program finished
+ */
+static bool _check(Supervised_T e, int64_t now, bool exited) {
+        Program_T P = e->service->program;
+        if (exited || e->pidfd < 0) {
+                if (Process_exitStatus(P->P) >= 0) {
+                        _finish(e);
+                        return true;
+                }
+        }
+        if (now >= e->deadline) {
+                LogError("'%s' program timed out after %s. Killing program with pid %ld\n", e->service->name, Fmt_ms(now - e->deadline + P->timeout, (char[11]){}), (long)Process_getPid(P->P));
+                P->timedOut = true;
+                Process_kill(P->P);
+                Process_waitFor(P->P); // Wait for child to exit to get correct exit value
+                _finish(e);
+                return true;
+        }
+        return false;
+}
+
+
+static void *_supervisorThread(void *args) {
+        set_signal_block();
+        int size = 0;
+        struct pollfd *fds = NULL;
+        LOCK(supervisor.mutex)
+        {
+                while (! supervisor.stop) {
+                        // Prepare the poll set: wakeup pipe + program stdout, stderr and pidfd
+                        int n = 1;
+                        int timeout = -1;
+                        int64_t now = Time_milli();
+                        if (size < supervisor.running * 3 + 1) {
+                                size = supervisor.running * 3 + 1;
+                                RESIZE(fds, size * sizeof(struct pollfd));
+                        }
+                        fds[0] = (struct pollfd){.fd = supervisor.wakeup[0], .events = POLLIN};
+                        for (Supervised_T e = supervisor.list; e; e = e->next) {
+                                for (int i = 0; i < 2; i++)
+                                        if (e->output[i] >= 0)
+                                                fds[n++] = (struct pollfd){.fd = e->output[i], .events = POLLIN};
+                                if (e->pidfd >= 0)
+                                        fds[n++] = (struct pollfd){.fd = e->pidfd, .events = POLLIN};
+                                int wait = (int)MAX(0, e->deadline - now);
+                                if (e->pidfd < 0)
+                                        wait = MIN(wait, e->output[0] < 0 && e->output[1] < 0 ? PROGRAM_POLLINTERVAL : PROGRAM_MAXWAIT);
+                                timeout = timeout < 0 ? wait : MIN(timeout, wait);
+                        }
+                        Mutex_unlock(supervisor.mutex);
+                        int rv = poll(fds, n, timeout);
+                        Mutex_lock(supervisor.mutex);
+                        if (rv < 0 && errno != EINTR) {
+                                LogError("Program supervisor poll failed -- %s\n", STRERROR);
+                                break;
+                        }
+                        if (fds[0].revents)
+                                _drain(supervisor.wakeup[0]);
+                        // Collect the output and test the exit status. The poll set was built from the list head, programs added meanwhile are at the list head too, so walk the list and match the descriptors
+                        now = Time_milli();
+                        for (Supervised_T *e = &supervisor.list; *e;) {
+                                bool exited = false;
+                                for (int i = 1; i < n; i++) {
+                                        if (fds[i].revents) {
+                                                if (fds[i].fd == (*e)->pidfd) {
+                                                        exited = true;
+                                                        fds[i].revents = 0;
+                                                } else {
+                                                        for (int j = 0; j < 2; j++) {
+                                                                if (fds[i].fd == (*e)->output[j]) {
+                                                                        if (! _readOutput((*e)->output[j], (*e)->service->program->inprogressOutput))
+                                                                                (*e)->output[j] = -1;
+                                                                        fds[i].revents = 0;
+                                                                }
+                                                        }
+                                                }
+                                        }
+                                }
+                                if (_check(*e, now, exited)) {
+                                        Supervised_T finished = *e;
+                                        *e = finished->next;
+                                        FREE(finished);
+                                } else {
+                                        e = &(*e)->next;
+                                }
+                        }
+                }
+        }
+        END_LOCK;
+        FREE(fds);
+        return NULL;
+}
+
+
+/* ------------------------------------------------------------------- MARK: - Public */
+
+
+void Program_start() {
+        if (! supervisor.started) {
+                if (pipe(supervisor.wakeup) < 0 || pipe(supervisor.notify) < 0) {
+                        LogError("Cannot create the program supervisor pipe -- %s\n", STRERROR);
+                        _closePipes();
+                        return;
+                }
+                for (int i = 0; i < 2; i++) {
+                        Net_setNonBlocking(supervisor.wakeup[i]);
+                        Net_setNonBlocking(supervisor.notify[i]);
+                        fcntl(supervisor.wakeup[i], F_SETFD, FD_CLOEXEC);
+                        fcntl(supervisor.notify[i], F_SETFD, FD_CLOEXEC);
+                }
+                supervisor.stop = false;
+                supervisor.started = true;
+                Thread_create(supervisor.thread, _supervisorThread, NULL);
+        }
+}
+
+
+void Program_stop() {
+        if (supervisor.started) {
+                LOCK(supervisor.mutex)
+                {
+                        supervisor.stop = true;
+                        _signal(supervisor.wakeup[1]);
+                }
+                END_LOCK;
+                Thread_join(supervisor.thread);
+                while (supervisor.list) {
+                        Supervised_T e = supervisor.list;
+                        supervisor.list = e->next;
+                        if (e->pidfd >= 0)
+                                close(e->pidfd);
+                        FREE(e);
+                }
+                supervisor.running = 0;
+                _closePipes();
+                supervisor.started = false;
+        }
+}
+
+
+bool Program_execute(Service_T s) {
+        ASSERT(s);
+        ASSERT(s->program);
+        Program_T P = s->program;
+        StringBuffer_clear(P->inprogressOutput);
+        P->finished = false;
+        P->timedOut = false;
+        if (! (P->P = Command_execute(P->C)))
+                return false;
+        P->started = Time_now();
+        if (supervisor.started) {
+                Supervised_T e;
+                NEW(e);
+                e->service = s;
+                e->output[0] = InputStream_getDescriptor(Process_getInputStream(P->P));
+                e->output[1] = InputStream_getDescriptor(Process_getErrorStream(P->P));
+                e->pidfd = _pidfd(Process_getPid(P->P));
+                e->deadline = Time_milli() + P->timeout;
+                LOCK(supervisor.mutex)
+                {
+                        e->next = supervisor.list;
+                        supervisor.list = e;
+                        supervisor.running++;
+                        _signal(supervisor.wakeup[1]);
+                }
+                END_LOCK;
+        }
+        return true;
+}
+
+
+bool Program_isFinished(Service_T s) {
+        ASSERT(s);
+        ASSERT(s->program);
+        ASSERT(s->program->P);
+        Program_T P = s->program;
+        bool finished = false;
+        if (supervisor.started) {
+                LOCK(supervisor.mutex)
+                {
+                        finished = P->finished;
+                }
+                END_LOCK;
+        } else if (! P->finished) {
+                _pollOutput(Process_getErrorStream(P->P), P->inprogressOutput);
+                _pollOutput(Process_getInputStream(P->P), P->inprogressOutput);
+                if (Process_exitStatus(P->P) < 0) {
+                        int64_t execution_time = (Time_now() - P->started) * 1000;
+                        if (execution_time > P->timeout) {
+                                LogError("'%s' program timed out after %s. Killing program with pid %ld\n", s->name, Fmt_ms(execution_time, (char[11]){}), (long)Process_getPid(P->P));
+                                P->timedOut = true;
+                                Process_kill(P->P);
+                                Process_waitFor(P->P); // Wait for child to exit to get correct exit value
+                                P->finished = true;
+                        }
+                } else {
+                        P->finished = true;
+                }
+                finished = P->finished;
+        } else {
+                finished = true;
+        }
+        return finished;
+}
+
+
+int Program_getDescriptor() {
+        return supervisor.started ? supervisor.notify[0] : -1;
+}
+
+
+void Program_acknowledge() {
+        if (supervisor.started)
+                _drain(supervisor.notify[0]);
+}
+
+
+int Program_running() {
+        int running = 0;
+        LOCK(supervisor.mutex)
+        {
+                running = supervisor.running;
+        }
+        END_LOCK;
+        return running;
+}
+
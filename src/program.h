@@ -0,0 +1,102 @@
+/*
+ * Copyright (C) Tildeslash Ltd. All rights reserved.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ *
+ * You must obey the GNU Affero General Public License in all respects
+ * for all of the code used other than OpenSSL.
+ */
+
+
+#ifndef MONIT_PROGRAM_H
+#define MONIT_PROGRAM_H
+
+
+/**
+ * Check program execution supervisor.
+ *
+ * In daemon mode a supervisor thread waits for the running check programs.
+ * It collects the program output as soon as it is written, so the program
+ * cannot block on a full stdout or stderr pipe, and detects the program exit
+ * or timeout immediately. When a program exits, the supervisor notifies the
+ * main thread using the Program_getDescriptor() descriptor, so the program
+ * status can be evaluated without waiting for the next validation cycle.
+ *
+ * If the supervisor is not running, the program output and exit status are
+ * polled when the program service is checked.
+ *
+ *  @file
+ */
+
+
+/**
+ * Start the supervisor thread
+ */
+void Program_start(void);
+
+
+/**
+ * Stop the supervisor thread. The programs which are still running are
+ * detached from the supervisor and stopped when the service is freed
+ */
+void Program_stop(void);
+
+
+/**
+ * Execute the service program
+ * @param s The program service
+ * @return true if the program was started, otherwise false
+ */
+bool Program_execute(Service_T s);
+
+
+/**
+ * Test if the service program finished. The program output and exit
+ * status is available in the Program_T object after this method returned
+ * true
+ * @param s The program service with a started program
+ * @return true if the program exited or was killed after timeout,
+ * otherwise false
+ */
+bool Program_isFinished(Service_T s);
+
+
+/**
+ * Get the program exit notification descriptor. The descriptor is readable
+ * if some supervised program finished. Use Program_acknowledge() to reset
+ * the notification
+ * @return The descriptor or -1 if the supervisor is not running
+ */
+int Program_getDescriptor(void);
+
+
+/**
+ * Reset the program exit notification
+ */
+void Program_acknowledge(void);
+
+
+/**
+ * Get the number of the running programs
+ * @return The number of programs being waited for by the supervisor
+ */
+int Program_running(void);
+
+
+#endif
+
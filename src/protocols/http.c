@@ -34,6 +34,7 @@
 #include "protocol.h"
 #include "httpstatus.h"
 #include "util/Str.h"
+#include "util/Fmt.h"
 
 // libmonit
 #include "exceptions/IOException.h"
@@ -68,27 +69,94 @@ typedef union ChecksumContext_T {
 } *ChecksumContext_T;
 
 
+/**
+ * The content test matches the body incrementally in a sliding window of at
+ * most Run.limits.httpContentBuffer bytes. When the window is full, it is
+ * tested and the last half of the data is kept as the start of the next
+ * window, so a match up to half of the window size is found even if it
+ * crosses the window boundary
+ */
+typedef struct ContentMatch_T {
+        bool matched;
+        bool sliding; // The window doesn't start at the beginning of the body
+        int length;
+        int capacity;
+        char *window;
+} *ContentMatch_T;
+
+
+/**
+ * The response body state. The number of bytes read is bounded by the
+ * Run.limits.httpContentLimit, so an endless or very large response body
+ * cannot keep the validation busy
+ */
+typedef struct Body_T {
+        bool done; // The test result is known, the rest of the body isn't needed
+        int64_t length;
+        ChecksumContext_T context;
+        ContentMatch_T match;
+} *Body_T;
+
+
+typedef void (*ProcessBody_T)(Socket_T socket, Port_T P, int *contentLength, Body_T body);
+
+
 /* --------------------------------------------------------- MARK: - Private */
 
 
-static void _contentVerify(Port_T P, const char *data) {
+static void _contentSearch(Port_T P, ContentMatch_T match, bool last) {
+        if (match->window) {
+                match->window[match->length] = 0;
+                if (regexec(P->url_request->regex, match->window, 0, NULL, (match->sliding ? REG_NOTBOL : 0) | (last ? 0 : REG_NOTEOL)) == 0)
+                        match->matched = true;
+        } else if (regexec(P->url_request->regex, "", 0, NULL, 0) == 0) {
+                // No content
+                match->matched = true;
+        }
+}
+
+
+static void _contentAppend(Port_T P, ContentMatch_T match, const char *data, int length) {
+        while (length > 0 && ! match->matched) {
+                if (match->length == match->capacity) {
+                        if (match->capacity < (int)Run.limits.httpContentBuffer) {
+                                match->capacity = MIN(MAX(match->capacity * 2, BUFSIZE), (int)Run.limits.httpContentBuffer);
+                                RESIZE(match->window, match->capacity + 1);
+                        } else {
+                                _contentSearch(P, match, false);
+                                int keep = match->capacity / 2;
+                                memmove(match->window, match->window + match->length - keep, keep);
+                                match->length = keep;
+                                match->sliding = true;
+                                continue;
+                        }
+                }
+                int n = MIN(length, match->capacity - match->length);
+                memcpy(match->window + match->length, data, n);
+                match->length += n;
+                data += n;
+                length -= n;
+        }
+}
+
+
+static void _contentVerify(Port_T P, ContentMatch_T match) {
         if (P->url_request && P->url_request->regex) {
                 bool rv = false;
                 char error[512];
-                int regex_return = regexec(P->url_request->regex, data, 0, NULL, 0);
+                if (! match->matched)
+                        _contentSearch(P, match, true);
                 switch (P->url_request->operator) {
                         case Operator_Equal:
-                                if (regex_return == 0) {
+                                if (match->matched) {
                                         rv = true;
                                         DEBUG("HTTP: Regular expression matches\n");
                                 } else {
-                                        char errbuf[STRLEN];
-                                        regerror(regex_return, NULL, errbuf, sizeof(errbuf));
-                                        snprintf(error, sizeof(error), "Regular expression doesn't match: %s", errbuf);
+                                        snprintf(error, sizeof(error), "Regular expression doesn't match");
                                 }
                                 break;
                         case Operator_NotEqual:
-                                if (regex_return == 0) {
+                                if (match->matched) {
                                         snprintf(error, sizeof(error), "Regular expression matches");
                                 } else {
                                         rv = true;
@@ -200,68 +268,90 @@ static unsigned _getChunkSize(Socket_T socket) {
 }
 
 
-static int _readDataFromSocket(Port_T P, Socket_T socket, char *data, int wantBytes) {
-        int readBytes = 0;
-        do {
-                int n = Socket_read(socket, data + readBytes, wantBytes - readBytes);
-                if (n <= 0) {
-                        THROW(ProtocolException, "HTTP error: Receiving data -- %s", STRERROR);
-                }
-                readBytes += n;
-        } while (readBytes < wantBytes);
-        if (readBytes != wantBytes) {
-                THROW(ProtocolException, "HTTP error: Content too small -- the server announced %d bytes but just %d bytes were received", wantBytes, readBytes);
-        }
-        return readBytes;
+static void _checkLimit(Body_T body, int64_t length) {
+        if (body->length + length > (int64_t)Run.limits.httpContentLimit)
+                THROW(ProtocolException, "HTTP error: Content limit exceeded -- the response body is larger than %s", Fmt_ibyte(Run.limits.httpContentLimit, (char[10]){}));
 }
 
 
-static void _readData(Socket_T socket, Port_T P, volatile char **data, int wantBytes, int *haveBytes, ChecksumContext_T context) {
-        if (P->url_request && P->url_request->regex) {
-                // The content test is required => cache the whole body
-                *data = realloc((void *)*data, *haveBytes + wantBytes + 1);
-                *haveBytes += _readDataFromSocket(P, socket, (void *)*data + *haveBytes, wantBytes);
-                _checksumAppend(P, context, (const char *)*data, wantBytes);
-                *(*data + *haveBytes) = 0;
-        } else {
-                // No content check is required => use small buffer and compute the checksum on the fly
-                *haveBytes = 0;
-                for (int readBytes = (wantBytes < BUFSIZE) ? wantBytes : BUFSIZE; *haveBytes < wantBytes; readBytes = (wantBytes - *haveBytes) < BUFSIZE ? (wantBytes - *haveBytes) : BUFSIZE) {
-                        _readDataFromSocket(P, socket, (void *)*data, readBytes);
-                        _checksumAppend(P, context, (const char *)*data, readBytes);
-                        *haveBytes += readBytes;
+/**
+ * Read the body data. If the body state is set, the checksum is computed and
+ * the content is matched on the fly directly from the socket buffer. The
+ * reading stops when the content test result is known and the rest of the
+ * body isn't needed (the checksum isn't tested and the connection isn't kept)
+ */
+static void _readData(Socket_T socket, Port_T P, int wantBytes, Body_T body) {
+        int haveBytes = 0;
+        while (haveBytes < wantBytes && ! (body && body->done)) {
+                const void *view;
+                int n = Socket_peek(socket, wantBytes - haveBytes, &view);
+                if (n <= 0)
+                        THROW(ProtocolException, "HTTP error: Content too small -- the server announced %d bytes but just %d bytes were received", wantBytes, haveBytes);
+                n = MIN(n, wantBytes - haveBytes);
+                if (body) {
+                        _checkLimit(body, n);
+                        if (body->context)
+                                _checksumAppend(P, body->context, view, n);
+                        if (body->match) {
+                                _contentAppend(P, body->match, view, n);
+                                if (body->match->matched && ! P->parameters.http.checksum && ! P->keepalive)
+                                        body->done = true;
+                        }
+                        body->length += n;
                 }
+                Socket_consume(socket, n);
+                haveBytes += n;
         }
 }
 
 
-static void _processBodyChunked(Socket_T socket, Port_T P, volatile char **data, int *contentLength, ChecksumContext_T context) {
-        char crlf[2] = {};
+static void _readTrailer(Socket_T socket) {
+        char buf[512];
+        while (Socket_readLine(socket, buf, sizeof(buf)) && ! ((buf[0] == '\r' && buf[1] == '\n') || buf[0] == '\n'))
+                ;
+}
+
+
+static void _processBodyChunked(Socket_T socket, Port_T P, int *contentLength, Body_T body) {
         int wantBytes = 0;
-        int haveBytes = 0;
-        while ((wantBytes = _getChunkSize(socket)) && haveBytes < Run.limits.httpContentBuffer) {
-                if (haveBytes + wantBytes > Run.limits.httpContentBuffer) {
-                        DEBUG("HTTP: content buffer limit exceeded -- limiting the data to %d\n", Run.limits.httpContentBuffer);
-                        wantBytes = Run.limits.httpContentBuffer - haveBytes;
-                }
-                _readData(socket, P, data, wantBytes, &haveBytes, context);
+        while (! body->done && (wantBytes = _getChunkSize(socket))) {
+                _checkLimit(body, wantBytes);
+                _readData(socket, P, wantBytes, body);
                 // Read the CRLF terminator
-                _readDataFromSocket(P, socket, crlf, 2);
+                if (! body->done)
+                        _readData(socket, P, 2, NULL);
         }
+        if (! body->done)
+                _readTrailer(socket);
 }
 
 
-static void _processBodyContentLength(Socket_T socket, Port_T P, volatile char **data, int *contentLength, ChecksumContext_T context) {
-        int haveBytes = 0;
+static void _processBodyContentLength(Socket_T socket, Port_T P, int *contentLength, Body_T body) {
         if (*contentLength < 0) {
                 THROW(ProtocolException, "HTTP error: Missing Content-Length header");
         } else if (*contentLength == 0) {
                 THROW(ProtocolException, "HTTP error: No content returned from server");
-        } else if (*contentLength > Run.limits.httpContentBuffer) {
-                DEBUG("HTTP: content buffer limit exceeded -- limiting the data to %d\n", Run.limits.httpContentBuffer);
-                *contentLength = Run.limits.httpContentBuffer;
         }
-        _readData(socket, P, data, *contentLength, &haveBytes, context);
+        _checkLimit(body, *contentLength);
+        _readData(socket, P, *contentLength, body);
+}
+
+
+/**
+ * Read and discard the response body, so the connection can be reused for the
+ * next request. The body without length (terminated by close) is left unread,
+ * the connection test will detect it and open a new connection
+ */
+static void _skipBody(Socket_T socket, Port_T P, ProcessBody_T processBody, int contentLength) {
+        struct Body_T body = {};
+        if (P->parameters.http.method == Http_Head) {
+                return;
+        } else if (processBody == _processBodyContentLength) {
+                _checkLimit(&body, contentLength);
+                _readData(socket, P, contentLength, &body);
+        } else if (processBody == _processBodyChunked) {
+                _processBodyChunked(socket, P, &contentLength, &body);
+        }
 }
 
 
@@ -279,7 +369,7 @@ static void _processStatus(Socket_T socket, Port_T P) {
 }
 
 
-static void _processHeaders(Socket_T socket, Port_T P, void (**processBody)(Socket_T socket, Port_T P, volatile char **data, int *contentLength, ChecksumContext_T context), int *contentLength) {
+static void _processHeaders(Socket_T socket, Port_T P, ProcessBody_T *processBody, int *contentLength) {
         char buf[512] = {};
 
         while (Socket_readLine(socket, buf, sizeof(buf))) {
@@ -303,38 +393,42 @@ static void _processHeaders(Socket_T socket, Port_T P, void (**processBody)(Sock
 
 /**
  * Check that the server returns a valid HTTP response as well as checksum
- * or content regex if required
+ * or content regex if required. The body is processed as it is received,
+ * the memory used by the content test is bounded by the content buffer limit
  * @param s A socket
  */
 static void _checkResponse(Socket_T socket, Port_T P) {
         int contentLength = -1;
-        void (*processBody)(Socket_T socket, Port_T P, volatile char **data, int *contentLength, ChecksumContext_T context) = NULL;
+        ProcessBody_T processBody = NULL;
 
         _processStatus(socket, P);
         _processHeaders(socket, P, &processBody, &contentLength);
         if ((P->url_request && P->url_request->regex) || P->parameters.http.checksum) {
                 if (processBody) {
                         MD_T hash = {};
-                        volatile char *data = CALLOC(1, BUFSIZE);
+                        struct ContentMatch_T match = {};
                         union ChecksumContext_T context = {};
+                        struct Body_T body = {.context = &context, .match = P->url_request && P->url_request->regex ? &match : NULL};
                         TRY
                         {
                                 // Read data
                                 _checksumInit(P, &context);
-                                processBody(socket, P, &data, &contentLength, &context);
+                                processBody(socket, P, &contentLength, &body);
                                 _checksumFinish(P, &context, hash);
                                 // Perform tests
                                 _checksumVerify(P, hash);
-                                _contentVerify(P, (char *)data);
+                                _contentVerify(P, &match);
                         }
                         FINALLY
                         {
-                                free((void *)data);
+                                FREE(match.window);
                         }
                         END_TRY;
                 } else {
                         THROW(ProtocolException, "HTTP error: uknown transfer encoding");
                 }
+        } else if (P->keepalive) {
+                _skipBody(socket, P, processBody, contentLength);
         }
 }
 
@@ -370,7 +464,7 @@ static void _sendRequest(Socket_T socket, Port_T P) {
         if (! _hasHeader(P->parameters.http.headers, "Accept-Encoding"))
                 StringBuffer_append(sb, "Accept-Encoding: identity\r\n"); // We want no compression
         if (! _hasHeader(P->parameters.http.headers, "Connection"))
-                StringBuffer_append(sb, "Connection: close\r\n");
+                StringBuffer_append(sb, "Connection: %s\r\n", P->keepalive ? "keep-alive" : "close");
         // Add headers if we have them
         if (P->parameters.http.headers) {
                 for (list_t p = P->parameters.http.headers->head; p; p = p->next) {
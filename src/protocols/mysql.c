@@ -493,11 +493,25 @@ void check_mysql(Socket_T socket) {
                         RETHROW;
         }
         END_TRY;
-        // If we're logged in, ping and quit
+        // If we're logged in, ping and quit, unless the connection is kept open
         if (mysql.state == MySQL_Ok) {
                 _requestPing(&mysql);
                 _response(&mysql);
-                _requestQuit(&mysql);
+                if (! mysql.port->keepalive)
+                        _requestQuit(&mysql);
         }
 }
 
+
+/**
+ * MySQL liveness test on an open connection: send COM_PING and expect an OK packet
+ */
+void ping_mysql(Socket_T socket) {
+        ASSERT(socket);
+        mysql_t mysql = {.state = MySQL_Ok, .socket = socket, .port = Socket_getPort(socket)};
+        _requestPing(&mysql);
+        _response(&mysql);
+        if (mysql.state != MySQL_Ok)
+                THROW(ProtocolException, "Invalid response to COM_PING");
+}
+
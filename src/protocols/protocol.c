@@ -40,7 +40,7 @@
 
 static Protocol_T protocols[] = {
         &(struct Protocol_T){"DEFAULT",         check_default},
-        &(struct Protocol_T){"HTTP",            check_http},
+        &(struct Protocol_T){"HTTP",            check_http,             check_http},
         &(struct Protocol_T){"FTP",             check_ftp},
         &(struct Protocol_T){"SMTP",            check_smtp},
         &(struct Protocol_T){"POP",             check_pop},
@@ -55,7 +55,7 @@ static Protocol_T protocols[] = {
         &(struct Protocol_T){"generic",         check_generic},
         &(struct Protocol_T){"APACHESTATUS",    check_apache_status},
         &(struct Protocol_T){"NTP3",            check_ntp3},
-        &(struct Protocol_T){"MYSQL",           check_mysql},
+        &(struct Protocol_T){"MYSQL",           check_mysql,            ping_mysql},
         &(struct Protocol_T){"DNS",             check_dns},
         &(struct Protocol_T){"POSTFIX-POLICY",  check_postfix_policy},
         &(struct Protocol_T){"TNS",             check_tns},
@@ -65,10 +65,10 @@ static Protocol_T protocols[] = {
         &(struct Protocol_T){"LMTP",            check_lmtp},
         &(struct Protocol_T){"GPS",             check_gps},
         &(struct Protocol_T){"RADIUS",          check_radius},
-        &(struct Protocol_T){"MEMCACHE",        check_memcache},
+        &(struct Protocol_T){"MEMCACHE",        check_memcache,         check_memcache},
         &(struct Protocol_T){"WEBSOCKET",       check_websocket},
-        &(struct Protocol_T){"REDIS",           check_redis},
-        &(struct Protocol_T){"MONGODB",         check_mongodb},
+        &(struct Protocol_T){"REDIS",           check_redis,            ping_redis},
+        &(struct Protocol_T){"MONGODB",         check_mongodb,          check_mongodb},
         &(struct Protocol_T){"SIEVE",           check_sieve},
         &(struct Protocol_T){"SPAMASSASSIN",    check_spamassassin},
         &(struct Protocol_T){"FAIL2BAN",        check_fail2ban}
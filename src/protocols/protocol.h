@@ -83,6 +83,7 @@ void check_ldap2(Socket_T);
 void check_ldap3(Socket_T);
 void check_mongodb(Socket_T);
 void check_mysql(Socket_T);
+void ping_mysql(Socket_T);
 void check_nntp(Socket_T);
 void check_ntp3(Socket_T);
 void check_postfix_policy(Socket_T);
@@ -92,6 +93,7 @@ void check_smtp(Socket_T);
 void check_spamassassin(Socket_T);
 void check_ssh(Socket_T);
 void check_redis(Socket_T);
+void ping_redis(Socket_T);
 void check_rdate(Socket_T);
 void check_rsync(Socket_T);
 void check_tns(Socket_T);
@@ -39,13 +39,23 @@
  *
  *     1. send a PING command
  *     2. expect a PONG response
- *     3. send a QUIT command
+ *     3. send a QUIT command, unless the connection is kept open
  *
  * @see http://redis.io/topics/protocol
  *
  * @file
  */
 void check_redis(Socket_T socket) {
+        ASSERT(socket);
+        ping_redis(socket);
+        Port_T P = Socket_getPort(socket);
+        if (! (P && P->keepalive))
+                if (Socket_print(socket, "*1\r\n$4\r\nQUIT\r\n") < 0)
+                        THROW(IOException, "REDIS: QUIT command error -- %s", STRERROR);
+}
+
+
+void ping_redis(Socket_T socket) {
         ASSERT(socket);
         char buf[STRLEN];
 
@@ -56,7 +66,5 @@ void check_redis(Socket_T socket) {
         Str_chomp(buf);
         if (! Str_isEqual(buf, "+PONG") && ! Str_startsWith(buf, "-NOAUTH")) // We accept authentication error (-NOAUTH Authentication required): redis responded to request, but requires authentication => we assume it works
                 THROW(ProtocolException, "REDIS: PING error -- %s", buf);
-        if (Socket_print(socket, "*1\r\n$4\r\nQUIT\r\n") < 0)
-                THROW(IOException, "REDIS: QUIT command error -- %s", STRERROR);
 }
 
@@ -0,0 +1,128 @@
+/*
+ * Copyright (C) Tildeslash Ltd. All rights reserved.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ *
+ * You must obey the GNU Affero General Public License in all respects
+ * for all of the code used other than OpenSSL.  
+ */
+
+
+#include "xconfig.h"
+
+#include <stdint.h>
+
+#ifdef HAVE_STRING_H
+#include <string.h>
+#endif
+
+#include "monit.h"
+
+#include "Histogram.h"
+
+
+/**
+ * Histogram
+ *
+ * @author http://www.tildeslash.com/
+ * @see http://www.mmonit.com/
+ * @file
+ */
+
+
+/* ----------------------------------------------------- MARK: - Definitions */
+
+
+#define T Histogram_T
+
+
+/* --------------------------------------------------------- MARK: - Private */
+
+
+static int _index(uint64_t value) {
+        if (value < 4)
+                return (int)value;
+        if (value >> 40)
+                return HISTOGRAM_BUCKETS - 1;
+        int magnitude = 2;
+        while (value >> (magnitude + 1))
+                magnitude++;
+        return (magnitude - 1) * 4 + (int)((value >> (magnitude - 2)) & 3);
+}
+
+
+static uint64_t _upperBound(int index) {
+        if (index < 4)
+                return index;
+        int magnitude = index / 4 + 1;
+        return ((4ULL + index % 4 + 1) << (magnitude - 2)) - 1;
+}
+
+
+/* ---------------------------------------------------------- MARK: - Public */
+
+
+void Histogram_record(T H, uint64_t value) {
+        H->bucket[_index(value)]++;
+        H->count++;
+        H->sum += value;
+        if (value > H->max)
+                H->max = value;
+}
+
+
+void Histogram_reset(T H) {
+        memset(H, 0, sizeof(*H));
+}
+
+
+uint64_t Histogram_count(T H) {
+        return H->count;
+}
+
+
+uint64_t Histogram_sum(T H) {
+        return H->sum;
+}
+
+
+uint64_t Histogram_max(T H) {
+        return H->max;
+}
+
+
+double Histogram_mean(T H) {
+        return H->count ? (double)H->sum / (double)H->count : 0.;
+}
+
+
+uint64_t Histogram_percentile(T H, double percentile) {
+        if (! H->count)
+                return 0ULL;
+        uint64_t rank = (uint64_t)(percentile / 100. * (double)H->count + 0.5);
+        if (rank < 1)
+                rank = 1;
+        uint64_t total = 0ULL;
+        for (int i = 0; i < HISTOGRAM_BUCKETS; i++) {
+                total += H->bucket[i];
+                if (total >= rank)
+                        return i < HISTOGRAM_BUCKETS - 1 ? MIN(_upperBound(i), H->max) : H->max;
+        }
+        return H->max;
+}
+
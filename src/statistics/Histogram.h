@@ -0,0 +1,114 @@
+/*
+ * Copyright (C) Tildeslash Ltd. All rights reserved.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ *
+ * You must obey the GNU Affero General Public License in all respects
+ * for all of the code used other than OpenSSL.  
+ */
+
+#ifndef HISTOGRAM_INCLUDED
+#define HISTOGRAM_INCLUDED
+
+
+/**
+ * Histogram of durations with a logarithmic bucket layout: values are
+ * grouped by the power of two and every power of two range is divided
+ * into four linear sub-buckets, so the recorded value precision is
+ * better than 25% for the whole range. The histogram has a fixed size
+ * and recording a value is O(1).
+ *
+ * @author http://www.tildeslash.com/
+ * @see http://www.mmonit.com/
+ * @file
+ */
+
+
+#define T Histogram_T
+
+
+#define HISTOGRAM_BUCKETS 156 /* 4 sub-buckets for each power of two up to 2^40 */
+
+
+typedef struct T {
+        uint64_t count;
+        uint64_t sum;
+        uint64_t max;
+        uint32_t bucket[HISTOGRAM_BUCKETS];
+} *T;
+
+
+/**
+ * Record the value
+ * @param H A Histogram object
+ * @param value The value to record
+ */
+void Histogram_record(T H, uint64_t value);
+
+
+/**
+ * Reset Histogram object
+ * @param H A Histogram object
+ */
+void Histogram_reset(T H);
+
+
+/**
+ * Return the number of recorded values
+ * @param H A Histogram object
+ * @return the number of values
+ */
+uint64_t Histogram_count(T H);
+
+
+/**
+ * Return the sum of recorded values
+ * @param H A Histogram object
+ * @return the sum of values
+ */
+uint64_t Histogram_sum(T H);
+
+
+/**
+ * Return the maximum recorded value
+ * @param H A Histogram object
+ * @return the maximum value
+ */
+uint64_t Histogram_max(T H);
+
+
+/**
+ * Return the mean of recorded values
+ * @param H A Histogram object
+ * @return the mean value or 0 if no value was recorded
+ */
+double Histogram_mean(T H);
+
+
+/**
+ * Return the value at the given percentile. The result is the upper
+ * bound of the bucket which contains the percentile.
+ * @param H A Histogram object
+ * @param percentile The percentile in the range 0-100
+ * @return the value at percentile or 0 if no value was recorded
+ */
+uint64_t Histogram_percentile(T H, double percentile);
+
+
+#undef T
+#endif
@@ -119,6 +119,7 @@
 #include "event.h"
 #include "state.h"
 #include "protocol.h"
+#include "pressure.h"
 
 // libmonit
 #include "io/File.h"
@@ -135,6 +136,17 @@ struct ad_user {
 };
 
 
+#define SERVICEINDEX_SIZE 64
+
+
+/* Service name index (hash table with buckets chained via Service_T.next_hash) */
+static struct {
+        int size;
+        int count;
+        Service_T *table;
+} serviceIndex = {};
+
+
 /* Unsafe URL characters: [00-1F, 7F-FF] <>\"#%}{|\\^[] ` */
 static const unsigned char urlunsafe[256] = {
         1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
@@ -244,6 +256,25 @@ static char _x2c(char *hex) {
 }
 
 
+/**
+ * Grow the service name index to the given number of buckets and rehash
+ */
+static void _resizeServiceIndex(int size) {
+        Service_T *table = CALLOC(size, sizeof(Service_T));
+        for (int i = 0; i < serviceIndex.size; i++) {
+                for (Service_T s = serviceIndex.table[i], next; s; s = next) {
+                        next = s->next_hash;
+                        unsigned int bucket = Str_hash(s->name) % size;
+                        s->next_hash = table[bucket];
+                        table[bucket] = s;
+                }
+        }
+        FREE(serviceIndex.table);
+        serviceIndex.table = table;
+        serviceIndex.size = size;
+}
+
+
 /**
  * Print registered events list
  */
@@ -764,19 +795,35 @@ void Util_hmacMD5(const unsigned char *data, int datalen, const unsigned char *k
 
 Service_T Util_getService(const char *name) {
         ASSERT(name);
-        for (Service_T s = servicelist; s; s = s->next)
-                if (IS(s->name, name))
-                        return s;
+        if (serviceIndex.table)
+                for (Service_T s = serviceIndex.table[Str_hash(name) % serviceIndex.size]; s; s = s->next_hash)
+                        if (IS(s->name, name))
+                                return s;
         return NULL;
 }
 
 
+void Util_indexService(Service_T s) {
+        ASSERT(s);
+        ASSERT(s->name);
+        if (serviceIndex.count >= serviceIndex.size * 3 / 4)
+                _resizeServiceIndex(serviceIndex.size ? serviceIndex.size * 2 : SERVICEINDEX_SIZE);
+        unsigned int bucket = Str_hash(s->name) % serviceIndex.size;
+        s->next_hash = serviceIndex.table[bucket];
+        serviceIndex.table[bucket] = s;
+        serviceIndex.count++;
+}
+
+
+void Util_resetServiceIndex() {
+        FREE(serviceIndex.table);
+        serviceIndex.size = 0;
+        serviceIndex.count = 0;
+}
+
+
 int Util_getNumberOfServices() {
-        int i = 0;
-        Service_T s;
-        for (s = servicelist; s; s = s->next)
-                i += 1;
-        return i;
+        return serviceIndex.count;
 }
 
 
@@ -804,8 +851,12 @@ void Util_printRunList() {
         printf(" %-18s =   sendExpectBuffer:  %s\n", " ", Fmt_ibyte(Run.limits.sendExpectBuffer, buf));
         printf(" %-18s =   fileContentBuffer: %s\n", " ", Fmt_ibyte(Run.limits.fileContentBuffer, buf));
         printf(" %-18s =   httpContentBuffer: %s\n", " ", Fmt_ibyte(Run.limits.httpContentBuffer, buf));
+        printf(" %-18s =   httpContentLimit:  %s\n", " ", Fmt_ibyte(Run.limits.httpContentLimit, buf));
         printf(" %-18s =   networkTimeout:    %s\n", " ", Fmt_ms(Run.limits.networkTimeout, (char[11]){}));
         printf(" %-18s =   programTimeout:    %s\n", " ", Fmt_ms(Run.limits.programTimeout, (char[11]){}));
+        printf(" %-18s =   programConcurrency: %u\n", " ", Run.limits.programConcurrency);
+        printf(" %-18s =   probeCache:        %s\n", " ", Fmt_ms(Run.limits.probeCache, (char[11]){}));
+        printf(" %-18s =   cycleBudget:       %s\n", " ", Fmt_ms(Run.limits.cycleBudget, (char[11]){}));
         printf(" %-18s =   stopTimeout:       %s\n", " ", Fmt_ms(Run.limits.stopTimeout, (char[11]){}));
         printf(" %-18s =   startTimeout:      %s\n", " ", Fmt_ms(Run.limits.startTimeout, (char[11]){}));
         printf(" %-18s =   restartTimeout:    %s\n", " ", Fmt_ms(Run.limits.restartTimeout, (char[11]){}));
@@ -958,6 +1009,8 @@ void Util_printService(Service_T s) {
                         printf(" %-20s = %s\n", "Match", s->path);
                 else
                         printf(" %-20s = %s\n", "Pid file", s->path);
+                if (s->inf.process->cgroup.enabled)
+                        printf(" %-20s = %s\n", "Accounting", "cgroup");
         } else if (s->type == Service_Host) {
                 printf(" %-20s = %s\n", "Address", s->path);
         } else if (s->type == Service_Net) {
@@ -967,6 +1020,7 @@ void Util_printService(Service_T s) {
         }
         printf(" %-20s = %s\n", "Monitoring mode", modenames[s->mode]);
         printf(" %-20s = %s\n", "On reboot", onrebootnames[s->onreboot]);
+        printf(" %-20s = %s\n", "Priority", prioritynames[s->priority]);
         if (s->start) {
                 printf(" %-20s = '%s'", "Start program", Util_commandDescription(s->start, (char[STRLEN]){}));
                 if (s->start->has_uid)
@@ -1285,6 +1339,18 @@ void Util_printService(Service_T s) {
                                 printf(" %-20s = ", "CPU wait limit");
                                 break;
 
+                        case Resource_CpuSteal:
+                                printf(" %-20s = ", "CPU steal limit");
+                                break;
+
+                        case Resource_CpuGuest:
+                                printf(" %-20s = ", "CPU guest limit");
+                                break;
+
+                        case Resource_CpuCore:
+                                printf(" %-20s = ", "CPU core limit");
+                                break;
+
                         case Resource_MemoryPercent:
                                 printf(" %-20s = ", "Memory usage limit");
                                 break;
@@ -1345,6 +1411,18 @@ void Util_printService(Service_T s) {
                                 printf(" %-20s = ", "Disk write limit");
                                 break;
 
+                        case Resource_CpuPressure:
+                                printf(" %-20s = ", "CPU pressure limit");
+                                break;
+
+                        case Resource_MemoryPressure:
+                                printf(" %-20s = ", "Memory pressure limit");
+                                break;
+
+                        case Resource_IoPressure:
+                                printf(" %-20s = ", "IO pressure limit");
+                                break;
+
                         default:
                                 break;
                 }
@@ -1355,6 +1433,9 @@ void Util_printService(Service_T s) {
                         case Resource_CpuUser:
                         case Resource_CpuSystem:
                         case Resource_CpuWait:
+                        case Resource_CpuSteal:
+                        case Resource_CpuGuest:
+                        case Resource_CpuCore:
                         case Resource_MemoryPercent:
                         case Resource_SwapPercent:
                                 printf("%s", StringBuffer_toString(Util_printRule(buf, o->action, "if %s %.1f%%", operatornames[o->operator], o->limit)));
@@ -1387,6 +1468,12 @@ void Util_printService(Service_T s) {
                                 printf("%s", StringBuffer_toString(Util_printRule(buf, o->action, "if %s %.0f operations/s", operatornames[o->operator], o->limit)));
                                 break;
 
+                        case Resource_CpuPressure:
+                        case Resource_MemoryPressure:
+                        case Resource_IoPressure:
+                                printf("%s", StringBuffer_toString(Util_printRule(buf, o->action, "if %s %s %s %.1f%%", o->pressure.full ? "full" : "some", pressurewindownames[o->pressure.window], operatornames[o->operator], o->limit)));
+                                break;
+
                         default:
                                 break;
                 }
@@ -1399,6 +1486,8 @@ void Util_printService(Service_T s) {
                 printf(" %-20s = Check service every %s\n", "Every", s->every.spec.cron);
         else if (s->every.type == Every_NotInCron)
                 printf(" %-20s = Don't check service every %s\n", "Every", s->every.spec.cron);
+        else if (s->every.type == Every_Adaptive)
+                printf(" %-20s = Check service adaptively, at least every %d cycles\n", "Every", s->every.spec.adaptive.maximum);
 
         for (ActionRate_T o = s->actionratelist; o; o = o->next) {
                 StringBuffer_clear(buf);
@@ -1709,6 +1798,7 @@ void Util_resetInfo(Service_T s) {
                         Statistics_reset(&(s->inf.filesystem->time.run));
                         break;
                 case Service_File:
+                        s->changed = true; // Don't reuse the reset data
                         s->inf.file->size  = -1;
                         s->inf.file->readpos = 0;
                         s->inf.file->inode = 0;
@@ -1722,6 +1812,7 @@ void Util_resetInfo(Service_T s) {
                         *s->inf.file->cs_sum = 0;
                         break;
                 case Service_Directory:
+                        s->changed = true;
                         s->inf.directory->mode = -1;
                         s->inf.directory->uid = -1;
                         s->inf.directory->gid = -1;
@@ -1730,6 +1821,7 @@ void Util_resetInfo(Service_T s) {
                         s->inf.directory->timestamp.modify = 0;
                         break;
                 case Service_Fifo:
+                        s->changed = true;
                         s->inf.fifo->mode = -1;
                         s->inf.fifo->uid = -1;
                         s->inf.fifo->gid = -1;
@@ -1738,6 +1830,7 @@ void Util_resetInfo(Service_T s) {
                         s->inf.fifo->timestamp.modify = 0;
                         break;
                 case Service_Process:
+                case Service_Cgroup:
                         s->inf.process->_pid = -1;
                         s->inf.process->_ppid = -1;
                         s->inf.process->pid = -1;
@@ -1758,6 +1851,10 @@ void Util_resetInfo(Service_T s) {
                         *(s->inf.process->secattr) = 0;
                         _resetIOStatistics(&(s->inf.process->read));
                         _resetIOStatistics(&(s->inf.process->write));
+                        s->inf.process->cgroup.time = 0;
+                        Pressure_reset(&(s->inf.process->pressure.cpu));
+                        Pressure_reset(&(s->inf.process->pressure.memory));
+                        Pressure_reset(&(s->inf.process->pressure.io));
                         break;
                 case Service_Net:
                         if (s->inf.net->stats)
@@ -1874,11 +1971,21 @@ void Util_monitorUnset(Service_T s) {
         }
         s->nstart = 0;
         s->ncycle = 0;
-        if (s->every.type == Every_SkipCycles)
+        if (s->every.type == Every_SkipCycles) {
                 s->every.spec.cycle.counter = 0;
+        } else if (s->every.type == Every_Adaptive) {
+                s->every.spec.adaptive.interval = 1;
+                s->every.spec.adaptive.counter = 0;
+        }
         s->error = Event_Null;
-        if (s->eventlist)
-                gc_event(&s->eventlist);
+        Event_clear(s);
+        // Close the connections kept open by the protocol tests
+        for (Port_T p = s->portlist; p; p = p->next)
+                if (p->connection)
+                        Socket_free(&p->connection);
+        for (Port_T p = s->socketlist; p; p = p->next)
+                if (p->connection)
+                        Socket_free(&p->connection);
         Util_resetInfo(s);
         State_dirty();
 }
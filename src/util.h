@@ -131,6 +131,21 @@ void Util_hmacMD5(const unsigned char *data, int datalen, const unsigned char *k
 Service_T Util_getService(const char *name);
 
 
+/**
+ * Add the service to the service name index used by Util_getService().
+ * The parser calls this method for every service added to the servicelist.
+ * @param s A Service_T object
+ */
+void Util_indexService(Service_T s);
+
+
+/**
+ * Drop the service name index. Must be called when the servicelist
+ * is released.
+ */
+void Util_resetServiceIndex(void);
+
+
 /**
  * @param name A service name as stated in the config file
  * @return true if the service name exist in the
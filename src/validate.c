@@ -77,6 +77,10 @@
 #include <time.h>
 #endif
 
+#ifdef HAVE_SYS_RESOURCE_H
+#include <sys/resource.h>
+#endif
+
 #ifdef HAVE_NETINET_IN_SYSTM_H
 #include <netinet/in_systm.h>
 #endif
@@ -101,7 +105,12 @@
 #include "net.h"
 #include "device.h"
 #include "ProcessTree.h"
+#include "Cgroup.h"
 #include "protocol.h"
+#include "program.h"
+#include "watch.h"
+#include "probe.h"
+#include "pressure.h"
 
 // libmonit
 #include "system/Time.h"
@@ -121,21 +130,42 @@
 
 
 /**
- * Read program output. The output is saved to StringBuffer up to Run.limits.programOutput,
- * remaining bytes are dropped (must read whole output so the program doesn't hang on full
- * stdout / stderr pipe).
+ * Evaluate the exit status of the finished program against the status tests
  */
-static void _programOutput(InputStream_T I, StringBuffer_T S) {
-        int n;
-        char buf[STRLEN];
-        InputStream_setTimeout(I, 0);
-        do {
-                n = InputStream_readBytes(I, buf, sizeof(buf) - 1);
-                if (n > 0 && StringBuffer_length(S) < Run.limits.programOutput) {
-                        buf[n] = 0;
-                        StringBuffer_append(S, "%s", buf);
-                }
-        } while (n > 0);
+static State_Type _checkProgramStatus(Service_T s) {
+        State_Type rv = s->program->timedOut ? State_Failed : State_Succeeded;
+        Process_T P = s->program->P;
+        s->program->exitStatus = Process_exitStatus(P); // Save exit status for web-view display
+        StringBuffer_trim(s->program->inprogressOutput);
+        // Swap program output (instance finished)
+        StringBuffer_clear(s->program->lastOutput);
+        StringBuffer_append(s->program->lastOutput, "%s", StringBuffer_toString(s->program->inprogressOutput));
+        // Evaluate program's exit status against our status checks.
+        const char *output = StringBuffer_length(s->program->inprogressOutput) ? StringBuffer_toString(s->program->inprogressOutput) : "no output";
+        for (Status_T status = s->statuslist; status; status = status->next) {
+                if (status->operator == Operator_Changed) {
+                        if (status->initialized) {
+                                if (Util_evalQExpression(status->operator, s->program->exitStatus, status->return_value)) {
+                                        Event_post(s, Event_Status, State_Changed, status->action, "status changed (%d -> %d) -- %s", status->return_value, s->program->exitStatus, output);
+                                        status->return_value = s->program->exitStatus;
+                                } else {
+                                        Event_post(s, Event_Status, State_ChangedNot, status->action, "status didn't change (%d) -- %s", s->program->exitStatus, output);
+                                }
+                        } else {
+                                status->initialized = true;
+                                status->return_value = s->program->exitStatus;
+                        }
+                } else {
+                        if (Util_evalQExpression(status->operator, s->program->exitStatus, status->return_value)) {
+                                rv = State_Failed;
+                                Event_post(s, Event_Status, State_Failed, status->action, "status failed (%d) -- %s", s->program->exitStatus, output);
+                        } else {
+                                Event_post(s, Event_Status, State_Succeeded, status->action, "status succeeded (%d) -- %s", s->program->exitStatus, output);
+                        }
+                }
+        }
+        Process_free(&s->program->P);
+        return rv;
 }
 
 
@@ -152,9 +182,12 @@ static State_Type _checkConnection(Service_T s, Port_T p) {
 retry:
         TRY
         {
-                Socket_test(p);
+                Probe_test(p, retry_count == p->retry); // The retry tests the port again
                 rv = State_Succeeded;
-                DEBUG("'%s' succeeded testing protocol [%s] at %s [response time %s]\n", s->name, p->protocol->name, Util_portDescription(p, buf, sizeof(buf)), Fmt_ms(p->response, (char[11]){}));
+                if (p->keepalive)
+                        DEBUG("'%s' succeeded testing protocol [%s] at %s [response time %s, connect time %s]\n", s->name, p->protocol->name, Util_portDescription(p, buf, sizeof(buf)), Fmt_ms(p->response, (char[11]){}), p->connect > 0. ? Fmt_ms(p->connect, (char[11]){}) : "reused");
+                else
+                        DEBUG("'%s' succeeded testing protocol [%s] at %s [response time %s]\n", s->name, p->protocol->name, Util_portDescription(p, buf, sizeof(buf)), Fmt_ms(p->response, (char[11]){}));
         }
         ELSE
         {
@@ -233,6 +266,44 @@ static State_Type _checkProcessPpid(Service_T s) {
 }
 
 
+/**
+ * Check the pressure stall of the system or cgroup
+ */
+static State_Type _checkPressure(Service_T s, Resource_T r, Pressure_T cpu, Pressure_T memory, Pressure_T io) {
+        ASSERT(s);
+        ASSERT(r);
+        Pressure_T pressure;
+        const char *name;
+        switch (r->resource_id) {
+                case Resource_CpuPressure:
+                        pressure = cpu;
+                        name = "cpu";
+                        break;
+                case Resource_MemoryPressure:
+                        pressure = memory;
+                        name = "memory";
+                        break;
+                default:
+                        pressure = io;
+                        name = "io";
+                        break;
+        }
+        State_Type rv = State_Succeeded;
+        const char *kind = r->pressure.full ? "full" : "some";
+        float value = (r->pressure.full ? pressure->full : pressure->some)[r->pressure.window];
+        if (value < 0.) {
+                DEBUG("'%s' %s pressure check skipped (pressure stall information not available)\n", s->name, name);
+                return State_Init;
+        } else if (Util_evalDoubleQExpression(r->operator, value, r->limit)) {
+                rv = State_Failed;
+                Event_post(s, Event_Resource, rv, r->action, "%s pressure %s %s of %.1f%% matches resource limit [%s pressure %s %s %s %.1f%%]", name, kind, pressurewindownames[r->pressure.window], value, name, kind, pressurewindownames[r->pressure.window], operatorshortnames[r->operator], r->limit);
+        } else {
+                Event_post(s, Event_Resource, rv, r->action, "%s pressure check succeeded [current %s pressure %s %s = %.1f%%]", name, name, kind, pressurewindownames[r->pressure.window], value);
+        }
+        return rv;
+}
+
+
 /**
  * Check process resources
  */
@@ -398,6 +469,11 @@ static State_Type _checkProcessResources(Service_T s, Resource_T r) {
                         }
                         break;
 
+                case Resource_CpuPressure:
+                case Resource_MemoryPressure:
+                case Resource_IoPressure:
+                        return _checkPressure(s, r, &(s->inf.process->pressure.cpu), &(s->inf.process->pressure.memory), &(s->inf.process->pressure.io));
+
                 default:
                         LogError("'%s' error -- unknown resource ID: [%d]\n", s->name, r->resource_id);
                         return State_Failed;
@@ -469,6 +545,56 @@ static State_Type _checkSystemResources(Service_T s, Resource_T r) {
                         }
                         break;
 
+                case Resource_CpuSteal:
+                        if (systeminfo.cpu.usage.steal < 0.) {
+                                DEBUG("'%s' cpu steal usage check skipped (initializing)\n", s->name);
+                                return State_Init;
+                        } else if (Util_evalDoubleQExpression(r->operator, systeminfo.cpu.usage.steal, r->limit)) {
+                                rv = State_Failed;
+                                snprintf(report, STRLEN, "cpu steal usage of %.1f%% matches resource limit [cpu steal usage %s %.1f%%]", systeminfo.cpu.usage.steal, operatorshortnames[r->operator], r->limit);
+                        } else {
+                                snprintf(report, STRLEN, "cpu steal usage check succeeded [current cpu steal usage = %.1f%%]", systeminfo.cpu.usage.steal);
+                        }
+                        break;
+
+                case Resource_CpuGuest:
+                        if (systeminfo.cpu.usage.guest < 0.) {
+                                DEBUG("'%s' cpu guest usage check skipped (initializing)\n", s->name);
+                                return State_Init;
+                        } else if (Util_evalDoubleQExpression(r->operator, systeminfo.cpu.usage.guest, r->limit)) {
+                                rv = State_Failed;
+                                snprintf(report, STRLEN, "cpu guest usage of %.1f%% matches resource limit [cpu guest usage %s %.1f%%]", systeminfo.cpu.usage.guest, operatorshortnames[r->operator], r->limit);
+                        } else {
+                                snprintf(report, STRLEN, "cpu guest usage check succeeded [current cpu guest usage = %.1f%%]", systeminfo.cpu.usage.guest);
+                        }
+                        break;
+
+                case Resource_CpuCore:
+                        {
+                                // The test fails if any core matches the limit, the highest usage is reported otherwise
+                                int core = -1, highest = -1;
+                                for (int i = 0; i < systeminfo.cpu.core.count; i++) {
+                                        if (systeminfo.cpu.core.usage[i] >= 0.) {
+                                                if (Util_evalDoubleQExpression(r->operator, systeminfo.cpu.core.usage[i], r->limit)) {
+                                                        core = i;
+                                                        break;
+                                                }
+                                                if (highest < 0 || systeminfo.cpu.core.usage[i] > systeminfo.cpu.core.usage[highest])
+                                                        highest = i;
+                                        }
+                                }
+                                if (core >= 0) {
+                                        rv = State_Failed;
+                                        snprintf(report, STRLEN, "cpu core %d usage of %.1f%% matches resource limit [cpu core usage %s %.1f%%]", core, systeminfo.cpu.core.usage[core], operatorshortnames[r->operator], r->limit);
+                                } else if (highest < 0) {
+                                        DEBUG("'%s' cpu core usage check skipped (initializing)\n", s->name);
+                                        return State_Init;
+                                } else {
+                                        snprintf(report, STRLEN, "cpu core usage check succeeded [highest cpu core usage = %.1f%% on core %d]", systeminfo.cpu.core.usage[highest], highest);
+                                }
+                        }
+                        break;
+
                 case Resource_MemoryPercent:
                         if (Util_evalDoubleQExpression(r->operator, systeminfo.memory.usage.percent, r->limit)) {
                                 rv = State_Failed;
@@ -534,6 +660,11 @@ static State_Type _checkSystemResources(Service_T s, Resource_T r) {
                         }
                         break;
 
+                case Resource_CpuPressure:
+                case Resource_MemoryPressure:
+                case Resource_IoPressure:
+                        return _checkPressure(s, r, &(systeminfo.pressure.cpu), &(systeminfo.pressure.memory), &(systeminfo.pressure.io));
+
                 default:
                         LogError("'%s' error -- unknown resource ID: [%d]\n", s->name, r->resource_id);
                         return State_Failed;
@@ -546,13 +677,14 @@ static State_Type _checkSystemResources(Service_T s, Resource_T r) {
 /**
  * Test for associated path checksum change
  */
-static State_Type _checkChecksum(Service_T s) {
+static State_Type _checkChecksum(Service_T s, bool changed) {
         ASSERT(s);
         ASSERT(s->path);
         State_Type rv = State_Succeeded;
         if (s->checksum) {
                 Checksum_T cs = s->checksum;
-                if (Util_getChecksum(s->path, cs->type, s->inf.file->cs_sum, sizeof(s->inf.file->cs_sum))) {
+                // If the file didn't change, reuse the checksum computed last time
+                if ((! changed && *s->inf.file->cs_sum) || Util_getChecksum(s->path, cs->type, s->inf.file->cs_sum, sizeof(s->inf.file->cs_sum))) {
                         Event_post(s, Event_Data, State_Succeeded, s->action_DATA, "checksum %s", s->inf.file->cs_sum);
                         if (! cs->initialized) {
                                 cs->initialized = true;
@@ -591,6 +723,7 @@ static State_Type _checkChecksum(Service_T s) {
                         }
                         return rv;
                 }
+                *s->inf.file->cs_sum = 0;
                 Event_post(s, Event_Data, State_Failed, s->action_DATA, "cannot compute checksum for %s", s->path);
                 return State_Failed;
         }
@@ -861,11 +994,7 @@ static State_Type _checkMatch(Service_T s) {
          */
         State_Type rv = State_Succeeded;
         if (s->matchlist) {
-                FILE *file = fopen(s->path, "r");
-                if (! file) {
-                        LogError("'%s' cannot open file %s: %s\n", s->name, s->path, STRERROR);
-                        return State_Failed;
-                }
+                FILE *file = NULL;
                 /* FIXME: Refactor: Initialize the filesystems table ahead of file and filesystems test and index it by device id + replace the Str_startsWith() with lookup to the table by device id (obtained via file's stat()).
                  The central filesystems initialization will allow to reduce the statfs() calls in the case that there will be multiple file and/or filesystems tests for the same fs. Temporarily we go with
                  dummy Str_startsWith() as quick fix which will cover 99.9% of use cases without rising the statfs overhead if statfs call would be inlined here.
@@ -882,6 +1011,10 @@ static State_Type _checkMatch(Service_T s) {
                                 goto final1;
                         }
                 }
+                if (! (file = fopen(s->path, "r"))) {
+                        LogError("'%s' cannot open file %s: %s\n", s->name, s->path, STRERROR);
+                        return State_Failed;
+                }
                 char *line = CALLOC(sizeof(unsigned char), Run.limits.fileContentBuffer);
                 while (true) {
 next:
@@ -950,7 +1083,7 @@ next:
 final2:
                 FREE(line);
 final1:
-                if (fclose(file)) {
+                if (file && fclose(file)) {
                         rv = State_Failed;
                         LogError("'%s' cannot close file %s: %s\n", s->name, s->path, STRERROR);
                 }
@@ -1204,13 +1337,48 @@ static bool _incron(Service_T s, time_t now) {
 }
 
 
+/**
+ * Returns the CPU time used by the calling thread in microseconds
+ */
+static uint64_t _cpuTime() {
+#ifdef CLOCK_THREAD_CPUTIME_ID
+        struct timespec t;
+        if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &t) == 0)
+                return (uint64_t)t.tv_sec * 1000000ULL + t.tv_nsec / 1000;
+#endif
+        struct rusage usage;
+        if (getrusage(RUSAGE_SELF, &usage) == 0)
+                return (uint64_t)(usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1000000ULL + usage.ru_utime.tv_usec + usage.ru_stime.tv_usec;
+        return 0ULL;
+}
+
+
+/**
+ * Run the service check and record the check wall and CPU time
+ */
+static State_Type _check(Service_T s) {
+        int64_t wall = Time_micro();
+        uint64_t cpu = _cpuTime();
+        State_Type state = s->check(s);
+        cpu = _cpuTime() - cpu;
+        wall = MAX(0, Time_micro() - wall);
+        Histogram_record(&(s->profile.wall), wall);
+        Histogram_record(&(s->profile.cpu), cpu);
+        Histogram_record(&(Run.profile.check[s->type]), wall);
+        return state;
+}
+
+
 /**
  * Returns true if validation should be skiped for this service in this cycle, otherwise false. Handle every statement
  */
 static bool _checkSkip(Service_T s) {
         ASSERT(s);
         time_t now = Time_now();
-        if (s->every.type == Every_SkipCycles) {
+        if (s->deferral.pending && s->every.type != Every_Cron && s->every.type != Every_NotInCron) {
+                // The deferred check is due, the cron spec is evaluated again as the current time may be out of the cron window
+                DEBUG("'%s' test was deferred in the previous cycle -- checking now\n", s->name);
+        } else if (s->every.type == Every_SkipCycles) {
                 s->every.spec.cycle.counter++;
                 if (s->every.spec.cycle.counter < s->every.spec.cycle.number) {
                         s->monitor |= Monitor_Waiting;
@@ -1218,6 +1386,14 @@ static bool _checkSkip(Service_T s) {
                         return true;
                 }
                 s->every.spec.cycle.counter = 0;
+        } else if (s->every.type == Every_Adaptive) {
+                s->every.spec.adaptive.counter++;
+                if (s->every.spec.adaptive.counter < s->every.spec.adaptive.interval) {
+                        s->monitor |= Monitor_Waiting;
+                        DEBUG("'%s' test skipped as current cycle (%d) < adaptive interval (%d)\n", s->name, s->every.spec.adaptive.counter, s->every.spec.adaptive.interval);
+                        return true;
+                }
+                s->every.spec.adaptive.counter = 0;
         } else if (s->every.type == Every_Cron && ! _incron(s, now)) {
                 s->monitor |= Monitor_Waiting;
                 DEBUG("'%s' test skipped as current time (%lld) does not match every's cron spec \"%s\"\n", s->name, (int64_t)now, s->every.spec.cron);
@@ -1230,7 +1406,7 @@ static bool _checkSkip(Service_T s) {
         s->monitor &= ~Monitor_Waiting;
         // Skip if parent is not initialized
         for (Dependant_T d = s->dependantlist; d; d = d->next ) {
-                Service_T parent = Util_getService(d->dependant);
+                Service_T parent = d->service;
                 if (parent) {
                         if (parent->monitor != Monitor_Yes) {
                                 DEBUG("'%s' test skipped as required service '%s' is %s\n", s->name, parent->name, parent->monitor == Monitor_Init ? "initializing" : "not monitored");
@@ -1245,6 +1421,42 @@ static bool _checkSkip(Service_T s) {
 }
 
 
+/**
+ * Test if some event of the service changed the state in this check or
+ * changed the state more than once in the last 8 checks
+ */
+static bool _isFlapping(Service_T s) {
+        for (Event_T e = s->eventlist; e; e = e->next) {
+                if (e->state_changed)
+                        return true;
+                int changes = 0;
+                for (int64_t m = (e->state_map ^ (e->state_map >> 1)) & 0x7F; m; m &= m - 1)
+                        changes++;
+                if (changes > 1)
+                        return true;
+        }
+        return false;
+}
+
+
+/**
+ * Adapt the check interval of the service: the interval is doubled after
+ * each successful check up to the maximum and reset to every cycle if some
+ * test failed or the service state is flapping
+ */
+static void _adaptInterval(Service_T s, State_Type state) {
+        if (s->every.type == Every_Adaptive) {
+                int interval = s->every.spec.adaptive.interval;
+                if (state == State_Failed || s->error || _isFlapping(s))
+                        s->every.spec.adaptive.interval = 1;
+                else if (state == State_Succeeded)
+                        s->every.spec.adaptive.interval = MIN(interval * 2, s->every.spec.adaptive.maximum);
+                if (s->every.spec.adaptive.interval != interval)
+                        DEBUG("'%s' adaptive check interval changed from %d to %d cycles\n", s->name, interval, s->every.spec.adaptive.interval);
+        }
+}
+
+
 /**
  * Returns true if scheduled action was performed
  */
@@ -1260,6 +1472,43 @@ static bool _doScheduledAction(Service_T s) {
 }
 
 
+/**
+ * Test if the service is checked in the given pass of the validation cycle.
+ * The high priority services are checked first, followed by the services
+ * which were deferred in the previous cycle, the normal and the low priority
+ * services
+ */
+static bool _inPass(Service_T s, int pass) {
+        switch (pass) {
+                case 0:
+                        return s->priority == Priority_High;
+                case 1:
+                        return s->priority != Priority_High && s->deferral.pending;
+                case 2:
+                        return s->priority == Priority_Normal && ! s->deferral.pending;
+                default:
+                        return s->priority == Priority_Low && ! s->deferral.pending;
+        }
+}
+
+
+/**
+ * Test if the service check has to be deferred to the next cycle, as its
+ * mean duration would exceed the cycle deadline. The high priority services
+ * are never deferred and the check deferred in the previous cycle is always
+ * run, so the check is deferred at most one cycle
+ */
+static bool _defer(Service_T s, int64_t deadline) {
+        if (deadline && s->priority != Priority_High && ! s->deferral.pending && Time_micro() + (int64_t)Histogram_mean(&(s->profile.wall)) > deadline) {
+                s->deferral.deferred = true;
+                s->deferral.count++;
+                LogWarning("'%s' test deferred to the next cycle as the cycle time budget (%s) would be exceeded\n", s->name, Fmt_ms(Run.limits.cycleBudget, (char[11]){}));
+                return true;
+        }
+        return false;
+}
+
+
 /* ---------------------------------------------------------- MARK: - Public */
 
 
@@ -1269,12 +1518,16 @@ static bool _doScheduledAction(Service_T s) {
  *  they will pass all defined tests.
  */
 int validate() {
+        int64_t cycle = Time_micro();
         Run.handler_flag = Handler_Succeeded;
         Event_queue_process();
 
         update_system_info();
-        ProcessTree_init(ProcessEngine_None);
+        int64_t processtree = Time_micro();
+        ProcessTree_init(ProcessTree_hasPendingMatch() ? ProcessEngine_CollectCommandLine : ProcessEngine_None);
+        Histogram_record(&(Run.profile.processtree), MAX(0, Time_micro() - processtree));
         gettimeofday(&systeminfo.collected, NULL);
+        Watch_process();
 
         /* In the case that at least one action is pending, perform quick loop to handle the actions ASAP */
         if (Run.flags & Run_ActionPending) {
@@ -1284,22 +1537,109 @@ int validate() {
         }
 
         int errors = 0;
-        /* Check the services */
+        int64_t deadline = Run.limits.cycleBudget ? cycle + (int64_t)Run.limits.cycleBudget * 1000LL : 0LL;
+        /* Check the services in the priority order */
+        for (int pass = 0; pass < 4; pass++) {
+                for (Service_T s = servicelist; s && ! interrupt(); s = s->next) {
+                        if (! _inPass(s, pass))
+                                continue;
+                        // FIXME: The Service_Program must collect the exit value from last run, even if the program start should be skipped in this cycle => let check program always run the test (to be refactored with new scheduler)
+                        if (! _doScheduledAction(s) && s->monitor && (s->type == Service_Program || ! _checkSkip(s)) && ! _defer(s, deadline)) {
+                                _checkTimeout(s); // Can disable monitoring => need to check s->monitor again
+                                if (s->monitor) {
+                                        State_Type state = _check(s);
+                                        if (state != State_Init && s->monitor != Monitor_Not) // The monitoring can be disabled by some matching rule in s->check so we have to check again before setting to Monitor_Yes
+                                                s->monitor = Monitor_Yes;
+                                        if (state == State_Failed)
+                                                errors++;
+                                        _adaptInterval(s, state);
+                                }
+                                gettimeofday(&s->collected, NULL);
+                        }
+                }
+        }
+        for (Service_T s = servicelist; s; s = s->next) {
+                s->deferral.pending = s->deferral.deferred;
+                s->deferral.deferred = false;
+        }
+        int64_t elapsed = MAX(0, Time_micro() - cycle);
+        Histogram_record(&(Run.profile.cycle), elapsed);
+        int64_t limit = Run.limits.cycleBudget ? (int64_t)Run.limits.cycleBudget * 1000LL : (int64_t)Run.polltime * 1000000LL;
+        if (limit > 0 && elapsed > limit)
+                Histogram_record(&(Run.profile.overrun), elapsed - limit);
+        return errors;
+}
+
+
+/**
+ * Evaluate the status of the check programs which finished since the last
+ * validation cycle. Called by the daemon when the program supervisor signals
+ * the program exit, so the status is evaluated without waiting for the next
+ * cycle.
+ */
+void validate_programs() {
+        Program_acknowledge();
         for (Service_T s = servicelist; s && ! interrupt(); s = s->next) {
-                // FIXME: The Service_Program must collect the exit value from last run, even if the program start should be skipped in this cycle => let check program always run the test (to be refactored with new scheduler)
-                if (! _doScheduledAction(s) && s->monitor && (s->type == Service_Program || ! _checkSkip(s))) {
-                        _checkTimeout(s); // Can disable monitoring => need to check s->monitor again
-                        if (s->monitor) {
-                                State_Type state = s->check(s);
-                                if (state != State_Init && s->monitor != Monitor_Not) // The monitoring can be disabled by some matching rule in s->check so we have to check again before setting to Monitor_Yes
+                if (s->type == Service_Program && s->monitor && s->program->P && Program_isFinished(s)) {
+                        State_Type state = _checkProgramStatus(s);
+                        if (state != State_Init && s->monitor != Monitor_Not)
+                                s->monitor = Monitor_Yes;
+                        gettimeofday(&s->collected, NULL);
+                }
+        }
+}
+
+
+/**
+ * Validate the file, directory and fifo services which path changed since
+ * the last check. Called by the daemon when the change notification arrives,
+ * so the change is detected without waiting for the next cycle. The service
+ * is validated at most once per second to not overload the system if the
+ * path changes continuously and the services with the "every" statement are
+ * validated in their cycle only. Note that the immediate validation counts
+ * as a cycle for the "for N cycles" and "N times within M cycles" rules.
+ * @return The number of changed services which were checked less then one
+ * second ago and have to be validated later
+ */
+int validate_changed() {
+        int deferred = 0;
+        Watch_process();
+        time_t now = Time_now();
+        for (Service_T s = servicelist; s && ! interrupt(); s = s->next) {
+                if ((s->type == Service_File || s->type == Service_Directory || s->type == Service_Fifo) && s->changed && s->monitor && s->every.type == Every_Cycle) {
+                        if (s->collected.tv_sec >= now) {
+                                deferred++;
+                        } else if (! _checkSkip(s)) {
+                                DEBUG("'%s' %s changed -- checking now\n", s->name, s->path);
+                                State_Type state = _check(s);
+                                if (state != State_Init && s->monitor != Monitor_Not)
                                         s->monitor = Monitor_Yes;
-                                if (state == State_Failed)
-                                        errors++;
+                                gettimeofday(&s->collected, NULL);
                         }
+                }
+        }
+        return deferred;
+}
+
+
+/**
+ * Validate the system and cgroup services with the pressure tests. Called by
+ * the daemon when some pressure trigger fires, so the pressure stall is
+ * detected without waiting for the next cycle. The services with the "every"
+ * statement are validated in their cycle only.
+ */
+void validate_pressure() {
+        Pressure_process();
+        Pressure_updateSystem();
+        for (Service_T s = servicelist; s && ! interrupt(); s = s->next) {
+                if ((s->type == Service_System || s->type == Service_Cgroup) && s->monitor && s->every.type == Every_Cycle && Pressure_hasResource(s) && ! _checkSkip(s)) {
+                        DEBUG("'%s' pressure stall trigger fired -- checking now\n", s->name);
+                        State_Type state = _check(s);
+                        if (state != State_Init && s->monitor != Monitor_Not)
+                                s->monitor = Monitor_Yes;
                         gettimeofday(&s->collected, NULL);
                 }
         }
-        return errors;
 }
 
 
@@ -1328,6 +1668,12 @@ State_Type check_process(Service_T s) {
                         LogError("'%s' failed to get process data\n", s->name);
                         rv = State_Failed;
                 }
+                // The cgroup totals replace the process tree totals
+                if (checkResources && s->inf.process->cgroup.enabled) {
+                        char path[PATH_MAX];
+                        if (! Cgroup_getPath(pid, path, sizeof(path)) || ! Cgroup_updateService(s, path))
+                                DEBUG("'%s' cgroup statistics are not available -- using the process tree totals\n", s->name);
+                }
         }
         for (NonExist_T l = s->nonexistlist; l; l = l->next) {
                 Event_post(s, Event_NonExist, State_Succeeded, l->action, "process is running with pid %d", (int)pid);
@@ -1437,7 +1783,8 @@ State_Type check_file(Service_T s) {
         ASSERT(s);
         struct stat stat_buf;
         State_Type rv = State_Succeeded;
-        if (stat(s->path, &stat_buf) != 0) {
+        bool changed = Watch_check(s);
+        if (changed && stat(s->path, &stat_buf) != 0) {
                 for (NonExist_T l = s->nonexistlist; l; l = l->next) {
                         rv = State_Failed;
                         Event_post(s, Event_NonExist, State_Failed, l->action, "file doesn't exist");
@@ -1447,22 +1794,27 @@ State_Type check_file(Service_T s) {
                 }
                 return rv;
         } else {
-                s->inf.file->mode = stat_buf.st_mode;
-                if (s->inf.file->inode) {
+                if (! changed) {
+                        DEBUG("'%s' file has not changed since the last check\n", s->name);
                         s->inf.file->inode_prev = s->inf.file->inode;
                 } else {
-                        // Seek to the end of the file the first time we see it => skip existing content (files which passed the test at least once have inode always set via state file)
-                        DEBUG("'%s' seeking to the end of the file\n", s->name);
-                        s->inf.file->readpos = stat_buf.st_size;
-                        s->inf.file->inode_prev = stat_buf.st_ino;
-                }
-                s->inf.file->inode = stat_buf.st_ino;
-                s->inf.file->uid = stat_buf.st_uid;
-                s->inf.file->gid = stat_buf.st_gid;
-                s->inf.file->size = stat_buf.st_size;
-                s->inf.file->timestamp.access = stat_buf.st_atime;
-                s->inf.file->timestamp.change = stat_buf.st_ctime;
-                s->inf.file->timestamp.modify = stat_buf.st_mtime;
+                        s->inf.file->mode = stat_buf.st_mode;
+                        if (s->inf.file->inode) {
+                                s->inf.file->inode_prev = s->inf.file->inode;
+                        } else {
+                                // Seek to the end of the file the first time we see it => skip existing content (files which passed the test at least once have inode always set via state file)
+                                DEBUG("'%s' seeking to the end of the file\n", s->name);
+                                s->inf.file->readpos = stat_buf.st_size;
+                                s->inf.file->inode_prev = stat_buf.st_ino;
+                        }
+                        s->inf.file->inode = stat_buf.st_ino;
+                        s->inf.file->uid = stat_buf.st_uid;
+                        s->inf.file->gid = stat_buf.st_gid;
+                        s->inf.file->size = stat_buf.st_size;
+                        s->inf.file->timestamp.access = stat_buf.st_atime;
+                        s->inf.file->timestamp.change = stat_buf.st_ctime;
+                        s->inf.file->timestamp.modify = stat_buf.st_mtime;
+                }
                 for (NonExist_T l = s->nonexistlist; l; l = l->next) {
                         Event_post(s, Event_NonExist, State_Succeeded, l->action, "file exists");
                 }
@@ -1478,7 +1830,7 @@ State_Type check_file(Service_T s) {
                 Event_post(s, Event_Invalid, State_Succeeded, s->action_INVALID, "is a regular %s",
                            S_ISSOCK(s->inf.file->mode) ? "socket" : "file");
         }
-        if (_checkChecksum(s) == State_Failed)
+        if (_checkChecksum(s, changed) == State_Failed)
                 rv = State_Failed;
         if (_checkPerm(s, s->inf.file->mode) == State_Failed)
                 rv = State_Failed;
@@ -1504,7 +1856,8 @@ State_Type check_directory(Service_T s) {
         ASSERT(s);
         struct stat stat_buf;
         State_Type rv = State_Succeeded;
-        if (stat(s->path, &stat_buf) != 0) {
+        bool changed = Watch_check(s);
+        if (changed && stat(s->path, &stat_buf) != 0) {
                 for (NonExist_T l = s->nonexistlist; l; l = l->next) {
                         rv = State_Failed;
                         Event_post(s, Event_NonExist, State_Failed, l->action, "directory doesn't exist");
@@ -1514,12 +1867,16 @@ State_Type check_directory(Service_T s) {
                 }
                 return rv;
         } else {
-                s->inf.directory->mode = stat_buf.st_mode;
-                s->inf.directory->uid = stat_buf.st_uid;
-                s->inf.directory->gid = stat_buf.st_gid;
-                s->inf.directory->timestamp.access = stat_buf.st_atime;
-                s->inf.directory->timestamp.change = stat_buf.st_ctime;
-                s->inf.directory->timestamp.modify = stat_buf.st_mtime;
+                if (! changed) {
+                        DEBUG("'%s' directory has not changed since the last check\n", s->name);
+                } else {
+                        s->inf.directory->mode = stat_buf.st_mode;
+                        s->inf.directory->uid = stat_buf.st_uid;
+                        s->inf.directory->gid = stat_buf.st_gid;
+                        s->inf.directory->timestamp.access = stat_buf.st_atime;
+                        s->inf.directory->timestamp.change = stat_buf.st_ctime;
+                        s->inf.directory->timestamp.modify = stat_buf.st_mtime;
+                }
                 for (NonExist_T l = s->nonexistlist; l; l = l->next) {
                         Event_post(s, Event_NonExist, State_Succeeded, l->action, "directory exists");
                 }
@@ -1554,7 +1911,8 @@ State_Type check_fifo(Service_T s) {
         ASSERT(s);
         struct stat stat_buf;
         State_Type rv = State_Succeeded;
-        if (stat(s->path, &stat_buf) != 0) {
+        bool changed = Watch_check(s);
+        if (changed && stat(s->path, &stat_buf) != 0) {
                 for (NonExist_T l = s->nonexistlist; l; l = l->next) {
                         rv = State_Failed;
                         Event_post(s, Event_NonExist, State_Failed, l->action, "fifo doesn't exist");
@@ -1564,12 +1922,16 @@ State_Type check_fifo(Service_T s) {
                 }
                 return rv;
         } else {
-                s->inf.fifo->mode = stat_buf.st_mode;
-                s->inf.fifo->uid = stat_buf.st_uid;
-                s->inf.fifo->gid = stat_buf.st_gid;
-                s->inf.fifo->timestamp.access = stat_buf.st_atime;
-                s->inf.fifo->timestamp.change = stat_buf.st_ctime;
-                s->inf.fifo->timestamp.modify = stat_buf.st_mtime;
+                if (! changed) {
+                        DEBUG("'%s' fifo has not changed since the last check\n", s->name);
+                } else {
+                        s->inf.fifo->mode = stat_buf.st_mode;
+                        s->inf.fifo->uid = stat_buf.st_uid;
+                        s->inf.fifo->gid = stat_buf.st_gid;
+                        s->inf.fifo->timestamp.access = stat_buf.st_atime;
+                        s->inf.fifo->timestamp.change = stat_buf.st_ctime;
+                        s->inf.fifo->timestamp.modify = stat_buf.st_mtime;
+                }
                 for (NonExist_T l = s->nonexistlist; l; l = l->next) {
                         Event_post(s, Event_NonExist, State_Succeeded, l->action, "fifo exists");
                 }
@@ -1603,72 +1965,25 @@ State_Type check_fifo(Service_T s) {
 State_Type check_program(Service_T s) {
         ASSERT(s);
         ASSERT(s->program);
-        State_Type rv = State_Succeeded;
-        time_t now = Time_now();
-        Process_T P = s->program->P;
-        if (P) {
-                // Process program output
-                _programOutput(Process_getErrorStream(P), s->program->inprogressOutput);
-                _programOutput(Process_getInputStream(P), s->program->inprogressOutput);
+        State_Type rv = State_Init;
+        if (s->program->P) {
                 // Is the program still running?
-                if (Process_exitStatus(P) < 0) {
-                        int64_t execution_time = (now - s->program->started) * 1000;
-                        if (execution_time > s->program->timeout) { // Program timed out
-                                rv = State_Failed;
-                                LogError("'%s' program timed out after %s. Killing program with pid %ld\n", s->name, Fmt_ms(execution_time, (char[11]){}), (long)Process_getPid(P));
-                                Process_kill(P);
-                                Process_waitFor(P); // Wait for child to exit to get correct exit value
-                                // Fall-through with P and evaluate exit value below.
-                        } else {
-                                // Defer test of exit value until program exit or timeout
-                                DEBUG("'%s' status check deferred - waiting on program to exit\n", s->name);
-                                return State_Init;
-                        }
-                }
-                s->program->exitStatus = Process_exitStatus(P); // Save exit status for web-view display
-                StringBuffer_trim(s->program->inprogressOutput);
-                // Swap program output (instance finished)
-                StringBuffer_clear(s->program->lastOutput);
-                StringBuffer_append(s->program->lastOutput, "%s", StringBuffer_toString(s->program->inprogressOutput));
-                // Evaluate program's exit status against our status checks.
-                const char *output = StringBuffer_length(s->program->inprogressOutput) ? StringBuffer_toString(s->program->inprogressOutput) : "no output";
-                for (Status_T status = s->statuslist; status; status = status->next) {
-                        if (status->operator == Operator_Changed) {
-                                if (status->initialized) {
-                                        if (Util_evalQExpression(status->operator, s->program->exitStatus, status->return_value)) {
-                                                Event_post(s, Event_Status, State_Changed, status->action, "status changed (%d -> %d) -- %s", status->return_value, s->program->exitStatus, output);
-                                                status->return_value = s->program->exitStatus;
-                                        } else {
-                                                Event_post(s, Event_Status, State_ChangedNot, status->action, "status didn't change (%d) -- %s", s->program->exitStatus, output);
-                                        }
-                                } else {
-                                        status->initialized = true;
-                                        status->return_value = s->program->exitStatus;
-                                }
-                        } else {
-                                if (Util_evalQExpression(status->operator, s->program->exitStatus, status->return_value)) {
-                                        rv = State_Failed;
-                                        Event_post(s, Event_Status, State_Failed, status->action, "status failed (%d) -- %s", s->program->exitStatus, output);
-                                } else {
-                                        Event_post(s, Event_Status, State_Succeeded, status->action, "status succeeded (%d) -- %s", s->program->exitStatus, output);
-                                }
-                        }
+                if (! Program_isFinished(s)) {
+                        // Defer test of exit value until program exit or timeout
+                        DEBUG("'%s' status check deferred - waiting on program to exit\n", s->name);
+                        return State_Init;
                 }
-                Process_free(&s->program->P);
-        } else {
-                rv = State_Init;
+                rv = _checkProgramStatus(s);
         }
         //FIXME: the current off-by-one-cycle based design requires that the check program will collect the exit value next cycle even if program startup should be skipped in the given cycle => must test skip here (new scheduler will obsolete this deferred skip checking)
         if (s->monitor != Monitor_Not && ! _checkSkip(s)) { // The status evaluation may disable service monitoring
-                // Start program
-                StringBuffer_clear(s->program->inprogressOutput);
-                s->program->P = Command_execute(s->program->C);
-                if (! s->program->P) {
+                if (Run.limits.programConcurrency && Program_running() >= Run.limits.programConcurrency) {
+                        DEBUG("'%s' program start deferred - %u programs are running already\n", s->name, Run.limits.programConcurrency);
+                } else if (! Program_execute(s)) {
                         rv = State_Failed;
                         Event_post(s, Event_Status, State_Failed, s->action_EXEC, "failed to execute '%s' -- %s", s->path, STRERROR);
                 } else {
                         Event_post(s, Event_Status, State_Succeeded, s->action_EXEC, "program started");
-                        s->program->started = now;
                 }
         }
         return rv;
@@ -1918,3 +2233,32 @@ State_Type check_net(Service_T s) {
 }
 
 
+/**
+ * Validate the given cgroup service s. The resource usage of all processes
+ * in the cgroup is read from the cgroup v2 controllers
+ */
+State_Type check_cgroup(Service_T s) {
+        ASSERT(s);
+        State_Type rv = State_Succeeded;
+        if (! Cgroup_updateService(s, s->path)) {
+                Util_resetInfo(s);
+                for (NonExist_T l = s->nonexistlist; l; l = l->next) {
+                        rv = State_Failed;
+                        Event_post(s, Event_NonExist, State_Failed, l->action, "cgroup doesn't exist");
+                }
+                for (Exist_T l = s->existlist; l; l = l->next)
+                        Event_post(s, Event_Exist, State_Succeeded, l->action, "cgroup doesn't exist");
+                return rv;
+        }
+        for (NonExist_T l = s->nonexistlist; l; l = l->next)
+                Event_post(s, Event_NonExist, State_Succeeded, l->action, "cgroup exists");
+        for (Exist_T l = s->existlist; l; l = l->next) {
+                rv = State_Failed;
+                Event_post(s, Event_Exist, State_Failed, l->action, "cgroup exists");
+        }
+        for (Resource_T r = s->resourcelist; r; r = r->next)
+                if (_checkProcessResources(s, r) == State_Failed)
+                        rv = State_Failed;
+        return rv;
+}
+
@@ -27,6 +27,9 @@
 #define VALIDATE_INCLUDED
 
 int validate(void);
+void validate_programs(void);
+int validate_changed(void);
+void validate_pressure(void);
 State_Type check_process(Service_T);
 State_Type check_filesystem(Service_T);
 State_Type check_file(Service_T);
@@ -36,5 +39,6 @@ State_Type check_system(Service_T);
 State_Type check_fifo(Service_T);
 State_Type check_program(Service_T);
 State_Type check_net(Service_T);
+State_Type check_cgroup(Service_T);
 
 #endif
@@ -0,0 +1,299 @@
+/*
+ * Copyright (C) Tildeslash Ltd. All rights reserved.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ *
+ * You must obey the GNU Affero General Public License in all respects
+ * for all of the code used other than OpenSSL.
+ */
+
+
+#include "xconfig.h"
+
+#ifdef HAVE_STDIO_H
+#include <stdio.h>
+#endif
+
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+
+#ifdef HAVE_ERRNO_H
+#include <errno.h>
+#endif
+
+#ifdef HAVE_SYS_VFS_H
+#include <sys/vfs.h>
+#endif
+
+#ifdef HAVE_SYS_STAT_H
+#include <sys/stat.h>
+#endif
+
+#ifdef HAVE_SYS_INOTIFY_H
+#include <sys/inotify.h>
+#endif
+
+#include "monit.h"
+#include "watch.h"
+
+
+/**
+ * Implementation of the file change notification using inotify(7).
+ *
+ * The watch is armed when the service is checked and the watch descriptor is
+ * saved in the service object. The watch descriptor is shared if multiple
+ * services watch the same path. Any event on the watched path marks the
+ * service as changed, so the next check reads the path data again. If the
+ * watch is removed by the kernel (the path was deleted or the filesystem
+ * was unmounted) or the event queue overflowed, the services are checked
+ * fully and the watch is armed again.
+ *
+ * The inotify watch follows the inode, not the path: if the path is resolved
+ * to a different inode (the symlink target was swapped, or a parent directory
+ * was renamed or replaced), no event is generated. The path is therefore
+ * stat'ed on each check and if the device or inode differs from the watched
+ * one, the service is checked fully and the watch is moved to the new target.
+ *
+ * On systems without inotify all methods are no-op and every check reads the
+ * path data.
+ *
+ * @file
+ */
+
+
+/* ----------------------------------------------------------- MARK: - Definitions */
+
+
+#define WATCH_BATCH 64       /* Maximum number of distinct watch descriptors processed in one pass over the service list */
+
+
+static int watchfd = -1;
+
+
+/* ------------------------------------------------------------------ MARK: - Private */
+
+
+#ifdef HAVE_SYS_INOTIFY_H
+
+
+/**
+ * Test if the filesystem supports change notification. Events from remote
+ * hosts are not delivered for network filesystems and pseudo filesystems
+ * don't generate events at all
+ */
+static bool _isWatchable(const char *path) {
+        struct statfs sfs;
+        if (statfs(path, &sfs) == 0) {
+                switch ((unsigned long)sfs.f_type) {
+                        case 0x6969:            // NFS
+                        case 0x517B:            // SMB
+                        case 0xFF534D42:        // CIFS
+                        case 0xFE534D42:        // SMB2
+                        case 0x65735546:        // FUSE
+                        case 0x00C36400:        // Ceph
+                        case 0x01021997:        // 9p
+                        case 0x5346414F:        // AFS
+                        case 0x47504653:        // GPFS
+                        case 0x9FA0:            // proc
+                        case 0x62656572:        // sysfs
+                        case 0x27E0EB:          // cgroup
+                        case 0x63677270:        // cgroup2
+                        case 0x64626720:        // debugfs
+                                return false;
+                        default:
+                                return true;
+                }
+        }
+        return false;
+}
+
+
+static uint32_t _mask(Service_T s) {
+        uint32_t mask = IN_ATTRIB | IN_DELETE_SELF | IN_MOVE_SELF;
+        if (s->type == Service_Directory)
+                mask |= IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO;
+        else
+                mask |= IN_MODIFY;
+        for (Timestamp_T t = s->timestamplist; t; t = t->next)
+                if (t->type == Timestamp_Access)
+                        mask |= IN_ACCESS;
+        return mask;
+}
+
+
+/**
+ * Mark the services watching the given descriptors as changed. If the watch
+ * was removed, the service is unwatched
+ */
+static void _mark(int *wd, bool *removed, int count) {
+        for (Service_T s = servicelist; s; s = s->next) {
+                if (s->watch) {
+                        for (int i = 0; i < count; i++) {
+                                if (s->watch == wd[i]) {
+                                        s->changed = true;
+                                        if (removed[i])
+                                                s->watch = 0;
+                                        break;
+                                }
+                        }
+                }
+        }
+}
+
+
+/**
+ * Test if the path still resolves to the watched inode
+ */
+static bool _isWatched(Service_T s) {
+        struct stat st;
+        if (stat(s->path, &st) == 0 && st.st_dev == s->watchDevice && st.st_ino == s->watchInode)
+                return true;
+        DEBUG("'%s' %s resolves to a different inode -- checking and watching the new target\n", s->name, s->path);
+        return false;
+}
+
+
+/**
+ * Set the service watch descriptor. The previous watch is removed, unless
+ * another service shares it, so watches of the replaced path targets don't
+ * accumulate
+ */
+static void _setWatch(Service_T s, int wd) {
+        int previous = s->watch;
+        s->watch = wd;
+        if (previous && previous != wd) {
+                for (Service_T o = servicelist; o; o = o->next)
+                        if (o->watch == previous)
+                                return;
+                if (inotify_rm_watch(watchfd, previous) != 0 && errno != EINVAL) // EINVAL: the watch was removed by the kernel already
+                        DEBUG("'%s' cannot remove the previous watch of %s -- %s\n", s->name, s->path, STRERROR);
+        }
+}
+
+
+static void _markAll(void) {
+        for (Service_T s = servicelist; s; s = s->next)
+                s->changed = true;
+}
+
+
+#endif
+
+
+/* ------------------------------------------------------------------- MARK: - Public */
+
+
+void Watch_start() {
+#ifdef HAVE_SYS_INOTIFY_H
+        if (watchfd < 0) {
+                if ((watchfd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC)) < 0)
+                        LogWarning("File change notification is not available, files will be polled -- %s\n", STRERROR);
+        }
+#endif
+}
+
+
+void Watch_stop() {
+        if (watchfd >= 0) {
+                close(watchfd); // Removes all watches
+                watchfd = -1;
+        }
+        for (Service_T s = servicelist; s; s = s->next)
+                s->watch = 0;
+}
+
+
+int Watch_getDescriptor() {
+        return watchfd;
+}
+
+
+void Watch_process() {
+#ifdef HAVE_SYS_INOTIFY_H
+        if (watchfd >= 0) {
+                ssize_t n;
+                char buf[4096] __attribute__ ((aligned(__alignof__(struct inotify_event))));
+                int count = 0;
+                int wd[WATCH_BATCH];
+                bool removed[WATCH_BATCH];
+                while ((n = read(watchfd, buf, sizeof(buf))) > 0 || (n < 0 && errno == EINTR)) {
+                        for (char *p = buf; p < buf + n; p += sizeof(struct inotify_event) + ((struct inotify_event *)p)->len) {
+                                struct inotify_event *event = (struct inotify_event *)p;
+                                if (event->mask & IN_Q_OVERFLOW) {
+                                        DEBUG("File change notification queue overflow -- checking all files\n");
+                                        _markAll();
+                                        continue;
+                                } else if (event->len && ! (event->mask & (IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO))) {
+                                        // Directory entry attributes or content changed, the directory itself didn't change
+                                        continue;
+                                }
+                                int i;
+                                for (i = 0; i < count && wd[i] != event->wd; i++)
+                                        ;
+                                if (i == count) {
+                                        if (count == WATCH_BATCH) {
+                                                _mark(wd, removed, count);
+                                                count = i = 0;
+                                        }
+                                        wd[i] = event->wd;
+                                        removed[i] = false;
+                                        count++;
+                                }
+                                if (event->mask & IN_IGNORED)
+                                        removed[i] = true;
+                        }
+                }
+                if (count)
+                        _mark(wd, removed, count);
+        }
+#endif
+}
+
+
+bool Watch_check(Service_T s) {
+        ASSERT(s);
+#ifdef HAVE_SYS_INOTIFY_H
+        if (watchfd >= 0) {
+                if (s->watch && ! s->changed && _isWatched(s))
+                        return false;
+                s->changed = false;
+                if (_isWatchable(s->path)) {
+                        struct stat st;
+                        int wd = inotify_add_watch(watchfd, s->path, _mask(s) | IN_MASK_ADD);
+                        if (wd < 0) {
+                                if (errno != ENOENT)
+                                        DEBUG("'%s' cannot watch %s for changes -- %s\n", s->name, s->path, STRERROR);
+                                _setWatch(s, 0);
+                        } else if (stat(s->path, &st) != 0) {
+                                // The path was removed after the watch was added, drop the watch and check the service fully next time
+                                _setWatch(s, wd);
+                                _setWatch(s, 0);
+                        } else {
+                                _setWatch(s, wd);
+                                s->watchDevice = st.st_dev;
+                                s->watchInode = st.st_ino;
+                        }
+                } else {
+                        _setWatch(s, 0);
+                }
+        }
+#endif
+        return true;
+}
+
@@ -0,0 +1,89 @@
+/*
+ * Copyright (C) Tildeslash Ltd. All rights reserved.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ *
+ * You must obey the GNU Affero General Public License in all respects
+ * for all of the code used other than OpenSSL.
+ */
+
+
+#ifndef MONIT_WATCH_H
+#define MONIT_WATCH_H
+
+
+/**
+ * File change notification for the file, directory and fifo services.
+ *
+ * If the system supports it (inotify on Linux), the daemon watches the paths
+ * of the file, directory and fifo services. A service which path did not
+ * change since its last check can skip the checksum computation and content
+ * reading and reuse the data collected by the last check. The path is still
+ * stat'ed on each check to detect that it resolves to a different inode than
+ * the watched one (e.g. a swapped symlink target or replaced parent
+ * directory), which inotify doesn't report. A changed service can be validated immediately, without waiting
+ * for the next validation cycle.
+ *
+ * Paths on network and pseudo filesystems are not watched, as the change
+ * notification doesn't work there, and such services are checked every cycle.
+ *
+ *  @file
+ */
+
+
+/**
+ * Start the change notification
+ */
+void Watch_start(void);
+
+
+/**
+ * Stop the change notification and remove all watches
+ */
+void Watch_stop(void);
+
+
+/**
+ * Get the change notification descriptor. The descriptor is readable if
+ * some watched path changed. Use Watch_process() to read the changes
+ * @return The descriptor or -1 if the change notification is not running
+ */
+int Watch_getDescriptor(void);
+
+
+/**
+ * Read the pending change notifications and mark the changed services
+ */
+void Watch_process(void);
+
+
+/**
+ * Test if the service path changed since the last check and needs to be
+ * checked again. If the service has to be checked, the path watch is
+ * (re)armed before the method returns, so changes done while the service
+ * is checked are not lost
+ * @param s A file, directory or fifo service
+ * @return true if the service has to be checked, false if the path did
+ * not change, still resolves to the watched inode and the data collected
+ * by the last check are valid
+ */
+bool Watch_check(Service_T s);
+
+
+#endif
+